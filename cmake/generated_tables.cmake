@@ -0,0 +1,43 @@
+# Build-time generated lookup tables shared by the firmware and the simulator
+#
+#   keyboard_generated_tables(<target> <firmware root>)
+#
+# Runs the generators in tools/ into <build>/generated (once per build
+# directory, however many targets use them) and adds that directory to the
+# target's include path:
+#   sensor_positions_table.h  - from include/note_map.h (fails on bad wiring)
+#   velocity_curves_table.h   - from include/keyboard_config.h
+
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+function(keyboard_generated_tables target root)
+    set(out ${CMAKE_CURRENT_BINARY_DIR}/generated)
+
+    if(NOT TARGET keyboard_generated_headers)
+        add_custom_command(
+            OUTPUT ${out}/sensor_positions_table.h
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${out}
+            COMMAND ${Python3_EXECUTABLE} ${root}/tools/gen_position_table.py
+                    ${root}/include/note_map.h ${out}/sensor_positions_table.h
+            DEPENDS ${root}/tools/gen_position_table.py ${root}/include/note_map.h
+            COMMENT "Generating sensor position table from note_map.h"
+        )
+
+        add_custom_command(
+            OUTPUT ${out}/velocity_curves_table.h
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${out}
+            COMMAND ${Python3_EXECUTABLE} ${root}/tools/gen_velocity_curves.py
+                    ${root}/include/keyboard_config.h ${out}/velocity_curves_table.h
+            DEPENDS ${root}/tools/gen_velocity_curves.py ${root}/include/keyboard_config.h
+            COMMENT "Generating velocity curve tables from keyboard_config.h"
+        )
+
+        add_custom_target(keyboard_generated_headers DEPENDS
+            ${out}/sensor_positions_table.h
+            ${out}/velocity_curves_table.h
+        )
+    endif()
+
+    add_dependencies(${target} keyboard_generated_headers)
+    target_include_directories(${target} PRIVATE ${out})
+endfunction()
@@ -0,0 +1,90 @@
+/*
+ * Matrix Settle-Time Sweep - see settle_sweep.h
+ */
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "keyboard_config.h"
+#include "pio_scanner.h"
+#include "settle_sweep.h"
+
+const uint16_t settle_sweep_steps_us[SETTLE_SWEEP_STEPS] = SETTLE_SWEEP_STEP_LIST;
+
+// Row word (read columns 0-11) from a gpio_get_all() sample
+static inline uint16_t read_columns(void) {
+    return pio_scan_sample_to_row(gpio_get_all() >> PIO_SCAN_IN_BASE);
+}
+
+// Read a row after every line has discharged and the row has fully settled
+static uint16_t reference_row(uint8_t drive) {
+    busy_wait_us_32(SETTLE_SWEEP_REFERENCE_US);
+    gpio_put(DRIVE0 + drive, 1);
+    busy_wait_us_32(SETTLE_SWEEP_REFERENCE_US);
+    uint16_t row = read_columns();
+    gpio_put(DRIVE0 + drive, 0);
+    return row;
+}
+
+// Read a row after settle_us. With precharge it is read the way the scan
+// does, right after the previous row is released; without, after every
+// line has been idle, so a closed previous-row switch cannot hide a slow
+// rising edge in the same column.
+static uint16_t sample_row(uint8_t prev, uint8_t drive, uint32_t settle_us, bool precharge) {
+    if (precharge) {
+        gpio_put(DRIVE0 + prev, 1);
+        busy_wait_us_32(SETTLE_SWEEP_PRECHARGE_US);
+        gpio_put(DRIVE0 + prev, 0);
+    } else {
+        busy_wait_us_32(SETTLE_SWEEP_IDLE_US);
+    }
+    gpio_put(DRIVE0 + drive, 1);
+    busy_wait_us_32(settle_us);
+    uint16_t row = read_columns();
+    gpio_put(DRIVE0 + drive, 0);
+    return row;
+}
+
+void settle_sweep_run(settle_sweep_t *sweep) {
+    memset(sweep, 0, sizeof(*sweep));
+
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        // Row 0 follows the last row of the previous frame
+        uint8_t prev = drive ? drive - 1 : NUM_DRIVE_PINS - 1;
+        uint16_t reference = reference_row(drive);
+        sweep->reference[drive] = reference;
+
+        for (uint8_t step = 0; step < SETTLE_SWEEP_STEPS; step++) {
+            uint8_t *counts = sweep->mismatches[drive][step];
+            for (uint16_t trial = 0; trial < SETTLE_SWEEP_TRIALS; trial++) {
+                bool precharge = trial & 1;
+                uint16_t wrong = sample_row(prev, drive, settle_sweep_steps_us[step], precharge) ^ reference;
+                while (wrong) {
+                    uint8_t read = (uint8_t)__builtin_ctz(wrong);
+                    wrong &= wrong - 1;
+                    counts[read]++;
+                }
+            }
+        }
+    }
+}
+
+void settle_sweep_write(const settle_sweep_t *sweep, FILE *out) {
+    fprintf(out, "settle-sweep %d drive %d read %d trials %d precharge_us %d idle_us %d reference_us %d\n",
+            SETTLE_SWEEP_FORMAT, NUM_DRIVE_PINS, NUM_READ_PINS, SETTLE_SWEEP_TRIALS,
+            SETTLE_SWEEP_PRECHARGE_US, SETTLE_SWEEP_IDLE_US, SETTLE_SWEEP_REFERENCE_US);
+
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        fprintf(out, "ref %u %03x\n", drive, sweep->reference[drive]);
+    }
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        for (uint8_t step = 0; step < SETTLE_SWEEP_STEPS; step++) {
+            fprintf(out, "step %u %u", drive, settle_sweep_steps_us[step]);
+            for (uint8_t read = 0; read < NUM_READ_PINS; read++) {
+                fprintf(out, " %u", sweep->mismatches[drive][step][read]);
+            }
+            fprintf(out, "\n");
+        }
+    }
+    fprintf(out, "end\n");
+}
@@ -0,0 +1,67 @@
+/*
+ * Matrix Settle-Time Sweep
+ *
+ * Measures how long each drive row needs before its read pins are stable.
+ * For every row the sweep first takes a reference read after a long settle,
+ * then samples the row at increasing settle times. Half the samples follow
+ * the scan's real sequence (previous row driven and released, this row
+ * driven, wait, sample), half start from idle lines. Any read that differs
+ * from the reference counts as a mismatch for that drive/read pair and
+ * settle time.
+ *
+ * Only closed keys show anything: a pair is measured for the rising edge if
+ * its key is held (reference bit set), and for the discharge of the previous
+ * row if the previous row's key in the same column is held. Run sweeps with
+ * different keys held and merge them with tools/settle_profile.py.
+ *
+ * Uses gpio_put, gpio_get_all and busy_wait_us_32 only, so the host
+ * simulator builds it too (sim/ settle-sweep).
+ */
+
+#ifndef SETTLE_SWEEP_H
+#define SETTLE_SWEEP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "note_map.h"
+
+// Settle times tried per row, in microseconds
+#define SETTLE_SWEEP_STEPS          19
+#define SETTLE_SWEEP_STEP_LIST      { 0, 1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, \
+                                      96, 128, 192, 256, 384, 512 }
+
+// Samples per row and settle time, half with the previous row precharged
+#define SETTLE_SWEEP_TRIALS         32
+
+// Previous row driven this long before a precharged sample (charges its
+// columns); all rows released this long before the others
+#define SETTLE_SWEEP_PRECHARGE_US   100
+#define SETTLE_SWEEP_IDLE_US        500
+
+// Settle time of the reference read, and idle time before it
+#define SETTLE_SWEEP_REFERENCE_US   2000
+
+// Version of the text format written by settle_sweep_write()
+#define SETTLE_SWEEP_FORMAT         1
+
+typedef struct {
+    uint16_t reference[NUM_DRIVE_PINS];     // Read columns closed after a long settle
+    // Reads that differed from the reference, per row, step and read column
+    uint8_t mismatches[NUM_DRIVE_PINS][SETTLE_SWEEP_STEPS][NUM_READ_PINS];
+} settle_sweep_t;
+
+extern const uint16_t settle_sweep_steps_us[SETTLE_SWEEP_STEPS];
+
+// Sweep every row. Drive pins must be outputs (low) and read pins inputs
+// with pull-downs, as in the main firmware. Takes about 3 s.
+void settle_sweep_run(settle_sweep_t *sweep);
+
+// Write one sweep as text for tools/settle_profile.py:
+//   settle-sweep <format> drive <n> read <n> trials <n> precharge_us <us> idle_us <us> reference_us <us>
+//   ref <drive> <closed columns, hex>
+//   step <drive> <settle_us> <mismatches in read column 0> ... <column 11>
+//   end
+void settle_sweep_write(const settle_sweep_t *sweep, FILE *out);
+
+#endif // SETTLE_SWEEP_H
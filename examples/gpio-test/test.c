@@ -1,50 +1,72 @@
+/*
+ * Matrix Settle-Time Characterization
+ *
+ * Sweeps the settle time of every drive row (settle_sweep.c) and prints the
+ * results over USB serial, one sweep every few seconds for as long as the
+ * port is open. Hold different keys between sweeps; tools/settle_profile.py
+ * merges a capture of the output into a per-row settle profile for the main
+ * firmware (include/settle_profile.h).
+ *
+ * LED on while a sweep runs.
+ */
+
 #include <stdio.h>
 #include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "keyboard_config.h"
+#include "note_map.h"
+#include "settle_sweep.h"
 
+#define SWEEP_INTERVAL_MS   1000
 
-#define LED_PIN 25   // onboard LED
-#define GPIO_ENABLE  18   // extra GPIOs
-#define GPIO_READ  19
+// Same pin setup as the main firmware (src/keyboard.c)
+static void init_matrix_pins(void) {
+    // Drive pins: outputs, default LOW (GPIO 0-11)
+    for (int pin = DRIVE0; pin <= DRIVE0 + NUM_DRIVE_PINS - 1; ++pin) {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_OUT);
+        gpio_put(pin, 0);
+    }
 
-int main() {
-    stdio_init_all();
+    // Read pins: inputs with pull-down
+    // GPIO 12-22 (11 pins)
+    for (int pin = 12; pin <= 22; ++pin) {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_IN);
+        gpio_pull_down(pin);
+    }
+    // GPIO 26 (1 pin)
+    gpio_init(26);
+    gpio_set_dir(26, GPIO_IN);
+    gpio_pull_down(26);
 
-    // GPIO setup
+    // LED
     gpio_init(LED_PIN);
-    gpio_set_dir(LED_PIN, true);
-
-    gpio_init(GPIO_ENABLE);
-    gpio_set_dir(GPIO_ENABLE, true);
-
-    gpio_init(GPIO_READ);
-    gpio_set_dir(GPIO_READ, false);
+    gpio_set_dir(LED_PIN, GPIO_OUT);
+}
 
-    uint32_t last_toggle = 0;
-    bool led_state = false;
-    bool read_key = false;
+int main() {
+    stdio_init_all();
+    init_matrix_pins();
 
-    gpio_put(GPIO_ENABLE, true); // enable the keyboard
+    static settle_sweep_t sweep;
+    uint32_t sweeps = 0;
 
     while (true) {
-        // usb_midi_task(); // Handle USB stack
-
-        uint32_t now = to_ms_since_boot(get_absolute_time());
+        // Nothing to capture until the host opens the serial port
+        if (!stdio_usb_connected()) {
+            sleep_ms(100);
+            continue;
+        }
 
-        // // Blink every 500 ms
-        // if (now - last_toggle > 2000) {
-        //     led_state = !led_state;
-        //     gpio_put(LED_PIN, led_state);
+        gpio_put(LED_PIN, true);
+        settle_sweep_run(&sweep);
+        gpio_put(LED_PIN, false);
 
-        //     last_toggle = now;
-        // }
+        printf("# sweep %lu\n", (unsigned long)++sweeps);
+        settle_sweep_write(&sweep, stdout);
+        fflush(stdout);
 
-        // Read keyboard key
-        read_key = gpio_get(GPIO_READ);
-        if (read_key == true) { //key pressed
-            gpio_put(LED_PIN, true);
-        }
-        else {
-            gpio_put(LED_PIN, false);
-        }
+        sleep_ms(SWEEP_INTERVAL_MS);
     }
-}
\ No newline at end of file
+}
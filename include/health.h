@@ -0,0 +1,36 @@
+/*
+ * Health Counters
+ *
+ * Runtime counters for monitoring a keyboard in use, gathered from the
+ * modules that keep them into one list and dumped over SysEx (sysex.h).
+ * Counters run from boot and wrap at 2^32: read them twice and take the
+ * difference for a rate. Maxima are since boot. New counters are only ever
+ * appended, so readers that know fewer keep working.
+ *
+ * Read on the core that owns TinyUSB; the scanner's counters are written on
+ * the scanning core and each is read whole.
+ */
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <stdint.h>
+
+typedef enum {
+    HEALTH_UPTIME_MS,               // Time since boot, ms
+    HEALTH_SCAN_RATE_HZ,            // Scans completed in the last full second
+    HEALTH_SCANS,                   // Frames processed by the scan engine
+    HEALTH_SCAN_OVERRUNS,           // Scheduler ticks skipped, the scan was still running
+    HEALTH_DEBOUNCE_REJECTS,        // Changes the debounce filtered out
+    HEALTH_VELOCITY_TIMEOUTS,       // Note Ons at the default velocity (second sensor late)
+    HEALTH_SECOND_WITHOUT_FIRST,    // Second sensor closed with no first (default velocity)
+    HEALTH_MAX_FRAME_EVENTS,        // Most note events from one frame
+    HEALTH_USB_FIFO_FULL,           // MIDI flushes cut short by a full TX FIFO
+    HEALTH_USB_DROPPED,             // MIDI packets lost (backlog full, not mounted)
+    HEALTH_COUNTER_COUNT,
+} health_counter_t;
+
+// Current value of every counter, indexed by health_counter_t
+void health_read(uint32_t out[HEALTH_COUNTER_COUNT]);
+
+#endif // HEALTH_H
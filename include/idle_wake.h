@@ -0,0 +1,71 @@
+/*
+ * Idle Wake
+ *
+ * Parks the scanner while nobody is playing. After IDLE_WAKE_FRAMES scans in
+ * a row with no sensor closed and no key in flight, the scan scheduler's
+ * alarm is stopped, all 12 drive pins are taken over as SIO outputs and
+ * driven high, and a rising edge on any read pin (GPIO 12-22, 26) raises the
+ * GPIO bank IRQ. The scanning core then sleeps in __wfe() with no scan
+ * ticks. Any closing sensor pulls its column high: the IRQ marks the scanner
+ * woken, and the next idle_wake_poll() drops the drive pins, hands them back
+ * (PIO or SIO) and starts a full-rate scan at once.
+ *
+ * The first sensor of the waking press is seen by that first scan, one
+ * wake-up later than a full-rate scan would see it instead of up to an idle
+ * period later; idle_wake_get_stats() keeps the wake latency (IRQ to scan
+ * start) so that cost stays measured.
+ *
+ * All calls are made from the scanning core; the IRQ callback is installed
+ * on the core that calls idle_wake_init().
+ */
+
+#ifndef IDLE_WAKE_H
+#define IDLE_WAKE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// True while a scan the scheduler started has not been processed yet (a
+// tick can slip in between a frame and the decision to park)
+typedef bool (*idle_wake_pending_t)(void);
+
+typedef enum {
+    IDLE_WAKE_SCANNING,     // Alarm running, counting quiet frames
+    IDLE_WAKE_PARKED,       // Drive pins high, waiting for a read pin edge
+    IDLE_WAKE_WOKEN,        // Edge seen, scanning restarts on the next poll
+} idle_wake_state_t;
+
+typedef struct {
+    uint32_t parks;             // Times the scanner parked
+    uint32_t wakes;             // Times it resumed scanning
+    uint32_t last_wake_us;      // Read pin IRQ to scan start, last wake
+    uint32_t max_wake_us;       // Same, worst case
+    uint64_t parked_us;         // Total time parked
+} idle_wake_stats_t;
+
+// Back to scanning with no quiet frames counted, clear the stats and
+// install the read pin IRQ on the calling core
+void idle_wake_init(idle_wake_pending_t scan_pending);
+
+// Report a processed frame; busy is any sensor closed or key moving. Parks
+// the scanner once IDLE_WAKE_FRAMES quiet frames have gone by and returns
+// true if it did. Call after scan_scheduler_frame_done().
+bool idle_wake_frame_done(bool busy);
+
+// Restart scanning if a read pin woke the scanner; returns true if it did.
+// Call before looking for the next frame.
+bool idle_wake_poll(void);
+
+// Wake a parked scanner without a read pin edge, e.g. for a trace capture
+// that needs frames; the next idle_wake_poll() restarts scanning. No effect
+// unless parked. Call from the scanning core.
+void idle_wake_resume(void);
+
+// True from parking until idle_wake_poll() restarts scanning
+bool idle_wake_parked(void);
+
+idle_wake_state_t idle_wake_state(void);
+
+void idle_wake_get_stats(idle_wake_stats_t *out);
+
+#endif // IDLE_WAKE_H
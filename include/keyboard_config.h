@@ -0,0 +1,149 @@
+/*
+ * Keyboard Configuration
+ *
+ * Hardware pin assignments and timing constants shared by the firmware
+ * (src/keyboard.c, src/scan_engine.c) and the host simulator (sim/).
+ */
+
+#ifndef KEYBOARD_CONFIG_H
+#define KEYBOARD_CONFIG_H
+
+// Hardware pins
+#define LED_PIN 25
+#define DRIVE0  0
+#define READ0   12
+
+// Read pins: GPIO 12-22 (columns 0-10) + GPIO 26 (column 11)
+#define READ_PIN_MASK   0x047FF000u // Bits 12-22 + bit 26 (12 pins)
+
+// Scanning config - SUPER SLOW for debugging
+#define DEBOUNCE_TIME_US   500
+
+// Settle time for drive rows the settle profile (settle_profile.h, measured
+// with examples/gpio-test and tools/settle_profile.py) has no value for.
+// Conservative: this board showed crosstalk at 50 us
+// (test_results/matrix_analysis.md).
+#define SCAN_SETTLE_US     500
+
+// Debounce engine (scan_engine.c):
+//   DEBOUNCE_TIMED     act on a position's first differing sample, then ignore
+//                      it for DEBOUNCE_TIME_US
+//   DEBOUNCE_VERTICAL  2-bit vertical counters over each row word: act once a
+//                      position has differed for DEBOUNCE_SAMPLES scans in a
+//                      row (1-4). Rejects single noisy reads, costs
+//                      DEBOUNCE_SAMPLES - 1 scan periods of latency; events
+//                      keep the sample times of the scan that first saw them.
+// Overridable from the build (the simulator builds both).
+#define DEBOUNCE_TIMED      0
+#define DEBOUNCE_VERTICAL   1
+#ifndef DEBOUNCE_ENGINE
+#define DEBOUNCE_ENGINE     DEBOUNCE_TIMED
+#endif
+#define DEBOUNCE_SAMPLES    2
+
+// Scan scheduler (scan_scheduler.c): a hardware alarm starts every scan at a
+// fixed rate. Full rate while any key is moving; once nothing has changed for
+// SCAN_IDLE_AFTER_US it drops to the idle rate until the next change. The
+// period must cover one whole frame (the 12 rows' settle times plus overhead).
+// tools/settle_profile.py warns if a measured profile does not fit.
+#define SCAN_PERIOD_US          6500    // ~154 Hz while keys are moving
+#define SCAN_IDLE_PERIOD_US     20000   // 50 Hz when idle
+#define SCAN_IDLE_AFTER_US      250000  // Quiet time before dropping to idle
+
+// Phase-lock scans to the USB start-of-frame (scan_scheduler.h): while the
+// host sends SOFs, scan periods are whole 1 ms frames and every scan is
+// steered to finish SOF_SCAN_LEAD_US before an SOF, so its events are queued
+// just ahead of the next IN poll. Comment out to run the scan alarm free of
+// the USB clock.
+#define SCAN_SOF_LOCK
+#define SOF_SCAN_LEAD_US        250     // Scan done to SOF: core0 drain + flush
+
+// Idle wake (idle_wake.h): after IDLE_WAKE_FRAMES scans in a row with no
+// sensor closed and nothing moving, stop scanning, drive every row high and
+// sleep until a read pin rises. Comment out to keep scanning at
+// SCAN_IDLE_PERIOD_US instead.
+#define IDLE_WAKE
+#define IDLE_WAKE_FRAMES        48      // ~0.45 s: 38 scans at full rate, then the idle rate
+
+// Scan the matrix with the PIO + DMA scanner (pio_scanner.c) instead of the
+// busy-wait scan_matrix() loop. Comment out to fall back to the CPU scan.
+#define SCAN_USE_PIO
+
+// CPU scan (scan_matrix): drive the next row as soon as one is sampled and
+// process the sampled row while the next one settles (1), or read the whole
+// matrix before processing it (0). Settle times are minimums either way:
+// processing only takes the place of the wait it overlaps. Overridable from
+// the build (the simulator builds both).
+#ifndef SCAN_PIPELINE
+#define SCAN_PIPELINE       1
+#endif
+
+// Run scanning and velocity detection on core1 and USB/MIDI on core0, linked
+// by a lock-free note event queue (note_queue.h). Comment out to run
+// everything from the core0 main loop.
+#define SCAN_ON_CORE1
+
+// Record cycle counts per main loop phase (profiler.h), readable over SysEx.
+// Comment out to compile the profiler out.
+#define PROFILE_ENABLED
+
+// Stream raw matrix frames over SysEx on request (trace_capture.h), to record
+// real playing with tools/trace_capture.py. Costs one atomic load per frame
+// while not capturing. Comment out to compile it out.
+#define TRACE_CAPTURE
+
+// 5-pin DIN MIDI output (midi_uart.h) next to USB: UART0 TX on MIDI_UART_TX_PIN
+// at 31250 baud, fed by DMA. Comment out to build USB-only.
+#define MIDI_UART_ENABLED
+#define MIDI_UART_TX_PIN    28
+#define MIDI_UART_BAUD      31250
+
+// USB-MIDI 2.0 (ump.h, midi_in.h): once a host selects UMP and negotiates the
+// MIDI 2.0 protocol, notes go out with 16-bit velocity; any other host gets
+// MIDI 1.0. Simulator only: there is no USB-MIDI 2.0 class driver behind
+// usb_midi_ump_*() on hardware, and usb_descriptors.c refuses to build with
+// it. The simulator turns it on against its modelled host.
+// #define MIDI_UMP_ENABLED
+
+#ifdef MIDI_UMP_ENABLED
+// MIDI 2.0 Note Ons carry the measured sensor delta (4 us units) as a
+// manufacturer-specific attribute. Comment out to send no attribute.
+#define MIDI_UMP_DELTA_ATTR
+#endif
+
+// ============================================================================
+// VELOCITY CONFIGURATION
+// ============================================================================
+
+// Enable velocity debug output (requires USB serial)
+// #define VELOCITY_DEBUG
+
+// Velocity timing constants (in microseconds)
+#define VELOCITY_TIMEOUT_US     150000  // 150ms - timeout for second sensor
+#define VELOCITY_MIN_TIME_US    2000    // 5ms - fastest possible press (velocity 127)
+#define VELOCITY_MAX_TIME_US    80000  // 100ms - slowest press (velocity 1)
+#define VELOCITY_DEFAULT        64      // Default velocity for single-sensor keys
+
+// Velocity curves (tables generated by tools/gen_velocity_curves.py)
+// Shorter time = faster press = higher velocity
+// Time range: 5ms (fast) to 100ms (slow)
+// Velocity range: 127 (fast) to 1 (slow)
+#define VELOCITY_CURVE_SHIFT    8       // Table step = 256us of sensor delta
+#define VELOCITY_CURVE_CC       20      // MIDI CC (undefined in the spec) selecting the curve, value = curve number
+
+// Note Off carries a release velocity from the time between the second and
+// the first sensor opening, on the same curve as Note On. Comment out to send
+// Note Off with velocity 0.
+#define RELEASE_VELOCITY
+
+// Send Note Off as soon as the second sensor opens (no release velocity),
+// and a new Note On if it closes again before the first sensor opens, for
+// fast repeated notes. Also switchable at runtime with EARLY_NOTE_OFF_CC
+// (value >= 64 on).
+// #define EARLY_NOTE_OFF
+#define EARLY_NOTE_OFF_CC       21      // MIDI CC (undefined in the spec) switching early Note Off
+
+// Velocity state is tracked for each MIDI note (0-127, plus extended 128-143)
+#define MAX_NOTES 144
+
+#endif // KEYBOARD_CONFIG_H
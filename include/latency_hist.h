@@ -0,0 +1,51 @@
+/*
+ * Latency Histograms
+ *
+ * Key-to-USB latency per pipeline stage, each measured from the row sample
+ * of the edge that completed the note event:
+ *   accept    debounce accepted the change (scan engine)
+ *   decision  velocity decided, note event emitted (scan engine)
+ *   fifo      packet accepted into the TinyUSB TX FIFO (midi_out_flush)
+ *   usb       packet taken by the host (IN endpoint idle again)
+ *
+ * Buckets are powers of two: bucket 0 is 0-15 us, bucket k covers
+ * [8 << k, 16 << k) us and the last bucket is open-ended. Counts are only
+ * updated on the USB core. Dumped over SysEx (sysex.h).
+ */
+
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+
+#define LATENCY_HIST_BUCKETS  16
+
+typedef enum {
+    LATENCY_ACCEPT,
+    LATENCY_DECISION,
+    LATENCY_FIFO,
+    LATENCY_USB,
+    LATENCY_STAGE_COUNT,
+} latency_stage_t;
+
+// Bucket index for a latency in microseconds
+static inline uint8_t latency_hist_bucket(uint32_t us) {
+    if (us < 16) return 0;
+    uint32_t bucket = 32 - (uint32_t)__builtin_clz(us >> 4);
+    return bucket < LATENCY_HIST_BUCKETS ? (uint8_t)bucket : LATENCY_HIST_BUCKETS - 1;
+}
+
+// Lowest latency (us) counted in a bucket
+static inline uint32_t latency_hist_bucket_floor_us(uint8_t bucket) {
+    return bucket == 0 ? 0 : 8u << bucket;
+}
+
+// Clear all histograms
+void latency_hist_clear(void);
+
+void latency_hist_add(latency_stage_t stage, uint32_t us);
+
+// Bucket counts for one stage (LATENCY_HIST_BUCKETS entries)
+const uint32_t *latency_hist_counts(latency_stage_t stage);
+
+#endif // LATENCY_HIST_H
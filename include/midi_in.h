@@ -0,0 +1,28 @@
+/*
+ * MIDI Input
+ *
+ * Handles MIDI sent to the keyboard by the host over USB:
+ *   Control Change VELOCITY_CURVE_CC (any channel): select velocity curve
+ *     (value = velocity_curve_t, see velocity_curves.h)
+ *   Control Change EARLY_NOTE_OFF_CC (any channel): early Note Off on
+ *     (value >= 64) or off, see scan_engine_set_early_note_off()
+ *   Control Change 120/123 (All Sound Off / All Notes Off, any channel):
+ *     Note Off for every sounding key, see scan_engine_all_notes_off()
+ *   SysEx requests (sysex.h): diagnostics such as the latency histograms
+ *
+ * With MIDI_UMP_ENABLED (simulator only: no USB-MIDI 2.0 class driver on
+ * hardware yet) it also follows a USB-MIDI 2.0 host (ump.h): the same
+ * messages as UMP, plus Endpoint Discovery and the Stream
+ * Configuration Request that switches midi_out to the MIDI 2.0 protocol.
+ * A host that never selects UMP, or never asks for MIDI 2.0, gets MIDI 1.0.
+ *
+ * Runs on the core that owns TinyUSB.
+ */
+
+#ifndef MIDI_IN_H
+#define MIDI_IN_H
+
+// Read and handle every pending USB MIDI packet (or UMP word)
+void midi_in_task(void);
+
+#endif // MIDI_IN_H
@@ -0,0 +1,112 @@
+/*
+ * MIDI Output
+ *
+ * Turns note events into 4-byte USB-MIDI event packets. With
+ * MIDI_UMP_ENABLED (simulator only, see keyboard_config.h) they become
+ * Universal MIDI Packets (ump.h) once a USB-MIDI 2.0 host has selected UMP;
+ * midi_in.c follows the host's choice with midi_out_set_protocol(). Events are collected
+ * in a backlog and written to TinyUSB in one midi_out_flush() per pass of
+ * the USB loop; packets the TX FIFO cannot take stay queued for the next
+ * flush instead of being lost. Runs on the core that owns TinyUSB.
+ *
+ * Note events also fan out to every transport added with
+ * midi_out_add_transport(), e.g. the DIN port in midi_uart.h; SysEx replies
+ * only go to USB, where the requests come from.
+ *
+ * Also records the fifo and usb stages of the latency histograms
+ * (latency_hist.h) for note packets.
+ */
+
+#ifndef MIDI_OUT_H
+#define MIDI_OUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "keyboard_config.h"
+#include "note_event.h"
+
+// Packets held between flushes (power of two). A full 144-note chord on and
+// off is 288 packets; the FIFO drains at least 16 per USB frame.
+#define MIDI_OUT_BACKLOG_PACKETS  512
+
+#ifdef MIDI_UMP_ENABLED
+// What the USB port speaks
+typedef enum {
+    MIDI_OUT_USB_MIDI1,     // USB-MIDI 1.0 event packets (alternate setting 0)
+    MIDI_OUT_UMP_MIDI1,     // UMP with the MIDI 1.0 protocol (MT 0x2), until negotiated
+    MIDI_OUT_UMP_MIDI2,     // UMP with the MIDI 2.0 protocol: 16-bit note velocity
+} midi_out_protocol_t;
+#endif
+
+// Transports besides USB
+#define MIDI_OUT_MAX_TRANSPORTS   2
+
+// A byte-stream or other output fed alongside USB. Both calls come from the
+// core that owns midi_out and must not block.
+typedef struct {
+    // Queue one MIDI 1.0 channel message; false if it had to be dropped
+    bool (*send)(const uint8_t msg[3]);
+    // Start sending what was queued (once per midi_out_flush)
+    void (*flush)(void);
+} midi_transport_t;
+
+typedef struct {
+    uint32_t sent;          // Packets (UMP: words) accepted by the TX FIFO
+    uint32_t deferred;      // Packets left queued at the end of a flush (per flush)
+    uint32_t dropped;       // Packets lost: backlog full or USB not mounted
+    uint32_t fifo_full;     // Flushes cut short by a full TX FIFO (short writes)
+} midi_out_stats_t;
+
+// Clear the backlog, counters and added transports; back to USB-MIDI 1.0
+void midi_out_init(void);
+
+#ifdef MIDI_UMP_ENABLED
+// Switch the USB port's format. Queued packets of the old format are dropped.
+void midi_out_set_protocol(midi_out_protocol_t p);
+midi_out_protocol_t midi_out_protocol(void);
+#endif
+
+// Send note events to t as well as USB, until the next midi_out_init().
+// Returns false if MIDI_OUT_MAX_TRANSPORTS are already added.
+bool midi_out_add_transport(const midi_transport_t *t);
+
+// Queue one note event for USB and hand it to every added transport
+// Notes 0-127: sent on channel 0
+// Notes 128-143: sent as (note - 128) on channel 1 (for DEBUG mode)
+void midi_out_note_event(const note_event_t *ev);
+
+// Queue a complete SysEx message (F0 ... F7). All or nothing: returns false,
+// counting the packets as dropped, if the backlog cannot take all of it.
+bool midi_out_sysex(const uint8_t *msg, uint32_t len);
+
+#ifdef MIDI_UMP_ENABLED
+// Queue a complete UMP message, e.g. a Stream reply (UMP protocols only).
+// All or nothing, like midi_out_sysex().
+bool midi_out_ump(const uint32_t *words, uint32_t count);
+#endif
+
+// Write queued packets, oldest first, until TinyUSB's TX FIFO is full, then
+// flush every added transport
+void midi_out_flush(void);
+
+// Packets waiting for the next flush
+uint32_t midi_out_backlog(void);
+
+void midi_out_get_stats(midi_out_stats_t *out);
+
+// Implemented next to the endpoint numbers in usb_descriptors.c:
+
+// True while the MIDI IN endpoint has a transfer in progress
+bool usb_midi_tx_busy(void);
+
+#ifdef MIDI_UMP_ENABLED
+// USB-MIDI 2.0: true while the host has the UMP alternate setting selected.
+// Writes take whole messages (false: no room), reads return one word from
+// the host at a time (false: none pending). Only the simulator's host model
+// (sim_hal.c) implements these; usb_descriptors.c has no alternate setting 1.
+bool usb_midi_ump_selected(void);
+bool usb_midi_ump_write(const uint32_t *words, uint32_t count);
+bool usb_midi_ump_read(uint32_t *word);
+#endif
+
+#endif // MIDI_OUT_H
@@ -0,0 +1,54 @@
+/*
+ * MIDI Byte-Stream Encoder
+ *
+ * Serializes MIDI 1.0 channel messages for byte-stream transports (DIN /
+ * UART MIDI at 31250 baud, 320 us per byte). Two optional savings, both
+ * part of MIDI 1.0:
+ *   MIDI_STREAM_RUNNING_STATUS   leave the status byte out while it repeats
+ *   MIDI_STREAM_ZERO_VEL_OFF     send Note Off as Note On with velocity 0, so
+ *                                presses and releases share one status; a
+ *                                release velocity is dropped
+ * With both, a dense chord costs two bytes per event after the first one;
+ * the sim trace replays measure 2.01-2.04. With running status alone,
+ * releases keep their velocity (RELEASE_VELOCITY) and their own status:
+ * 2.70 bytes per event for a glissando, 3.00 for a trill.
+ *
+ * USB-MIDI packets carry their own status, so midi_out.c does not use this.
+ */
+
+#ifndef MIDI_STREAM_H
+#define MIDI_STREAM_H
+
+#include <stdint.h>
+#include "note_event.h"
+
+// midi_stream_t.flags
+#define MIDI_STREAM_RUNNING_STATUS  0x01
+#define MIDI_STREAM_ZERO_VEL_OFF    0x02
+#define MIDI_STREAM_COMPACT         (MIDI_STREAM_RUNNING_STATUS | MIDI_STREAM_ZERO_VEL_OFF)
+
+// Longest message the encoder writes
+#define MIDI_STREAM_MAX_BYTES       3
+
+typedef struct {
+    uint8_t flags;      // MIDI_STREAM_*
+    uint8_t status;     // Running status on the line, 0 = none
+} midi_stream_t;
+
+void midi_stream_init(midi_stream_t *s, uint8_t flags);
+
+// Forget the running status, so the next message sends its status byte.
+// Call after a SysEx or System Common message went out on the same line,
+// and whenever the line (re)starts. System Real-Time bytes need not.
+void midi_stream_reset(midi_stream_t *s);
+
+// Encode one channel message (status 0x80-0xEF) into out; returns its
+// length, 1-3 bytes (0 for a status outside that range)
+uint32_t midi_stream_channel_msg(midi_stream_t *s, uint8_t status, uint8_t data1, uint8_t data2,
+                                 uint8_t out[MIDI_STREAM_MAX_BYTES]);
+
+// Encode a note event, mapped to a message as by note_event_to_midi()
+uint32_t midi_stream_note_event(midi_stream_t *s, const note_event_t *ev,
+                                uint8_t out[MIDI_STREAM_MAX_BYTES]);
+
+#endif // MIDI_STREAM_H
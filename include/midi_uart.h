@@ -0,0 +1,50 @@
+/*
+ * DIN MIDI Output (UART)
+ *
+ * A midi_out transport (midi_out.h) for a 5-pin DIN port: UART0 at
+ * MIDI_UART_BAUD on MIDI_UART_TX_PIN. Messages are encoded into a byte ring
+ * with the byte-stream encoder (midi_stream.h) and a DMA channel paced by the
+ * UART's TX DREQ moves them to the line, so queuing never waits for the wire.
+ * midi_out_flush() starts the next transfer once the previous one is done;
+ * the 32-byte UART FIFO keeps the line busy in between.
+ *
+ * At 320 us per byte a full ring is about 330 ms of line time; messages that
+ * do not fit are dropped and counted, never split.
+ */
+
+#ifndef MIDI_UART_H
+#define MIDI_UART_H
+
+#include <stdint.h>
+#include "midi_out.h"
+#include "midi_stream.h"
+
+// Byte ring the DMA reads (power of two; the buffer is aligned to its size
+// so the DMA read ring wraps with it)
+#define MIDI_UART_RING_BITS     10
+#define MIDI_UART_RING_BYTES    (1u << MIDI_UART_RING_BITS)
+
+// Encoder mode (midi_stream.h): running status plus velocity-0 Note Offs,
+// about two bytes per event (2.01-2.04 in the sim trace replays) without
+// release velocity. MIDI_STREAM_RUNNING_STATUS alone keeps release velocity
+// at 2.7-3 bytes per event. Overridable from the build.
+#ifndef MIDI_UART_STREAM_FLAGS
+#define MIDI_UART_STREAM_FLAGS  MIDI_STREAM_COMPACT
+#endif
+
+typedef struct {
+    uint32_t messages;      // Messages queued
+    uint32_t bytes;         // Bytes queued
+    uint32_t dropped;       // Messages lost to a full ring
+    uint32_t max_fill;      // Most bytes waiting in the ring
+} midi_uart_stats_t;
+
+// Set up the pin, UART and DMA channel and clear the ring and counters
+void midi_uart_init(void);
+
+void midi_uart_get_stats(midi_uart_stats_t *out);
+
+// For midi_out_add_transport()
+extern const midi_transport_t midi_uart_transport;
+
+#endif // MIDI_UART_H
@@ -0,0 +1,46 @@
+/*
+ * Note Events
+ *
+ * Compact timestamped note on/off produced by the scan engine and consumed
+ * by the MIDI output. Sixteen bytes so a burst of all 61 keys fits in a small
+ * queue between the scanning core and the USB core. The stage delays feed
+ * the latency histograms (latency_hist.h) on the USB core.
+ */
+
+#ifndef NOTE_EVENT_H
+#define NOTE_EVENT_H
+
+#include <stdint.h>
+
+// note_event_t.flags
+#define NOTE_EVENT_ON       0x01    // Note On (clear = Note Off)
+#define NOTE_EVENT_MEASURED 0x02    // Velocity from a measured sensor interval
+
+// note_event_t.sensor_delta unit: 4 us, so 16 bits cover the velocity timeout
+#define NOTE_EVENT_DELTA_SHIFT  2
+
+typedef struct {
+    uint32_t time_us;   // Sample time of the edge that produced the event (low 32 bits)
+    uint8_t note;       // Engine note index (0-127, 128-143 extended)
+    uint8_t velocity;   // 1-127 for Note On; release velocity for Note Off (0: not measured)
+    uint8_t flags;      // NOTE_EVENT_*
+    uint8_t reserved;
+    uint16_t accept_us;     // Sample to debounce accept (saturates at 65535)
+    uint16_t decision_us;   // Sample to velocity decision (saturates at 65535)
+    uint16_t velocity16;    // MIDI 2.0 velocity (velocity_curve_lookup16), 0 if not measured for Note Off
+    uint16_t sensor_delta;  // Press delta or release interval >> NOTE_EVENT_DELTA_SHIFT if NOTE_EVENT_MEASURED (saturates)
+} note_event_t;
+
+// Receives every event the scan engine produces
+typedef void (*note_event_sink_t)(const note_event_t *ev);
+
+// MIDI 1.0 Note On/Off for an event. Notes 0-127 go on channel 0, extended
+// notes 128-143 (DEBUG mode) as note - 128 on channel 1.
+static inline void note_event_to_midi(const note_event_t *ev, uint8_t msg[3]) {
+    uint8_t channel = ev->note >= 128 ? 1 : 0;
+    msg[0] = (uint8_t)(((ev->flags & NOTE_EVENT_ON) ? 0x90 : 0x80) | channel);
+    msg[1] = (uint8_t)(ev->note & 0x7F);
+    msg[2] = ev->velocity;
+}
+
+#endif // NOTE_EVENT_H
@@ -285,6 +285,11 @@ static const uint8_t note_map[NUM_DRIVE_PINS][NUM_READ_PINS] = {
 };
 #endif
 
+// Sensor maps: tools/gen_position_table.py inverts these at build time into
+// sensor_positions_table.h in <build>/generated (read through
+// include/sensor_positions.h) and fails unless every note has exactly one
+// first and one second sensor.
+
 // First sensor (triggers first when key is pressed)
 static const uint8_t first_sensor_map[NUM_DRIVE_PINS][NUM_READ_PINS] = {
     //           Col:     0         1         2         3         4         5         6         7         8         9         10        11
@@ -0,0 +1,63 @@
+/*
+ * Note Event Queue
+ *
+ * Single-producer / single-consumer lock-free ring of note_event_t. Core1
+ * (scanner) pushes, core0 (USB) pops. Head and tail are free-running 32-bit
+ * counters, each written by one side only; acquire/release ordering makes the
+ * event slot visible before the index that publishes it.
+ *
+ * Header-only so the host simulator can stress it with real threads.
+ */
+
+#ifndef NOTE_QUEUE_H
+#define NOTE_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "note_event.h"
+
+// Must be a power of two; holds two full 61-key bursts (press + release)
+#define NOTE_QUEUE_SIZE  256
+#define NOTE_QUEUE_MASK  (NOTE_QUEUE_SIZE - 1)
+
+typedef struct {
+    note_event_t events[NOTE_QUEUE_SIZE];
+    _Atomic uint32_t head;  // Next slot to write (producer only)
+    _Atomic uint32_t tail;  // Next slot to read (consumer only)
+} note_queue_t;
+
+static inline void note_queue_init(note_queue_t *q) {
+    atomic_store_explicit(&q->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&q->tail, 0, memory_order_relaxed);
+}
+
+// Producer side. Returns false if the queue is full.
+static inline bool note_queue_push(note_queue_t *q, const note_event_t *ev) {
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    if (head - tail >= NOTE_QUEUE_SIZE) return false;
+
+    q->events[head & NOTE_QUEUE_MASK] = *ev;
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Consumer side. Returns false if the queue is empty.
+static inline bool note_queue_pop(note_queue_t *q, note_event_t *ev) {
+    uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (head == tail) return false;
+
+    *ev = q->events[tail & NOTE_QUEUE_MASK];
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Events waiting (either side; may be stale by the time it is used)
+static inline uint32_t note_queue_count(note_queue_t *q) {
+    return atomic_load_explicit(&q->head, memory_order_acquire) -
+           atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+#endif // NOTE_QUEUE_H
@@ -0,0 +1,65 @@
+/*
+ * Note Set
+ *
+ * Fixed 144-bit set of engine note indices (one bit per note, 0-143), for
+ * tracking which notes are sounding without walking per-note state.
+ */
+
+#ifndef NOTE_SET_H
+#define NOTE_SET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "note_map.h"
+#include "keyboard_config.h"
+
+#define NOTE_SET_WORDS  ((MAX_NOTES + 31) / 32)
+
+typedef struct {
+    uint32_t bits[NOTE_SET_WORDS];
+} note_set_t;
+
+static inline void note_set_clear(note_set_t *set) {
+    for (int i = 0; i < NOTE_SET_WORDS; i++) {
+        set->bits[i] = 0;
+    }
+}
+
+static inline bool note_set_contains(const note_set_t *set, uint8_t note) {
+    return (set->bits[note >> 5] >> (note & 31)) & 1;
+}
+
+// Returns true if the note was not already in the set
+static inline bool note_set_add(note_set_t *set, uint8_t note) {
+    uint32_t mask = 1u << (note & 31);
+    bool added = !(set->bits[note >> 5] & mask);
+    set->bits[note >> 5] |= mask;
+    return added;
+}
+
+// Returns true if the note was in the set
+static inline bool note_set_remove(note_set_t *set, uint8_t note) {
+    uint32_t mask = 1u << (note & 31);
+    bool removed = (set->bits[note >> 5] & mask) != 0;
+    set->bits[note >> 5] &= ~mask;
+    return removed;
+}
+
+// First note >= from in the set, or NOTE_NONE. Iterate with:
+//   for (n = note_set_next(s, 0); n != NOTE_NONE; n = note_set_next(s, n + 1))
+static inline uint8_t note_set_next(const note_set_t *set, uint32_t from) {
+    if (from >= MAX_NOTES) return NOTE_NONE;
+
+    uint32_t word = from >> 5;
+    uint32_t bits = set->bits[word] & (~0u << (from & 31));
+    while (true) {
+        if (bits) {
+            uint32_t note = (word << 5) + (uint32_t)__builtin_ctz(bits);
+            return note < MAX_NOTES ? (uint8_t)note : NOTE_NONE;
+        }
+        if (++word >= NOTE_SET_WORDS) return NOTE_NONE;
+        bits = set->bits[word];
+    }
+}
+
+#endif // NOTE_SET_H
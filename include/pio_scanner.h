@@ -0,0 +1,91 @@
+/*
+ * PIO + DMA Matrix Scanner
+ *
+ * A PIO state machine (src/matrix_scan.pio) walks drive pins 0-11 and samples
+ * the read pins after a per-row settle delay. DMA feeds it the row descriptors
+ * and writes the 12 raw row samples into a double-buffered frame, and the DMA
+ * completion IRQ marks the frame ready. Frames are started one at a time by
+ * pio_scanner_start_frame() (the scan scheduler's tick). The CPU never
+ * busy-waits.
+ *
+ * The descriptor/sample format and timing helpers below are plain C so the
+ * host simulator (sim/pio_model.c) can check them without hardware.
+ */
+
+#ifndef PIO_SCANNER_H
+#define PIO_SCANNER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "note_map.h"
+
+// PIO state machine clock: one settle loop iteration per microsecond
+#define PIO_SCAN_CLOCK_HZ       1000000
+
+// PIO cycles per row beyond the settle loop count
+#define PIO_SCAN_ROW_OVERHEAD   7
+
+// PIO cycles from driving the row to sampling it, beyond the settle loop count
+#define PIO_SCAN_SAMPLE_OFFSET  3
+
+// Sampled pins start at GPIO 12; GPIO 23-25 fall inside the 15-bit window
+#define PIO_SCAN_IN_BASE        12
+#define PIO_SCAN_IN_BITS        15
+
+// Build the TX descriptor for one row: drive pattern + settle loop count
+static inline uint32_t pio_scan_descriptor(uint8_t drive, uint32_t settle_us) {
+    uint32_t cycles = settle_us * (PIO_SCAN_CLOCK_HZ / 1000000);
+    uint32_t loops = cycles > PIO_SCAN_SAMPLE_OFFSET ? cycles - PIO_SCAN_SAMPLE_OFFSET : 0;
+    if (loops > 0xFFFFF) loops = 0xFFFFF;
+    return (1u << drive) | (loops << 12);
+}
+
+// PIO cycles the descriptor keeps the state machine busy for
+static inline uint32_t pio_scan_row_cycles(uint32_t descriptor) {
+    return (descriptor >> 12) + PIO_SCAN_ROW_OVERHEAD;
+}
+
+// Microseconds from the start of a frame to each row's sample. The state
+// machine waits on pull between frames, so a frame starts when its first
+// descriptor arrives: each row is driven one cycle after its pull and sampled
+// PIO_SCAN_SAMPLE_OFFSET + settle loop cycles after that.
+static inline void pio_scan_sample_offsets(const uint32_t descriptors[NUM_DRIVE_PINS],
+                                           uint32_t offset_us[NUM_DRIVE_PINS]) {
+    uint32_t row_start = 0;
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        uint32_t cycles = row_start + 1 + PIO_SCAN_SAMPLE_OFFSET + (descriptors[drive] >> 12);
+        offset_us[drive] = (uint32_t)((uint64_t)cycles * 1000000u / PIO_SCAN_CLOCK_HZ);
+        row_start += pio_scan_row_cycles(descriptors[drive]);
+    }
+}
+
+// Convert a raw RX sample (GPIO 12-26) to a row word (columns 0-11)
+// Columns 0-10 = GPIO 12-22, Column 11 = GPIO 26
+static inline uint16_t pio_scan_sample_to_row(uint32_t sample) {
+    return (uint16_t)((sample & 0x7FF) | ((sample >> 3) & 0x800));
+}
+
+// Claim a PIO state machine and two DMA channels, ready to scan.
+// settle_us[drive] is the settle time for each row.
+void pio_scanner_init(const uint32_t settle_us[NUM_DRIVE_PINS]);
+
+// Start one frame; returns false if the previous frame is still running.
+// Usable as a scan_trigger_t from the scheduler's alarm IRQ.
+bool pio_scanner_start_frame(void);
+
+// Change one row's settle time; takes effect from the next frame
+void pio_scanner_set_settle(uint8_t drive, uint32_t settle_us);
+
+// Copy the newest completed frame into rows and return true, or return false
+// if no new frame finished since the last call. row_time[drive] is when that
+// row was sampled (time_us_32): the frame's start time plus the row's offset
+// from pio_scan_sample_offsets().
+bool pio_scanner_get_frame(uint16_t rows[NUM_DRIVE_PINS], uint32_t row_time[NUM_DRIVE_PINS]);
+
+// True while a frame is running or waiting for pio_scanner_get_frame()
+bool pio_scanner_busy(void);
+
+// Frames completed before the CPU collected the previous one
+uint32_t pio_scanner_dropped_frames(void);
+
+#endif // PIO_SCANNER_H
@@ -0,0 +1,94 @@
+/*
+ * Main Loop Phase Profiler
+ *
+ * Cycle counts per main loop phase, from the SysTick counter of the core the
+ * phase runs on (24-bit, processor clock). Each phase keeps count, min, max,
+ * the sum for the mean and a quarter-octave histogram for the p99 estimate.
+ * Dumped over SysEx (sysex.h).
+ *
+ * Every phase is recorded by one core only. Clearing from core0 is not
+ * synchronized with core1, so a core1 sample in progress may survive a clear.
+ *
+ * Compiled out unless PROFILE_ENABLED is defined (keyboard_config.h): the
+ * PROFILE_BEGIN/PROFILE_END markers then expand to nothing.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "keyboard_config.h"
+#include "hardware/structs/systick.h"
+
+typedef enum {
+    PROFILE_TUD_TASK,           // tud_task() (core0)
+    PROFILE_MIDI_IN,            // midi_in_task() (core0)
+    PROFILE_MIDI_OUT,           // Note queue drain + midi_out_flush() (core0)
+    PROFILE_LED,                // update_led() (core0)
+    PROFILE_SCAN_ROW,           // One CPU scan row (pipelined: also its processing)
+    PROFILE_DEBOUNCE,           // Debounce + dispatch per frame (pipelined: deferred part)
+    PROFILE_VELOCITY_TIMEOUT,   // check_velocity_timeout() once per frame
+    PROFILE_PHASE_COUNT,
+} profile_phase_t;
+
+// SysTick counts down over 24 bits
+#define PROFILE_CYCLE_MASK      0xFFFFFFu
+
+// Histogram: values 0-3 get one bucket each, then 4 buckets per octave up to
+// 2^17 cycles (about 1 ms at 125 MHz); the last bucket is open-ended
+#define PROFILE_HIST_BUCKETS    64
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t mean_cycles;
+    uint32_t max_cycles;
+    uint32_t p99_cycles;        // Upper edge of the bucket holding the 99th percentile
+} profile_stats_t;
+
+// Histogram bucket for a cycle count
+static inline uint8_t profile_hist_bucket(uint32_t cycles) {
+    if (cycles < 4) return (uint8_t)cycles;
+    uint32_t msb = 31 - (uint32_t)__builtin_clz(cycles);
+    uint32_t bucket = (msb - 1) * 4 + ((cycles >> (msb - 2)) & 3);
+    return bucket < PROFILE_HIST_BUCKETS ? (uint8_t)bucket : PROFILE_HIST_BUCKETS - 1;
+}
+
+// Lowest cycle count in a bucket
+static inline uint32_t profile_hist_bucket_floor(uint8_t bucket) {
+    if (bucket < 4) return bucket;
+    return (4u + (bucket & 3u)) << (bucket / 4u - 1u);
+}
+
+#ifdef PROFILE_ENABLED
+
+// Start the calling core's SysTick as a free-running cycle counter; call once
+// on each core that records phases
+void profile_init(void);
+
+// Clear all phases
+void profile_clear(void);
+
+void profile_record(profile_phase_t phase, uint32_t cycles);
+
+void profile_get_stats(profile_phase_t phase, profile_stats_t *out);
+
+static inline uint32_t profile_cycles(void) {
+    return systick_hw->cvr;
+}
+
+// Time the code between a PROFILE_BEGIN(t) and a PROFILE_END(t, phase) in
+// the same block
+#define PROFILE_BEGIN(t)        uint32_t t = profile_cycles()
+#define PROFILE_END(t, phase)   profile_record((phase), ((t) - profile_cycles()) & PROFILE_CYCLE_MASK)
+
+#else
+
+static inline void profile_init(void) {}
+
+#define PROFILE_BEGIN(t)        ((void)0)
+#define PROFILE_END(t, phase)   ((void)0)
+
+#endif // PROFILE_ENABLED
+
+#endif // PROFILER_H
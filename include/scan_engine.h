@@ -0,0 +1,104 @@
+/*
+ * Scan Engine - Dual-Sensor Matrix Scanning + Velocity Detection
+ *
+ * Hardware access goes through the Pico SDK calls gpio_put, gpio_get_all,
+ * time_us_32 and busy_wait_us_32 only, so the same source builds for the
+ * Pico and against the stand-in layer in sim/. Note on/off results leave the
+ * engine as note_event_t through the sink given to scan_engine_init().
+ */
+
+#ifndef SCAN_ENGINE_H
+#define SCAN_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "note_map.h"
+#include "note_event.h"
+#include "note_set.h"
+
+// Health counters, written by the scanning core. All count from
+// scan_engine_init() and wrap.
+typedef struct {
+    uint32_t frames;                // Frames processed
+    uint32_t debounce_rejects;      // Positions that differed, then agreed again before debouncing passed
+    uint32_t velocity_timeouts;     // Note Ons at the default velocity, second sensor never closed
+    uint32_t second_without_first;  // Second sensor closed with the first never seen (default velocity)
+    uint32_t max_frame_events;      // Most note events from one frame
+} scan_engine_stats_t;
+
+// Clear debounce and velocity state and the counters; events go to sink
+void scan_engine_init(note_event_sink_t sink);
+
+// Scan entire matrix for both first and second sensors, emit note events
+// (CPU path: drives each row with gpio_put and busy-waits its settle time;
+// with SCAN_PIPELINE the previous row is processed during that wait)
+void scan_matrix(void);
+
+// CPU scan: minimum time a row is driven before it is sampled, from the next
+// scan_matrix() on. scan_engine_init() resets every row to its measured
+// value in settle_profile.h.
+// The PIO scanner has its own (pio_scanner_set_settle).
+void scan_engine_set_settle(uint8_t drive, uint32_t settle_us);
+
+// Process one frame of row words captured elsewhere (e.g. by the PIO scanner).
+// rows[drive] holds read columns 0-11 in bits 0-11; row_time[drive] is when
+// that row was sampled (time_us_32, wrap-safe, in scan order). Sensor edges
+// are timed per row, so velocity deltas are not quantized to the frame.
+void scan_engine_process_frame(const uint16_t rows[NUM_DRIVE_PINS],
+                               const uint32_t row_time[NUM_DRIVE_PINS]);
+
+// Receives every frame the engine processes, after its events: the same rows
+// and sample times as scan_engine_process_frame() takes (trace capture)
+typedef void (*scan_frame_tap_t)(const uint16_t rows[NUM_DRIVE_PINS],
+                                 const uint32_t row_time[NUM_DRIVE_PINS]);
+
+// Install the frame tap, NULL to remove it. Survives scan_engine_init().
+// Call from the scanning core, or before it starts.
+void scan_engine_set_frame_tap(scan_frame_tap_t tap);
+
+// True if any note is currently sounding (used by the LED). O(1), safe to
+// call from the other core.
+bool scan_engine_any_note_on(void);
+
+// True if the last frame saw a sensor change (accepted or still debouncing)
+// or a note is waiting for its second sensor. Drives the scan scheduler's
+// idle rate.
+bool scan_engine_keys_moving(void);
+
+// True if any sensor is closed (debounced), sounding or not: a key resting
+// half-way keeps its read column high. Gates idle_wake.h's parking.
+bool scan_engine_any_closed(void);
+
+// Select the velocity curve (velocity_curve_t) for subsequent note-ons.
+// Returns false for an unknown curve. Safe to call from the other core.
+bool scan_engine_set_velocity_curve(uint8_t curve);
+uint8_t scan_engine_velocity_curve(void);
+
+// Send Note Off when the second sensor releases instead of when the key is
+// fully up (no release velocity), and a new Note On when the second sensor
+// closes again from a half release. Starts as EARLY_NOTE_OFF in
+// keyboard_config.h. Safe to call from the other core.
+void scan_engine_set_early_note_off(bool enabled);
+bool scan_engine_early_note_off(void);
+
+// Number of notes currently sounding. O(1), safe to call from the other core.
+uint32_t scan_engine_sounding_count(void);
+
+// Copy of the sounding-note set; iterate it with note_set_next(). Call from
+// the scanning core for an exact snapshot.
+void scan_engine_sounding_notes(note_set_t *out);
+
+// Copy of the counters. Each field is read whole, so it is safe from the
+// other core, but fields may come from different frames.
+void scan_engine_get_stats(scan_engine_stats_t *out);
+
+// Panic: send Note Off for every sounding note and return every key to idle,
+// dropping velocity measurements in progress. A key held through it sounds
+// again once struck again. Call from the scanning core.
+void scan_engine_all_notes_off(void);
+
+// Have the scanning core run scan_engine_all_notes_off() at the end of its
+// next frame. Safe to call from the other core (MIDI CC 120/123).
+void scan_engine_request_all_notes_off(void);
+
+#endif // SCAN_ENGINE_H
@@ -0,0 +1,76 @@
+/*
+ * Scan Scheduler
+ *
+ * Starts every matrix scan from a repeating hardware alarm instead of a
+ * sleep in the main loop, so the scan rate and velocity timing no longer
+ * depend on how long USB servicing takes. The rate is SCAN_PERIOD_US while
+ * keys are moving and SCAN_IDLE_PERIOD_US once the matrix has been quiet for
+ * SCAN_IDLE_AFTER_US.
+ *
+ * The alarm runs on the alarm pool of the core that calls
+ * scan_scheduler_init(), so with SCAN_ON_CORE1 the tick IRQ stays on core1.
+ *
+ * With SCAN_SOF_LOCK the alarm follows the USB frame clock while the host
+ * sends SOFs: the periods become whole 1 ms frames (SCAN_SOF_PERIOD_US,
+ * SCAN_SOF_IDLE_PERIOD_US) and after each scan the next tick is moved by
+ * the scan's phase error, so scans finish SOF_SCAN_LEAD_US before an SOF.
+ * tud_sof_cb() runs from tud_task() on the USB core, so its timestamps can
+ * be late but never early: the SOF grid estimate takes early samples at
+ * once and late ones only as far as crystal drift allows. Without SOFs
+ * (unplugged, suspended) the alarm free-runs at the usual periods.
+ */
+
+#ifndef SCAN_SCHEDULER_H
+#define SCAN_SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "keyboard_config.h"
+
+#define USB_FRAME_US            1000
+
+// Periods while locked to the SOF: the usual ones rounded up to whole frames
+#define SCAN_SOF_PERIOD_US      ((SCAN_PERIOD_US + USB_FRAME_US - 1) / USB_FRAME_US * USB_FRAME_US)
+#define SCAN_SOF_IDLE_PERIOD_US ((SCAN_IDLE_PERIOD_US + USB_FRAME_US - 1) / USB_FRAME_US * USB_FRAME_US)
+
+// Phase errors within this count as locked
+#define SOF_LOCK_TOLERANCE_US   50
+
+// No SOF for this long: free-run again
+#define SOF_TIMEOUT_US          10000
+
+// Starts one scan. Called from the alarm IRQ; returns false if the previous
+// scan has not finished (counted as an overrun, the tick is skipped).
+typedef bool (*scan_trigger_t)(void);
+
+typedef struct {
+    uint32_t rate_hz;           // Scans completed in the last full second
+    uint32_t period_us;         // Period currently scheduled
+    uint32_t ticks;             // Alarm ticks
+    uint32_t overruns;          // Ticks skipped because a scan was still running
+    uint32_t max_jitter_us;     // Largest tick deviation from its scheduled period
+    int32_t sof_phase_error_us; // Last scan's end minus its SOF target (SCAN_SOF_LOCK)
+    uint32_t sof_max_error_us;  // Largest |phase error| of a scan following a locked one
+    uint32_t sof_locked;        // Scans that ended within SOF_LOCK_TOLERANCE_US of target
+    uint32_t sof_unlocked;      // Scans measured against the SOF outside the tolerance
+} scan_scheduler_stats_t;
+
+// Start the repeating alarm at the full rate
+void scan_scheduler_init(scan_trigger_t trigger);
+
+// Report a processed scan; keys_moving keeps (or puts) the scheduler at the
+// full rate. Call from the scanning core after every frame.
+void scan_scheduler_frame_done(bool keys_moving);
+
+// Stop the alarm: no scans until scan_scheduler_resume() (idle_wake.h)
+void scan_scheduler_pause(void);
+
+// Start a scan right away and restart the alarm at the full rate
+void scan_scheduler_resume(void);
+
+// Achieved scan rate (O(1), safe from the other core)
+uint32_t scan_scheduler_rate_hz(void);
+
+void scan_scheduler_get_stats(scan_scheduler_stats_t *out);
+
+#endif // SCAN_SCHEDULER_H
@@ -0,0 +1,44 @@
+/*
+ * Sensor Positions
+ *
+ * Inverted view of first_sensor_map / second_sensor_map: one packed
+ * descriptor per matrix position giving the note it belongs to, which of the
+ * note's two sensors it is, and where the other sensor sits. A changed
+ * position needs one table read instead of two map lookups.
+ *
+ * sensor_first_mask[drive] has a bit set for every first-sensor column of
+ * the row, so a frame can handle first sensors before second sensors.
+ *
+ * The table itself (sensor_positions_table.h) is generated at build time by
+ * tools/gen_position_table.py, which also fails the build unless every note
+ * has exactly one first and one second sensor.
+ */
+
+#ifndef SENSOR_POSITIONS_H
+#define SENSOR_POSITIONS_H
+
+#include <stdint.h>
+#include "note_map.h"
+
+// sensor_position_t.role
+#define SENSOR_NONE     0   // Unused position
+#define SENSOR_FIRST    1   // Triggers first when the key goes down
+#define SENSOR_SECOND   2   // Triggers after the first sensor
+
+typedef struct {
+    uint8_t note;       // Engine note index, NOTE_NONE if unused
+    uint8_t role;       // SENSOR_*
+    uint8_t partner;    // Position index of the note's other sensor
+    uint8_t reserved;
+} sensor_position_t;
+
+// Position index used by the table and by partner
+#define SENSOR_POSITION_INDEX(drive, read)  ((drive) * NUM_READ_PINS + (read))
+
+#include "sensor_positions_table.h"
+
+static inline const sensor_position_t *sensor_position(uint8_t drive, uint8_t read) {
+    return &sensor_position_table[SENSOR_POSITION_INDEX(drive, read)];
+}
+
+#endif // SENSOR_POSITIONS_H
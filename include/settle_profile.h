@@ -0,0 +1,34 @@
+/*
+ * Per-Row Settle Profile
+ *
+ * Minimum settle time per drive row, used by the CPU scan
+ * (scan_engine_set_settle) and the PIO scanner (pio_scanner_init).
+ * Generated by tools/settle_profile.py from settle sweeps recorded with
+ * examples/gpio-test - do not edit:
+ *   no sweeps recorded for this board yet
+ * Rows no sweep measured use SCAN_SETTLE_US.
+ */
+
+#ifndef SETTLE_PROFILE_H
+#define SETTLE_PROFILE_H
+
+#include <stdint.h>
+#include "note_map.h"
+#include "keyboard_config.h"
+
+static const uint32_t settle_profile_us[NUM_DRIVE_PINS] = {
+    SCAN_SETTLE_US,   // Row 0: not measured
+    SCAN_SETTLE_US,   // Row 1: not measured
+    SCAN_SETTLE_US,   // Row 2: not measured
+    SCAN_SETTLE_US,   // Row 3: not measured
+    SCAN_SETTLE_US,   // Row 4: not measured
+    SCAN_SETTLE_US,   // Row 5: not measured
+    SCAN_SETTLE_US,   // Row 6: not measured
+    SCAN_SETTLE_US,   // Row 7: not measured
+    SCAN_SETTLE_US,   // Row 8: not measured
+    SCAN_SETTLE_US,   // Row 9: not measured
+    SCAN_SETTLE_US,   // Row 10: not measured
+    SCAN_SETTLE_US,   // Row 11: not measured
+};
+
+#endif // SETTLE_PROFILE_H
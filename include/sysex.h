@@ -0,0 +1,67 @@
+/*
+ * SysEx Commands
+ *
+ * Request/response protocol on the USB MIDI port, under the non-commercial
+ * manufacturer ID 0x7D:
+ *   request   F0 7D <command> [args] F7
+ *   response  F0 7D <command | 0x40> [data] F7
+ * 32-bit values are sent as five 7-bit bytes, least significant first.
+ *
+ * Commands:
+ *   0x01 LATENCY_DUMP   one response per latency stage (latency_hist.h):
+ *                       <stage> <bucket count> <count u32>...
+ *   0x02 LATENCY_CLEAR  clear the latency histograms; empty response
+ *   0x03 PROFILE_DUMP   one response per main loop phase (profiler.h):
+ *                       <phase> <count> <min> <mean> <max> <p99>, all u32 cycles
+ *   0x04 PROFILE_CLEAR  clear the phase profiles; empty response
+ *   0x05 TRACE_START    stream the scanned matrix frames (trace_capture.h)
+ *   0x06 TRACE_STOP     end the stream: <frames> <records> <dropped>, all u32
+ *   0x07 HEALTH_DUMP    the runtime health counters (health.h):
+ *                       <count> <counter u32>... in health_counter_t order
+ * The profile commands are ignored when PROFILE_ENABLED is not defined, the
+ * trace commands when TRACE_CAPTURE is not.
+ *
+ * Runs on the core that owns TinyUSB; responses go out through midi_out.
+ */
+
+#ifndef SYSEX_H
+#define SYSEX_H
+
+#include <stdint.h>
+
+#define SYSEX_START             0xF0
+#define SYSEX_END               0xF7
+#define SYSEX_MANUFACTURER_ID   0x7D
+#define SYSEX_RESPONSE          0x40    // OR-ed into the command of a response
+
+#define SYSEX_CMD_LATENCY_DUMP   0x01
+#define SYSEX_CMD_LATENCY_CLEAR  0x02
+#define SYSEX_CMD_PROFILE_DUMP   0x03
+#define SYSEX_CMD_PROFILE_CLEAR  0x04
+#define SYSEX_CMD_TRACE_START    0x05
+#define SYSEX_CMD_TRACE_STOP     0x06
+#define SYSEX_CMD_HEALTH_DUMP    0x07
+
+// Longest request accepted (longer messages are ignored)
+#define SYSEX_MAX_REQUEST       32
+
+// Handle one complete message (F0 ... F7) from the host
+void sysex_handle(const uint8_t *msg, uint32_t len);
+
+// Append v as five 7-bit bytes; returns the number of bytes written
+static inline uint32_t sysex_put_u32(uint8_t *out, uint32_t v) {
+    for (int i = 0; i < 5; i++) {
+        out[i] = (uint8_t)((v >> (7 * i)) & 0x7F);
+    }
+    return 5;
+}
+
+static inline uint32_t sysex_get_u32(const uint8_t *in) {
+    uint32_t v = 0;
+    for (int i = 0; i < 5; i++) {
+        v |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+    }
+    return v;
+}
+
+#endif // SYSEX_H
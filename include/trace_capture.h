@@ -0,0 +1,62 @@
+/*
+ * Matrix Trace Capture
+ *
+ * Streams the raw frames the scan engine processes to the host over SysEx,
+ * so real playing can be recorded and replayed through the host simulator
+ * (sim/trace.h has the file format, tools/trace_capture.py records one).
+ *
+ * The frame tap (scanning core) only queues frames that carry information:
+ * the first one, any whose rows changed, and any whose interval from the
+ * previous frame differs from the running period by more than
+ * TRACE_CAPTURE_JITTER_US. Every record says how many unchanged frames it
+ * skipped and their period, so the host can put them back in place.
+ * Core0 sends the queued records in trace_capture_task().
+ *
+ * SysEx (see sysex.h):
+ *   0x05 TRACE_START   start capturing; replies F0 7D 45 ... F7 until stopped:
+ *                      00 <row sample offsets from row 0, 12 x u32>  (once, first)
+ *                      01 <time> <skipped> <period> <rows 12 x 2 bytes>
+ *                      time is row 0's sample time (time_us_32), rows are
+ *                      read columns 0-6 then 7-11 of each row
+ *   0x06 TRACE_STOP    stop after the next frame; once every record is sent,
+ *                      replies <frames> <records> <dropped>, all u32
+ * Records the queue cannot take are dropped and counted; a trace with drops
+ * has gaps.
+ */
+
+#ifndef TRACE_CAPTURE_H
+#define TRACE_CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "note_map.h"
+
+// Records queued between the scanning core and core0 (power of two). One
+// record is 15 USB-MIDI packets, so a full queue is about 60 ms of USB
+// bandwidth at 16 packets per 1 ms frame.
+#define TRACE_CAPTURE_RECORDS   64
+
+// Frame intervals within this of the running period count as the same period
+#define TRACE_CAPTURE_JITTER_US 2
+
+// Reply kinds of TRACE_START
+#define TRACE_CAPTURE_HEADER    0x00
+#define TRACE_CAPTURE_FRAME     0x01
+
+// Frame tap for scan_engine_set_frame_tap() (scanning core)
+void trace_capture_frame(const uint16_t rows[NUM_DRIVE_PINS],
+                         const uint32_t row_time[NUM_DRIVE_PINS]);
+
+// True from a start until the frame tap has closed the trace after a stop:
+// the scanner must keep producing frames meanwhile (idle_wake.h must not
+// park it). Safe from either core.
+bool trace_capture_active(void);
+
+// SysEx commands (core0); both wake the scanning core with __sev()
+void trace_capture_start(void);
+void trace_capture_stop(void);
+
+// Send queued records and the stop reply through midi_out (core0 main loop)
+void trace_capture_task(void);
+
+#endif // TRACE_CAPTURE_H
@@ -0,0 +1,100 @@
+/*
+ * Universal MIDI Packets
+ *
+ * Builds and parses the UMP messages the keyboard exchanges with a USB-MIDI
+ * 2.0 host (midi_out.h, midi_in.h), all on group 0:
+ *   MT 0x2  MIDI 1.0 channel voice (one word), for the MIDI 1.0 protocol
+ *   MT 0x4  MIDI 2.0 channel voice (two words): Note On/Off with 16-bit
+ *           velocity and an optional attribute, CC with a 32-bit value
+ *   MT 0x3  7-bit SysEx, up to 6 bytes per packet without F0/F7
+ *   MT 0xF  UMP Stream: Endpoint Discovery / Info and Stream Configuration,
+ *           with which the host picks the MIDI 1.0 or 2.0 protocol
+ * Words are host order; the USB layer sends them little-endian.
+ */
+
+#ifndef UMP_H
+#define UMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "note_event.h"
+
+// Longest UMP message (128 bits)
+#define UMP_MAX_WORDS       4
+
+// Message types (word 0 bits 31-28)
+#define UMP_MT_UTILITY      0x0
+#define UMP_MT_MIDI1        0x2
+#define UMP_MT_DATA64       0x3
+#define UMP_MT_MIDI2        0x4
+#define UMP_MT_STREAM       0xF
+
+// Protocols, as in Stream Configuration messages
+#define UMP_PROTOCOL_MIDI1  0x01
+#define UMP_PROTOCOL_MIDI2  0x02
+
+// 7-bit SysEx packet status (MT 0x3)
+#define UMP_SYSEX_COMPLETE  0x0
+#define UMP_SYSEX_START     0x1
+#define UMP_SYSEX_CONTINUE  0x2
+#define UMP_SYSEX_END       0x3
+#define UMP_SYSEX_BYTES     6
+
+// Stream message statuses (MT 0xF, format 0)
+#define UMP_STREAM_ENDPOINT_DISCOVERY   0x000
+#define UMP_STREAM_ENDPOINT_INFO        0x001
+#define UMP_STREAM_CONFIG_REQUEST       0x005
+#define UMP_STREAM_CONFIG_NOTIFY        0x006
+
+// Endpoint Discovery filter bit asking for the Endpoint Info Notification
+#define UMP_DISCOVERY_ENDPOINT_INFO     0x01
+
+// MIDI 2.0 Note On/Off attribute types
+#define UMP_ATTR_NONE           0x00
+#define UMP_ATTR_MANUFACTURER   0x01
+
+static inline uint8_t ump_type(uint32_t word0) {
+    return (uint8_t)(word0 >> 28);
+}
+
+// Words in a message, from its first word
+uint32_t ump_message_words(uint32_t word0);
+
+// True for a MIDI 1.0 or 2.0 Note On/Off
+bool ump_is_note(uint32_t word0);
+
+// MIDI 1.0 channel message (status 0x80-0xEF) as an MT 0x2 word
+uint32_t ump_midi1(uint8_t status, uint8_t data1, uint8_t data2);
+
+// MIDI 2.0 Note On/Off (status 0x8n/0x9n) with 16-bit velocity and attribute
+void ump_midi2_note(uint8_t status, uint8_t note, uint16_t velocity,
+                    uint8_t attr_type, uint16_t attr_data, uint32_t words[2]);
+
+// A note event in the given protocol; returns its words (1 or 2). MIDI 2.0
+// notes with a measured velocity (Note On) or release velocity (Note Off)
+// carry the sensor interval as a manufacturer attribute when attr is set.
+uint32_t ump_note_event(const note_event_t *ev, uint8_t protocol, bool attr,
+                        uint32_t words[UMP_MAX_WORDS]);
+
+// One 7-bit SysEx packet of count (0-6) bytes
+void ump_sysex7(uint8_t status, const uint8_t *data, uint32_t count, uint32_t words[2]);
+
+// Bytes of a 7-bit SysEx packet; returns the count (0-6) and its status
+uint32_t ump_sysex7_bytes(const uint32_t words[2], uint8_t *status, uint8_t out[UMP_SYSEX_BYTES]);
+
+// Endpoint Info Notification: UMP 1.1, no function blocks, the protocols
+// supported as UMP_PROTOCOL_* bits, no jitter reduction timestamps
+void ump_endpoint_info(uint8_t protocols, uint32_t words[4]);
+
+// Stream Configuration Notification for the protocol in use
+void ump_stream_config_notify(uint8_t protocol, uint32_t words[4]);
+
+// Stream Configuration Request (the host side, for tests)
+void ump_stream_config_request(uint8_t protocol, uint32_t words[4]);
+
+// Status of a UMP Stream message (MT 0xF)
+static inline uint16_t ump_stream_status(uint32_t word0) {
+    return (uint16_t)((word0 >> 16) & 0x3FF);
+}
+
+#endif // UMP_H
@@ -0,0 +1,57 @@
+/*
+ * Velocity Curves
+ *
+ * Lookup tables mapping the first-to-second sensor delta to MIDI velocity,
+ * one per curve shape. The tables (velocity_curves_table.h) are generated at
+ * build time by tools/gen_velocity_curves.py from the timing constants in
+ * keyboard_config.h, 7-bit for MIDI 1.0 and 16-bit for MIDI 2.0. The active
+ * curve can be changed at runtime with MIDI CC VELOCITY_CURVE_CC.
+ */
+
+#ifndef VELOCITY_CURVES_H
+#define VELOCITY_CURVES_H
+
+#include <stdint.h>
+#include "keyboard_config.h"
+
+// Order must match CURVES in tools/gen_velocity_curves.py
+typedef enum {
+    VELOCITY_CURVE_LINEAR,
+    VELOCITY_CURVE_LOGARITHMIC,
+    VELOCITY_CURVE_EXPONENTIAL,
+    VELOCITY_CURVE_S,
+    VELOCITY_CURVE_COUNT
+} velocity_curve_t;
+
+#include "velocity_curves_table.h"
+
+// Velocity 1-127 for a sensor delta: quantize, clamp, one table read
+static inline uint8_t velocity_curve_lookup(velocity_curve_t curve, uint32_t delta_us) {
+    uint32_t index = 0;
+    if (delta_us > VELOCITY_MIN_TIME_US) {
+        index = (delta_us - VELOCITY_MIN_TIME_US) >> VELOCITY_CURVE_SHIFT;
+        if (index >= VELOCITY_CURVE_STEPS) index = VELOCITY_CURVE_STEPS - 1;
+    }
+    return velocity_curve_table[curve][index];
+}
+
+// MIDI 2.0 velocity 512-65535 for a sensor delta: the 16-bit table
+// interpolated across the step, so it keeps the delta's full resolution.
+// Held within the step's 7-bit velocity (v16 >> 9 == velocity_curve_lookup),
+// so a host converting to MIDI 1.0 plays what a MIDI 1.0 host gets.
+static inline uint16_t velocity_curve_lookup16(velocity_curve_t curve, uint32_t delta_us) {
+    if (delta_us <= VELOCITY_MIN_TIME_US) return velocity_curve_table16[curve][0];
+
+    uint32_t offset = delta_us - VELOCITY_MIN_TIME_US;
+    uint32_t index = offset >> VELOCITY_CURVE_SHIFT;
+    if (index >= VELOCITY_CURVE_STEPS - 1) return velocity_curve_table16[curve][VELOCITY_CURVE_STEPS - 1];
+
+    int32_t a = velocity_curve_table16[curve][index];
+    int32_t b = velocity_curve_table16[curve][index + 1];
+    int32_t frac = (int32_t)(offset & ((1u << VELOCITY_CURVE_SHIFT) - 1));
+    int32_t v = a + (b - a) * frac / (1 << VELOCITY_CURVE_SHIFT);
+    int32_t low = velocity_curve_table[curve][index] << 9;
+    return (uint16_t)(v < low ? low : v);
+}
+
+#endif // VELOCITY_CURVES_H
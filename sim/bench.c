@@ -0,0 +1,186 @@
+/*
+ * Engine Micro-Benchmarks - see bench.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "scan_engine.h"
+#include "sim_hal.h"
+#include "sim_check.h"
+#include "bench.h"
+
+#define BENCH_WARMUP_FRAMES  64
+#define BENCH_FRAMES         200000
+#define BENCH_FRAME_US       1000
+#define BENCH_TOGGLE_FRAMES  4      // Frames between press and release (> debounce)
+
+// bench-frame: host cycles charged as one microsecond of firmware CPU time.
+// Rough: an M0+ at 125 MHz needs about ten times the cycles of a desktop
+// core for this code, so a microsecond is 125 / 10 host cycles.
+#define BENCH_CPU_CYCLES_PER_US  12
+#define BENCH_PERIOD_FRAMES      20000
+
+// Cycle counter where available, nanoseconds otherwise
+static uint64_t host_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void discard_event(const note_event_t *ev) {
+    (void)ev;
+}
+
+// Row sample times for a frame at now (one per row, BENCH_FRAME_US apart
+// frames; the rows' spread within the frame does not change the cost)
+static void stamp_rows(uint32_t row_time[NUM_DRIVE_PINS], uint32_t now) {
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        row_time[drive] = now;
+    }
+}
+
+// Row words with both sensors of the lowest held_keys keys closed
+static void build_held_rows(uint16_t rows[NUM_DRIVE_PINS], uint8_t held_keys) {
+    memset(rows, 0, NUM_DRIVE_PINS * sizeof(rows[0]));
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        for (uint8_t read = 0; read < NUM_READ_PINS; read++) {
+            uint8_t first = first_sensor_map[drive][read];
+            uint8_t second = second_sensor_map[drive][read];
+            uint8_t note = first != NOTE_NONE ? first : second;
+            if (note != NOTE_NONE && note >= FIRST_KEY && note < FIRST_KEY + held_keys) {
+                rows[drive] |= (uint16_t)(1u << read);
+            }
+        }
+    }
+}
+
+// Mean cycles per frame while held_keys stay down (no state changes)
+static double bench_held(uint8_t held_keys) {
+    uint16_t rows[NUM_DRIVE_PINS];
+    build_held_rows(rows, held_keys);
+
+    scan_engine_init(discard_event);
+    uint32_t now = 0;
+    uint32_t row_time[NUM_DRIVE_PINS];
+    for (int i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+        now += BENCH_FRAME_US;
+        stamp_rows(row_time, now);
+        scan_engine_process_frame(rows, row_time);
+    }
+
+    uint64_t t0 = host_cycles();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        now += BENCH_FRAME_US;
+        stamp_rows(row_time, now);
+        scan_engine_process_frame(rows, row_time);
+    }
+    return (double)(host_cycles() - t0) / BENCH_FRAMES;
+}
+
+// Mean cycles per frame while held_keys are pressed and released again every
+// toggle_frames frames: debounce, velocity and note events on every toggle
+static double bench_toggling(uint8_t held_keys, int toggle_frames) {
+    uint16_t held[NUM_DRIVE_PINS];
+    uint16_t idle[NUM_DRIVE_PINS] = { 0 };
+    build_held_rows(held, held_keys);
+
+    scan_engine_init(discard_event);
+    uint32_t now = 0;
+    uint32_t row_time[NUM_DRIVE_PINS];
+    uint64_t t0 = host_cycles();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        now += BENCH_FRAME_US;
+        stamp_rows(row_time, now);
+        scan_engine_process_frame((i / toggle_frames) & 1 ? idle : held, row_time);
+    }
+    return (double)(host_cycles() - t0) / BENCH_FRAMES;
+}
+
+// Open or close both sensors of the lowest keys keys in the simulated matrix
+static void set_keys(uint8_t keys, bool closed) {
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        for (uint8_t read = 0; read < NUM_READ_PINS; read++) {
+            uint8_t first = first_sensor_map[drive][read];
+            uint8_t second = second_sensor_map[drive][read];
+            uint8_t note = first != NOTE_NONE ? first : second;
+            if (note != NOTE_NONE && note >= FIRST_KEY && note < FIRST_KEY + keys) {
+                sim_set_position(drive, read, closed);
+            }
+        }
+    }
+}
+
+// Simulated microseconds per scan_matrix() with every row settling settle_us,
+// with toggle_keys pressed and released every BENCH_TOGGLE_FRAMES frames
+// (0: nothing pressed). Host interrupts and counter jitter only ever add
+// time, so each frame of the press/release cycle takes its fastest run and
+// the result is the mean over one cycle.
+static double bench_period(uint32_t settle_us, uint8_t toggle_keys) {
+    sim_hal_reset();
+    scan_engine_init(discard_event);
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        scan_engine_set_settle(drive, settle_us);
+    }
+
+    uint64_t fastest[2 * BENCH_TOGGLE_FRAMES];
+    for (int i = 0; i < 2 * BENCH_TOGGLE_FRAMES; i++) fastest[i] = UINT64_MAX;
+
+    for (int i = 0; i < BENCH_PERIOD_FRAMES; i++) {
+        if (toggle_keys && i % BENCH_TOGGLE_FRAMES == 0) {
+            set_keys(toggle_keys, (i / BENCH_TOGGLE_FRAMES) & 1);
+        }
+        uint64_t start = sim_now_us();
+        sim_hal_cpu_begin(BENCH_CPU_CYCLES_PER_US);
+        scan_matrix();
+        sim_hal_cpu_end();
+
+        uint64_t period = sim_now_us() - start;
+        uint64_t *slot = &fastest[i % (2 * BENCH_TOGGLE_FRAMES)];
+        if (period < *slot) *slot = period;
+    }
+
+    uint64_t total_us = 0;
+    for (int i = 0; i < 2 * BENCH_TOGGLE_FRAMES; i++) total_us += fastest[i];
+    return (double)total_us / (2 * BENCH_TOGGLE_FRAMES);
+}
+
+bool bench_frame_run(void) {
+    static const uint32_t settle[] = { 2, 10, 50, SCAN_SETTLE_US };
+
+    printf("== bench-frame (%s CPU scan, %u host cycles per firmware us) ==\n",
+           SCAN_PIPELINE ? "pipelined" : "sequential", BENCH_CPU_CYCLES_PER_US);
+    printf("    %8s %10s %12s %14s\n", "settle", "settle sum", "idle", "61 toggling");
+    for (size_t i = 0; i < sizeof(settle) / sizeof(settle[0]); i++) {
+        printf("    %5u us %7u us %9.1f us %11.1f us\n", settle[i], settle[i] * NUM_DRIVE_PINS,
+               bench_period(settle[i], 0), bench_period(settle[i], NUM_KEYS));
+    }
+    sim_hal_reset();
+    return true;
+}
+
+bool bench_scan_run(void) {
+    static const uint8_t held[] = { 0, 10, NUM_KEYS };
+
+    printf("== bench-scan ==\n");
+#if defined(__x86_64__) || defined(__i386__)
+    const char *unit = "host cycles (TSC)";
+#else
+    const char *unit = "ns";
+#endif
+    for (size_t i = 0; i < sizeof(held); i++) {
+        printf("  %2u keys held      %8.1f %s per frame\n", held[i], bench_held(held[i]), unit);
+    }
+    printf("  %2u keys toggling  %8.1f %s per frame\n", NUM_KEYS,
+           bench_toggling(NUM_KEYS, BENCH_TOGGLE_FRAMES), unit);
+    return true;
+}
@@ -0,0 +1,23 @@
+/*
+ * Engine Micro-Benchmarks
+ *
+ * Time the scan engine's per-frame processing in host CPU cycles with the
+ * acquisition (settle waits, PIO model) taken out, and the CPU scan's frame
+ * period with it in.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cycles per scan_engine_process_frame() with 0, 10 and 61 keys held
+bool bench_scan_run(void);
+
+// Simulated frame period of the CPU scan (scan_matrix) at several settle
+// times, idle and with 61 keys toggling, with firmware CPU time charged to
+// the simulated clock
+bool bench_frame_run(void);
+
+#endif // BENCH_H
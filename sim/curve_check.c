@@ -0,0 +1,83 @@
+/*
+ * Velocity Curve Check
+ *
+ * Verifies the generated velocity curve tables against the original linear
+ * formula and basic shape rules, and that the MIDI CC switches curves.
+ */
+
+#include <stdio.h>
+#include "keyboard_config.h"
+#include "velocity_curves.h"
+#include "scan_engine.h"
+#include "midi_in.h"
+#include "sim_hal.h"
+#include "sim_check.h"
+#include "curve_check.h"
+
+// The calculate_velocity() formula the tables replaced
+static uint8_t reference_linear(uint32_t delta_us) {
+    if (delta_us <= VELOCITY_MIN_TIME_US) return 127;
+    if (delta_us >= VELOCITY_MAX_TIME_US) return 1;
+    uint64_t range = VELOCITY_MAX_TIME_US - VELOCITY_MIN_TIME_US;
+    uint64_t offset = delta_us - VELOCITY_MIN_TIME_US;
+    return 127 - (uint8_t)((offset * 126) / range);
+}
+
+bool curve_check_run(void) {
+    static const uint32_t sample_us[] = { 0, 2000, 5000, 10000, 20000, 40000, 60000, 80000, 200000 };
+    bool ok = true;
+
+    printf("== curve-check ==\n");
+    printf("  %-12s", "delta us");
+    for (size_t i = 0; i < sizeof(sample_us) / sizeof(sample_us[0]); i++) {
+        printf("%7u", sample_us[i]);
+    }
+    printf("\n");
+    for (int c = 0; c < VELOCITY_CURVE_COUNT; c++) {
+        printf("  %-12s", curve_names[c]);
+        for (size_t i = 0; i < sizeof(sample_us) / sizeof(sample_us[0]); i++) {
+            printf("%7u", velocity_curve_lookup((velocity_curve_t)c, sample_us[i]));
+        }
+        printf("\n");
+    }
+
+    // Linear table is the old formula quantized to the table step
+    int max_error = 0;
+    for (uint32_t delta = 0; delta <= VELOCITY_MAX_TIME_US + 10000; delta += 10) {
+        int error = (int)reference_linear(delta) - velocity_curve_lookup(VELOCITY_CURVE_LINEAR, delta);
+        if (error < 0) error = -error;
+        if (error > max_error) max_error = error;
+    }
+    printf("  linear vs old formula: max error %d\n", max_error);
+    ok &= expect(max_error <= 1, "linear table within 1 of calculate_velocity()");
+
+    // Every curve: 127 at the fast end, 1 at the slow end, never increasing
+    bool shape_ok = true;
+    for (int c = 0; c < VELOCITY_CURVE_COUNT; c++) {
+        shape_ok &= velocity_curve_table[c][0] == 127;
+        shape_ok &= velocity_curve_table[c][VELOCITY_CURVE_STEPS - 1] == 1;
+        for (int i = 1; i < VELOCITY_CURVE_STEPS; i++) {
+            shape_ok &= velocity_curve_table[c][i] <= velocity_curve_table[c][i - 1];
+            shape_ok &= velocity_curve_table[c][i] >= 1;
+        }
+    }
+    ok &= expect(shape_ok, "curves run 127 -> 1 without increasing");
+
+    // Runtime switch through the MIDI input path
+    sim_hal_reset();
+    uint8_t cc_s_curve[4] = { 0x0B, 0xB0, VELOCITY_CURVE_CC, VELOCITY_CURVE_S };
+    uint8_t cc_bad[4] = { 0x0B, 0xB0, VELOCITY_CURVE_CC, 99 };
+    uint8_t cc_linear[4] = { 0x0B, 0xB3, VELOCITY_CURVE_CC, VELOCITY_CURVE_LINEAR };
+
+    sim_midi_host_send(cc_s_curve);
+    midi_in_task();
+    ok &= expect(scan_engine_velocity_curve() == VELOCITY_CURVE_S, "CC selects the S-curve");
+    sim_midi_host_send(cc_bad);
+    midi_in_task();
+    ok &= expect(scan_engine_velocity_curve() == VELOCITY_CURVE_S, "unknown curve number is ignored");
+    sim_midi_host_send(cc_linear);
+    midi_in_task();
+    ok &= expect(scan_engine_velocity_curve() == VELOCITY_CURVE_LINEAR, "CC on another channel selects linear");
+
+    return ok;
+}
@@ -0,0 +1,13 @@
+/*
+ * Velocity Curve Check - see curve_check.c
+ */
+
+#ifndef CURVE_CHECK_H
+#define CURVE_CHECK_H
+
+#include <stdbool.h>
+
+// Prints the curves and checks them; returns true if everything matched
+bool curve_check_run(void);
+
+#endif // CURVE_CHECK_H
@@ -0,0 +1,88 @@
+/*
+ * DIN MIDI Check - see din_check.h
+ */
+
+#include <string.h>
+#include "midi_stream.h"
+#include "din_check.h"
+
+// Data bytes of a channel message
+static uint8_t data_length(uint8_t status) {
+    uint8_t type = status & 0xF0;
+    return type == 0xC0 || type == 0xD0 ? 1 : 2;
+}
+
+// Compare a decoded message with the one queued: a Note On with velocity 0
+// stands for a Note Off with velocity 0, and a folded Note Off loses its
+// release velocity
+static bool same_message(const uint8_t wire[3], const uint8_t queued[3], uint8_t stream_flags) {
+    uint8_t a[3], b[3];
+    memcpy(a, wire, 3);
+    memcpy(b, queued, 3);
+    if (data_length(a[0]) == 1) a[2] = b[2] = 0;
+    if ((stream_flags & MIDI_STREAM_ZERO_VEL_OFF) && (b[0] & 0xF0) == 0x80) b[2] = 0;
+    if ((a[0] & 0xF0) == 0x90 && a[2] == 0) a[0] = (uint8_t)(0x80 | (a[0] & 0x0F));
+    if ((b[0] & 0xF0) == 0x90 && b[2] == 0) b[0] = (uint8_t)(0x80 | (b[0] & 0x0F));
+    return memcmp(a, b, 3) == 0;
+}
+
+bool din_check(const din_message_t *queued, size_t count, uint8_t stream_flags,
+               const sim_uart_byte_t *wire, size_t wire_count,
+               uint32_t byte_us, uint32_t slack_us, din_result_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->queued = count;
+    out->bytes = wire_count;
+    out->first_diff = SIZE_MAX;
+
+    uint8_t status = 0;         // Running status
+    uint8_t msg[3] = { 0 };
+    uint8_t have = 0;           // Data bytes of msg received
+    uint64_t first_us = 0;      // Start of msg's first byte
+    uint64_t line_free_us = 0;  // End of the previous message's last byte
+
+    for (size_t i = 0; i < wire_count; i++) {
+        const sim_uart_byte_t *b = &wire[i];
+        if (i > 0 && b->time_us < wire[i - 1].time_us + byte_us) out->overlaps++;
+
+        if (b->byte & 0x80) {
+            status = b->byte;
+            have = 0;
+            first_us = b->time_us;
+            continue;
+        }
+        if (!status) continue;      // Data without a status: cannot be decoded
+
+        // Running status: the message starts with its first data byte
+        if (have == 0 && !(wire[i - 1].byte & 0x80)) first_us = b->time_us;
+        msg[0] = status;
+        msg[1 + have++] = b->byte;
+        if (have < data_length(status)) continue;
+        have = 0;
+
+        size_t k = out->decoded++;
+        uint64_t done_us = b->time_us + byte_us;
+        if (k >= count || !same_message(msg, queued[k].msg, stream_flags)) {
+            if (out->first_diff == SIZE_MAX) out->first_diff = k;
+            line_free_us = done_us;
+            continue;
+        }
+
+        uint64_t q = queued[k].time_us;
+        uint64_t ready = q > line_free_us ? q : line_free_us;
+        if (first_us < q) {
+            out->early++;
+        } else {
+            if (first_us > ready + slack_us) out->stalls++;
+            if (first_us - q > out->max_wait_us) out->max_wait_us = first_us - q;
+            out->sum_done_us += done_us - q;
+            if (done_us - q > out->max_done_us) out->max_done_us = done_us - q;
+        }
+        line_free_us = done_us;
+    }
+
+    // Queued messages that never made it to the wire
+    if (out->first_diff == SIZE_MAX && out->decoded != count) {
+        out->first_diff = out->decoded < count ? out->decoded : count;
+    }
+    return out->first_diff == SIZE_MAX && !out->overlaps && !out->early && !out->stalls;
+}
@@ -0,0 +1,44 @@
+/*
+ * DIN MIDI Check
+ *
+ * Decodes the bytes the simulated UART sent (running status, Note On with
+ * velocity 0 as Note Off) and checks them against the messages midi_out
+ * handed the DIN transport (midi_uart.h): the same messages in the same
+ * order (Note Offs without their release velocity if the encoder folds them), every byte a full byte time after the previous one, and no message
+ * waiting on an idle line for longer than the slack.
+ */
+
+#ifndef DIN_CHECK_H
+#define DIN_CHECK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sim_hal.h"
+
+// One message handed to the transport
+typedef struct {
+    uint64_t time_us;       // Simulated time it was queued
+    uint8_t msg[3];
+} din_message_t;
+
+typedef struct {
+    size_t queued;          // Messages handed to the transport
+    size_t decoded;         // Complete messages decoded from the wire
+    size_t bytes;           // Bytes on the wire
+    size_t first_diff;      // First decoded message that differs (SIZE_MAX: none)
+    uint32_t overlaps;      // Bytes started less than a byte time after the previous one
+    uint32_t early;         // Messages on the wire before they were queued
+    uint32_t stalls;        // Messages started later than slack after the line was free
+    uint64_t max_wait_us;   // Queued to first byte
+    uint64_t sum_done_us;   // Queued to end of last byte, summed over decoded messages
+    uint64_t max_done_us;
+} din_result_t;
+
+// Check wire (byte_us per byte) against queued, encoded with stream_flags
+// (midi_stream.h); true if every check passed
+bool din_check(const din_message_t *queued, size_t count, uint8_t stream_flags,
+               const sim_uart_byte_t *wire, size_t wire_count,
+               uint32_t byte_us, uint32_t slack_us, din_result_t *out);
+
+#endif // DIN_CHECK_H
@@ -0,0 +1,46 @@
+/*
+ * Host stand-in for hardware/dma.h
+ *
+ * Channels paced by the UART TX DREQ feed the simulated UART (hardware/uart.h):
+ * a byte moves into its FIFO as soon as there is room, and the channel stays
+ * busy until the last one has. The read ring wraps like the hardware's.
+ * Other channels are not modelled.
+ */
+
+#ifndef SIM_HARDWARE_DMA_H
+#define SIM_HARDWARE_DMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    bool ring_write;
+    unsigned ring_bits;     // 0: no ring
+    unsigned dreq;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(unsigned channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+void channel_config_set_ring(dma_channel_config *c, bool write, unsigned size_bits);
+void channel_config_set_dreq(dma_channel_config *c, unsigned dreq);
+void dma_channel_configure(unsigned channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           unsigned transfer_count, bool trigger);
+void dma_channel_transfer_from_buffer_now(unsigned channel, const volatile void *read_addr,
+                                          uint32_t transfer_count);
+bool dma_channel_is_busy(unsigned channel);
+void dma_channel_abort(unsigned channel);
+
+#endif // SIM_HARDWARE_DMA_H
@@ -0,0 +1,42 @@
+/*
+ * Host stand-in for hardware/gpio.h
+ *
+ * gpio_get_all() returns the read pins of the simulated key matrix for the
+ * drive pins currently set with gpio_put(). Pin functions are recorded but
+ * do not change what a pin does; directions are ignored. Rising-edge IRQs
+ * on the read pins are raised by sim_hal_gpio_irq_poll() (sim_hal.h).
+ */
+
+#ifndef SIM_HARDWARE_GPIO_H
+#define SIM_HARDWARE_GPIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_NULL = 0x1f,
+} gpio_function_t;
+
+#define GPIO_IN   false
+#define GPIO_OUT  true
+
+#define GPIO_IRQ_LEVEL_LOW   0x1u
+#define GPIO_IRQ_LEVEL_HIGH  0x2u
+#define GPIO_IRQ_EDGE_FALL   0x4u
+#define GPIO_IRQ_EDGE_RISE   0x8u
+
+typedef void (*gpio_irq_callback_t)(unsigned int gpio, uint32_t event_mask);
+
+void gpio_set_function(unsigned int gpio, gpio_function_t fn);
+gpio_function_t gpio_get_function(unsigned int gpio);
+void gpio_set_dir(unsigned int gpio, bool out);
+void gpio_put(unsigned int gpio, bool value);
+uint32_t gpio_get_all(void);
+
+void gpio_set_irq_enabled(unsigned int gpio, uint32_t events, bool enabled);
+void gpio_set_irq_callback(gpio_irq_callback_t callback);
+
+#endif // SIM_HARDWARE_GPIO_H
@@ -0,0 +1,17 @@
+/*
+ * Host stand-in for hardware/irq.h
+ *
+ * Only the GPIO bank IRQ is modelled; enabling it is accepted and ignored
+ * (callbacks run from sim_hal_gpio_irq_poll()).
+ */
+
+#ifndef SIM_HARDWARE_IRQ_H
+#define SIM_HARDWARE_IRQ_H
+
+#include <stdbool.h>
+
+#define IO_IRQ_BANK0  13
+
+void irq_set_enabled(unsigned int num, bool enabled);
+
+#endif // SIM_HARDWARE_IRQ_H
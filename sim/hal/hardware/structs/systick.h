@@ -0,0 +1,25 @@
+/*
+ * Host stand-in for hardware/structs/systick.h
+ *
+ * Each access to systick_hw samples the host cycle counter into a 24-bit
+ * down-counter, so the profiler reads host cycles with the same arithmetic
+ * as the Cortex-M0+ SysTick. Writes to the control registers are ignored.
+ */
+
+#ifndef SIM_HARDWARE_STRUCTS_SYSTICK_H
+#define SIM_HARDWARE_STRUCTS_SYSTICK_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t csr;
+    uint32_t rvr;
+    uint32_t cvr;
+    uint32_t calib;
+} systick_hw_t;
+
+systick_hw_t *sim_systick_sample(void);
+
+#define systick_hw  (sim_systick_sample())
+
+#endif // SIM_HARDWARE_STRUCTS_SYSTICK_H
@@ -0,0 +1,23 @@
+/*
+ * Host stand-in for hardware/sync.h
+ *
+ * The simulator runs the firmware on one thread and IRQ callbacks only from
+ * the clock or poll calls, so masking interrupts and events are no-ops.
+ */
+
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+static inline void __sev(void) {}
+
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void)status;
+}
+
+#endif // SIM_HARDWARE_SYNC_H
@@ -0,0 +1,29 @@
+/*
+ * Host stand-in for hardware/uart.h
+ *
+ * One UART (uart0) with the RP2040's 32-byte TX FIFO, shifting out 10 bits
+ * per byte at the rate set by uart_init(). Only DMA writes reach it (see
+ * hardware/dma.h); every byte sent is logged with the simulated time its
+ * start bit went out (sim_uart_log()).
+ */
+
+#ifndef SIM_HARDWARE_UART_H
+#define SIM_HARDWARE_UART_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t dr;
+} uart_hw_t;
+
+typedef struct sim_uart uart_inst_t;
+
+extern uart_inst_t *const sim_uart0;
+#define uart0  sim_uart0
+
+uint32_t uart_init(uart_inst_t *uart, uint32_t baudrate);
+uart_hw_t *uart_get_hw(uart_inst_t *uart);
+unsigned uart_get_dreq_num(uart_inst_t *uart, bool is_tx);
+
+#endif // SIM_HARDWARE_UART_H
@@ -0,0 +1,41 @@
+/*
+ * Host stand-in for pico/stdlib.h
+ *
+ * Provides the subset of the Pico SDK used by the scan engine and scheduler.
+ * Time is simulated: busy waits and sleeps advance the clock instead of
+ * spinning, and repeating timers fire as the clock passes their due time.
+ */
+
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct alarm_pool alarm_pool_t;
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer {
+    int64_t delay_us;       // < 0: period from scheduled time, > 0: from callback end
+    alarm_pool_t *pool;
+    repeating_timer_callback_t callback;
+    void *user_data;
+    uint64_t next_us;       // Simulated time of the next call
+};
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void busy_wait_us_32(uint32_t delay_us);
+void sleep_us(uint64_t us);
+
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(unsigned max_timers);
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us,
+                                       repeating_timer_callback_t callback,
+                                       void *user_data, repeating_timer_t *out);
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback,
+                            void *user_data, repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+#endif // SIM_PICO_STDLIB_H
@@ -0,0 +1,28 @@
+/*
+ * Host stand-in for tusb.h
+ *
+ * MIDI packet writes go into a FIFO the size of CFG_TUD_MIDI_TX_BUFSIZE
+ * that tud_task() sends as one 64-byte transfer per 1 ms USB frame; sent
+ * messages are captured with their simulated timestamp in the sim log.
+ * MIDI reads return packets queued with sim_midi_host_send(). With
+ * sim_hal_set_usb_frames() the host instead polls the IN endpoint at a
+ * fixed point of every frame and can send SOFs, which tud_task() hands to
+ * tud_sof_cb() once enabled.
+ */
+
+#ifndef SIM_TUSB_H
+#define SIM_TUSB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+void tud_task(void);
+bool tud_midi_mounted(void);
+bool tud_midi_packet_write(uint8_t const packet[4]);
+uint32_t tud_midi_available(void);
+bool tud_midi_packet_read(uint8_t packet[4]);
+
+void tud_sof_cb_enable(bool enable);
+void tud_sof_cb(uint32_t frame_count);
+
+#endif // SIM_TUSB_H
@@ -0,0 +1,126 @@
+/*
+ * PIO Matrix Scanner Model - see pio_model.h
+ */
+
+#include <stdio.h>
+#include "hardware/gpio.h"
+#include "keyboard_config.h"
+#include "pio_scanner.h"
+#include "sim_hal.h"
+#include "sim_check.h"
+#include "pio_model.h"
+
+// Simulated state machine: cycle counter since the frame started
+typedef struct {
+    uint64_t start_us;
+    uint64_t cycles;
+} pio_sm_model_t;
+
+// Execute one instruction: advance the simulated clock to its cycle
+static void step(pio_sm_model_t *sm, uint64_t cycles) {
+    sm->cycles += cycles;
+    uint64_t target = sm->start_us + sm->cycles * 1000000ull / PIO_SCAN_CLOCK_HZ;
+    sim_advance_us(target - sim_now_us());
+}
+
+// out pins, 12 / mov pins, null
+static void set_drive_pins(uint32_t pattern) {
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        gpio_put(DRIVE0 + drive, (pattern >> drive) & 1);
+    }
+}
+
+void pio_model_run_frame(const uint32_t descriptors[NUM_DRIVE_PINS],
+                         uint32_t raw[NUM_DRIVE_PINS],
+                         uint64_t sample_us[NUM_DRIVE_PINS]) {
+    pio_sm_model_t sm = { .start_us = sim_now_us(), .cycles = 0 };
+
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        uint32_t osr = descriptors[drive];      // pull block
+
+        step(&sm, 1);
+        set_drive_pins(osr & 0xFFF);            // out pins, 12
+        osr >>= 12;
+
+        step(&sm, 1);
+        uint32_t x = osr & 0xFFFFF;             // out x, 20
+
+        step(&sm, 1 + (uint64_t)x);             // jmp x-- settle (x + 1 cycles)
+
+        step(&sm, 1);                           // in pins, 15
+        raw[drive] = (gpio_get_all() >> PIO_SCAN_IN_BASE) & ((1u << PIO_SCAN_IN_BITS) - 1);
+        sample_us[drive] = sim_now_us();
+
+        step(&sm, 1);                           // push block
+
+        step(&sm, 1);
+        set_drive_pins(0);                      // mov pins, null
+
+        step(&sm, 1);                           // wrap to pull
+    }
+}
+
+// ============================================================================
+// FORMAT + TIMING CHECK
+// ============================================================================
+
+bool pio_model_check(void) {
+    bool ok = true;
+
+    printf("== pio-check ==\n");
+
+    // Descriptor encoding
+    uint32_t d = pio_scan_descriptor(5, 100);
+    ok &= expect((d & 0xFFF) == (1u << 5), "descriptor drive pattern is one-hot");
+    ok &= expect(pio_scan_row_cycles(d) == 100 - PIO_SCAN_SAMPLE_OFFSET + PIO_SCAN_ROW_OVERHEAD,
+                 "descriptor settle loop count");
+    ok &= expect((pio_scan_descriptor(0, 0) >> 12) == 0, "settle below sample offset clamps to 0");
+
+    // Sample conversion: column 11 comes from GPIO 26 (bit 14), GPIO 23-25 ignored
+    ok &= expect(pio_scan_sample_to_row(0x7FFF) == 0xFFF, "sample to row keeps 12 columns");
+    ok &= expect(pio_scan_sample_to_row(1u << 14) == 0x800, "GPIO 26 maps to column 11");
+    ok &= expect(pio_scan_sample_to_row(0x7u << 11) == 0, "GPIO 23-25 are masked");
+
+    // One frame against a known matrix, with a different settle per row
+    sim_hal_reset();
+    uint32_t descriptors[NUM_DRIVE_PINS];
+    uint16_t expected[NUM_DRIVE_PINS];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        descriptors[drive] = pio_scan_descriptor(drive, 10 + drive * 5);
+        expected[drive] = (uint16_t)((1u << drive) | ((drive & 1) ? 0x800 : 0));
+        for (uint8_t read = 0; read < NUM_READ_PINS; read++) {
+            sim_set_position(drive, read, (expected[drive] >> read) & 1);
+        }
+    }
+
+    uint32_t raw[NUM_DRIVE_PINS];
+    uint64_t sample_us[NUM_DRIVE_PINS];
+    uint64_t start = sim_now_us();
+    pio_model_run_frame(descriptors, raw, sample_us);
+
+    bool rows_ok = true, timing_ok = true;
+    uint64_t row_start = start;
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        rows_ok &= pio_scan_sample_to_row(raw[drive]) == expected[drive];
+
+        uint32_t loops = descriptors[drive] >> 12;
+        // Row is driven one cycle after its descriptor is pulled
+        timing_ok &= sample_us[drive] == row_start + 1 + PIO_SCAN_SAMPLE_OFFSET + loops;
+        row_start += pio_scan_row_cycles(descriptors[drive]);
+    }
+    ok &= expect(rows_ok, "frame rows match the matrix (one row driven at a time)");
+    ok &= expect(timing_ok, "per-row sample times follow the settle table");
+
+    uint32_t offset_us[NUM_DRIVE_PINS];
+    pio_scan_sample_offsets(descriptors, offset_us);
+    bool offsets_ok = true;
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        offsets_ok &= start + offset_us[drive] == sample_us[drive];
+    }
+    ok &= expect(offsets_ok, "pio_scan_sample_offsets() matches the model");
+    ok &= expect(sim_now_us() - start == row_start - start, "frame period is the sum of row cycles");
+
+    printf("  frame period %llu us for settle 10..65 us\n",
+           (unsigned long long)(sim_now_us() - start));
+    return ok;
+}
@@ -0,0 +1,26 @@
+/*
+ * PIO Matrix Scanner Model
+ *
+ * Instruction-by-instruction model of src/matrix_scan.pio running against the
+ * simulated matrix, so the descriptor/sample format and frame timing of the
+ * PIO scanner can be checked on the host. Keep in step with the .pio file.
+ */
+
+#ifndef PIO_MODEL_H
+#define PIO_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "note_map.h"
+
+// Run one frame: raw[drive] gets the RX sample word, sample_us[drive] the
+// simulated time it was taken. Advances the simulated clock by the frame.
+void pio_model_run_frame(const uint32_t descriptors[NUM_DRIVE_PINS],
+                         uint32_t raw[NUM_DRIVE_PINS],
+                         uint64_t sample_us[NUM_DRIVE_PINS]);
+
+// Check frame format and timing against the model. Prints results,
+// returns true if everything matched.
+bool pio_model_check(void);
+
+#endif // PIO_MODEL_H
@@ -0,0 +1,123 @@
+/*
+ * Note Queue Stress Test
+ *
+ * Runs note_queue.h with a real producer and consumer thread. The producer
+ * pushes bursts of all 61 keys (press then release) back to back, retrying
+ * on a full queue like the core1 sink; the consumer pops at an uneven pace
+ * like a busy USB core. Every event carries a sequence number in time_us, so
+ * the consumer can prove nothing was lost, duplicated or reordered.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include "note_queue.h"
+#include "sim_check.h"
+#include "queue_stress.h"
+
+#define BURST_SIZE  (2 * NUM_KEYS)
+
+static note_queue_t queue;
+
+typedef struct {
+    uint32_t bursts;
+    uint64_t full_retries;      // Producer found the queue full
+} producer_t;
+
+typedef struct {
+    uint32_t expected_events;
+    uint32_t received;
+    uint32_t errors;
+    uint32_t max_depth;
+} consumer_t;
+
+// Event number n of the stream: which key, and press or release
+static note_event_t make_event(uint32_t n) {
+    uint32_t i = n % BURST_SIZE;
+    note_event_t ev = {
+        .time_us = n,
+        .note = (uint8_t)(FIRST_KEY + (i % NUM_KEYS)),
+        .velocity = i < NUM_KEYS ? (uint8_t)(1 + (n % 127)) : 0,
+        .flags = i < NUM_KEYS ? NOTE_EVENT_ON : 0,
+    };
+    return ev;
+}
+
+static void *producer_thread(void *arg) {
+    producer_t *p = arg;
+    uint32_t n = 0;
+
+    for (uint32_t burst = 0; burst < p->bursts; burst++) {
+        for (uint32_t i = 0; i < BURST_SIZE; i++, n++) {
+            note_event_t ev = make_event(n);
+            while (!note_queue_push(&queue, &ev)) {
+                p->full_retries++;
+                sched_yield();
+            }
+        }
+    }
+    return NULL;
+}
+
+static void *consumer_thread(void *arg) {
+    consumer_t *c = arg;
+    uint32_t spin = 0;
+
+    while (c->received < c->expected_events) {
+        uint32_t depth = note_queue_count(&queue);
+        if (depth > c->max_depth) c->max_depth = depth;
+
+        note_event_t ev;
+        if (!note_queue_pop(&queue, &ev)) {
+            sched_yield();
+            continue;
+        }
+
+        note_event_t want = make_event(c->received);
+        if (ev.time_us != want.time_us || ev.note != want.note ||
+            ev.velocity != want.velocity || ev.flags != want.flags) {
+            if (c->errors++ < 5) {
+                fprintf(stderr, "  event %u: got seq %u note %u, want seq %u note %u\n",
+                        c->received, ev.time_us, ev.note, want.time_us, want.note);
+            }
+        }
+        c->received++;
+
+        // Stall now and then, like tud_task() busy with a transfer
+        if ((++spin & 0x3FF) == 0) {
+            struct timespec pause = { 0, 50000 };
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+bool queue_stress_run(uint32_t bursts) {
+    producer_t p = { .bursts = bursts };
+    consumer_t c = { .expected_events = bursts * BURST_SIZE };
+    pthread_t producer, consumer;
+
+    note_queue_init(&queue);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_create(&consumer, NULL, consumer_thread, &c);
+    pthread_create(&producer, NULL, producer_thread, &p);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    bool ok = c.errors == 0 && c.received == c.expected_events && note_queue_count(&queue) == 0;
+
+    printf("== queue-stress ==\n");
+    printf("  events           %u in %u bursts of %u (61 keys on + off)\n",
+           c.received, bursts, BURST_SIZE);
+    printf("  errors           %u lost/reordered/corrupt\n", c.errors);
+    printf("  max depth        %u of %u, producer full retries %llu\n",
+           c.max_depth, NOTE_QUEUE_SIZE, (unsigned long long)p.full_retries);
+    printf("  throughput       %.1f M events/s (host threads)\n", c.received / secs / 1e6);
+    printf("  result           %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
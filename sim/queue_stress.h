@@ -0,0 +1,15 @@
+/*
+ * Note Queue Stress Test - see queue_stress.c
+ */
+
+#ifndef QUEUE_STRESS_H
+#define QUEUE_STRESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Push bursts × 122 events through note_queue.h with two threads.
+// Prints results, returns true if every event arrived intact and in order.
+bool queue_stress_run(uint32_t bursts);
+
+#endif // QUEUE_STRESS_H
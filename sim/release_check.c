@@ -0,0 +1,377 @@
+/*
+ * Release Velocity and Early Note-Off Check
+ *
+ * Plays scripted sensor edges through scan_engine_process_frame() on every
+ * key of the 61-key range, at several phases against the frame, in the
+ * standard mode (Note Off when both sensors are open, release velocity from
+ * the second-to-first interval) and the early mode (Note Off when the second
+ * sensor opens, velocity 0). Every Note On and measured Note Off velocity
+ * must lie between the linear curve at interval + P and at interval - P, as
+ * in velocity-check.
+ *
+ * The two-key trill is also reported as how much earlier its Note Offs come
+ * in the early mode.
+ */
+
+#include <stdio.h>
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "velocity_curves.h"
+#include "sensor_positions.h"
+#include "scan_engine.h"
+#include "pio_scanner.h"
+#include "midi_in.h"
+#include "sim_hal.h"
+#include "sim_check.h"
+#include "release_check.h"
+
+#define PHASES          4           // Script start phases per scan period
+#define MAX_EDGES       48
+#define MAX_EVENTS      32
+
+// Edge roles that switch the early mode, or send All Notes Off (CC 123)
+// through midi_in.c, instead of moving a sensor
+#define EDGE_MODE       SENSOR_NONE
+#define EDGE_PANIC      (SENSOR_SECOND + 1)
+
+// Expected interval of an event that is not measured (default Note On
+// velocity, Note Off velocity 0), and of one whose velocity is not checked
+#define UNMEASURED  UINT32_MAX
+#define ANY         (UINT32_MAX - 1)
+
+typedef struct {
+    uint32_t at_us;         // From the script start
+    uint8_t key;            // Semitones above the case's note
+    uint8_t role;           // SENSOR_FIRST, SENSOR_SECOND, EDGE_MODE or EDGE_PANIC
+    bool closed;            // Sensor closed, or early mode on
+} edge_t;
+
+typedef struct {
+    uint8_t key;
+    bool on;
+    uint32_t interval_us;   // Press delta or release interval the velocity is from
+    uint32_t before_us;     // Must come before this script time (0: any time)
+} expected_t;
+
+typedef struct {
+    const char *name;
+    edge_t edges[MAX_EDGES];
+    uint8_t edge_count;
+    expected_t standard[MAX_EVENTS];
+    uint8_t standard_count;
+    expected_t early[MAX_EVENTS];
+    uint8_t early_count;
+} release_case_t;
+
+typedef struct {
+    uint8_t note;
+    bool on;
+    uint8_t velocity;
+    uint32_t time_us;
+} captured_t;
+
+static captured_t events[MAX_EVENTS];
+static uint8_t event_count;
+
+static void capture_event(const note_event_t *ev) {
+    if (event_count < MAX_EVENTS) {
+        events[event_count++] = (captured_t){
+            .note = ev->note,
+            .on = (ev->flags & NOTE_EVENT_ON) != 0,
+            .velocity = ev->velocity,
+            .time_us = ev->time_us,
+        };
+    }
+}
+
+// Matrix position of one of a note's sensors
+static bool find_sensor(uint8_t note, uint8_t role, uint8_t *drive, uint8_t *read) {
+    for (uint8_t d = 0; d < NUM_DRIVE_PINS; d++) {
+        for (uint8_t r = 0; r < NUM_READ_PINS; r++) {
+            const sensor_position_t *pos = sensor_position(d, r);
+            if (pos->note == note && pos->role == role) {
+                *drive = d;
+                *read = r;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Play a case's edges on note, start_us into the run. Returns false if one
+// of its sensors is not on the matrix.
+static bool play(const release_case_t *c, uint8_t note, uint32_t start_us, bool early,
+                 const uint32_t offset_us[NUM_DRIVE_PINS], uint32_t period_us) {
+    uint8_t drive[MAX_EDGES], read[MAX_EDGES];
+    uint32_t end_us = start_us;
+    for (uint8_t i = 0; i < c->edge_count; i++) {
+        const edge_t *e = &c->edges[i];
+        if (e->role != EDGE_MODE && e->role != EDGE_PANIC && !find_sensor((uint8_t)(note + e->key), e->role, &drive[i], &read[i])) {
+            return false;
+        }
+        if (start_us + e->at_us > end_us) end_us = start_us + e->at_us;
+    }
+    end_us += (DEBOUNCE_SAMPLES + 2) * period_us;
+
+    scan_engine_init(capture_event);
+    scan_engine_set_velocity_curve(VELOCITY_CURVE_LINEAR);
+    scan_engine_set_early_note_off(early);
+    event_count = 0;
+
+    for (uint32_t frame = START_US; frame < end_us; frame += period_us) {
+        uint16_t rows[NUM_DRIVE_PINS] = { 0 };
+        uint32_t row_time[NUM_DRIVE_PINS];
+        for (uint8_t d = 0; d < NUM_DRIVE_PINS; d++) {
+            row_time[d] = frame + offset_us[d];
+        }
+
+        // Edges are in time order: the last one at or before a sample wins
+        for (uint8_t i = 0; i < c->edge_count; i++) {
+            const edge_t *e = &c->edges[i];
+            uint32_t at = start_us + e->at_us;
+            if (e->role == EDGE_MODE) {
+                if (frame >= at) scan_engine_set_early_note_off(e->closed);
+                continue;
+            }
+            if (e->role == EDGE_PANIC) {
+                // Once, before the first frame at or after it
+                if (frame >= at && frame - at < period_us) {
+                    uint8_t cc[4] = { 0x0B, 0xB0, 123, 0 };
+                    sim_midi_host_send(cc);
+                    midi_in_task();
+                }
+                continue;
+            }
+            if (row_time[drive[i]] < at) continue;
+            uint16_t bit = (uint16_t)(1u << read[i]);
+            rows[drive[i]] = e->closed ? rows[drive[i]] | bit : rows[drive[i]] & (uint16_t)~bit;
+        }
+        scan_engine_process_frame(rows, row_time);
+    }
+    return true;
+}
+
+static bool velocity_in_bound(const expected_t *x, uint8_t velocity, uint32_t period_us) {
+    if (x->interval_us == ANY) return true;
+    if (x->interval_us == UNMEASURED) return x->on ? velocity == VELOCITY_DEFAULT : velocity == 0;
+    if (!x->on && x->interval_us >= VELOCITY_TIMEOUT_US) return velocity == 0;
+
+    uint32_t interval = x->interval_us;
+    uint8_t slowest = velocity_curve_lookup(VELOCITY_CURVE_LINEAR, interval + period_us);
+    uint8_t fastest = velocity_curve_lookup(VELOCITY_CURVE_LINEAR, interval > period_us ? interval - period_us : 0);
+    return velocity >= slowest && velocity <= fastest;
+}
+
+static bool events_match(const expected_t *expect, uint8_t count, uint8_t note,
+                         uint32_t start_us, uint32_t period_us) {
+    if (event_count != count) return false;
+    for (uint8_t i = 0; i < count; i++) {
+        const expected_t *x = &expect[i];
+        const captured_t *ev = &events[i];
+        if (ev->note != note + x->key || ev->on != x->on) return false;
+        if (!velocity_in_bound(x, ev->velocity, period_us)) return false;
+        if (x->before_us && ev->time_us >= start_us + x->before_us) return false;
+    }
+    return true;
+}
+
+// Runs a case on every key and phase in one mode; returns the failures
+static uint32_t run_case(const release_case_t *c, bool early, const uint32_t offset_us[NUM_DRIVE_PINS],
+                         uint32_t period_us, uint32_t *runs) {
+    const expected_t *expect = early ? c->early : c->standard;
+    uint8_t count = early ? c->early_count : c->standard_count;
+    uint32_t failures = 0;
+
+    for (uint8_t note = FIRST_KEY; note < FIRST_KEY + NUM_KEYS; note++) {
+        for (uint32_t phase = 0; phase < PHASES; phase++) {
+            uint32_t start_us = START_US + period_us + phase * period_us / PHASES;
+            if (!play(c, note, start_us, early, offset_us, period_us)) continue;
+            (*runs)++;
+            if (!events_match(expect, count, note, start_us, period_us)) failures++;
+        }
+    }
+    return failures;
+}
+
+// ============================================================================
+// CASES
+// ============================================================================
+
+#define PRESS(key, at)      { (at), (key), SENSOR_FIRST, true }, { (at) + 5000, (key), SENSOR_SECOND, true }
+#define PRESS_DELTA_US      5000
+#define EDGE(at, role, closed)  { (at), 0, (role), (closed) }
+#define ON(interval)        { 0, true, (interval), 0 }
+#define OFF(interval)       { 0, false, (interval), 0 }
+#define OFF_BEFORE(at)      { 0, false, UNMEASURED, (at) }
+
+static const release_case_t cases[] = {
+    {
+        "release 20 ms",
+        { PRESS(0, 0), EDGE(100000, SENSOR_SECOND, false), EDGE(120000, SENSOR_FIRST, false) }, 4,
+        { ON(PRESS_DELTA_US), OFF(20000) }, 2,
+        { ON(PRESS_DELTA_US), OFF_BEFORE(120000) }, 2,
+    },
+    {
+        "release 60 ms",
+        { PRESS(0, 0), EDGE(100000, SENSOR_SECOND, false), EDGE(160000, SENSOR_FIRST, false) }, 4,
+        { ON(PRESS_DELTA_US), OFF(60000) }, 2,
+        { ON(PRESS_DELTA_US), OFF_BEFORE(160000) }, 2,
+    },
+    {
+        "release 200 ms (past the timeout)",
+        { PRESS(0, 0), EDGE(100000, SENSOR_SECOND, false), EDGE(300000, SENSOR_FIRST, false) }, 4,
+        { ON(PRESS_DELTA_US), OFF(UNMEASURED) }, 2,
+        { ON(PRESS_DELTA_US), OFF_BEFORE(300000) }, 2,
+    },
+    {
+        "release 1 ms (within a frame)",
+        { PRESS(0, 0), EDGE(100000, SENSOR_SECOND, false), EDGE(101000, SENSOR_FIRST, false) }, 4,
+        { ON(PRESS_DELTA_US), OFF(1000) }, 2,
+        // Measured too when both sensors open in one frame
+        { ON(PRESS_DELTA_US), OFF(ANY) }, 2,
+    },
+    {
+        "second sensor never closes",
+        { EDGE(0, SENSOR_FIRST, true), EDGE(300000, SENSOR_FIRST, false) }, 2,
+        { ON(ANY), OFF(UNMEASURED) }, 2,
+        { ON(ANY), OFF(UNMEASURED) }, 2,
+    },
+    {
+        // Dead first sensor: default velocity, whichever row is sampled first
+        "first sensor never closes",
+        { EDGE(0, SENSOR_SECOND, true), EDGE(100000, SENSOR_SECOND, false) }, 2,
+        { ON(UNMEASURED), OFF(UNMEASURED) }, 2,
+        { ON(UNMEASURED), OFF(UNMEASURED) }, 2,
+    },
+    {
+        // Key lifted past the second sensor and pressed again, then released
+        "half release",
+        { PRESS(0, 0), EDGE(100000, SENSOR_SECOND, false), EDGE(115000, SENSOR_SECOND, true),
+          EDGE(200000, SENSOR_SECOND, false), EDGE(215000, SENSOR_FIRST, false) }, 6,
+        { ON(PRESS_DELTA_US), OFF(15000) }, 2,
+        { ON(PRESS_DELTA_US), OFF_BEFORE(115000), ON(15000), OFF_BEFORE(215000) }, 4,
+    },
+    {
+        // One key repeated from half releases, 50 ms apart
+        "repeated notes from half releases",
+        { PRESS(0, 0),
+          EDGE(50000, SENSOR_SECOND, false), EDGE(70000, SENSOR_SECOND, true),
+          EDGE(100000, SENSOR_SECOND, false), EDGE(120000, SENSOR_SECOND, true),
+          EDGE(150000, SENSOR_SECOND, false), EDGE(170000, SENSOR_SECOND, true),
+          EDGE(200000, SENSOR_SECOND, false), EDGE(220000, SENSOR_FIRST, false) }, 10,
+        { ON(PRESS_DELTA_US), OFF(20000) }, 2,
+        { ON(PRESS_DELTA_US), OFF(UNMEASURED), ON(20000), OFF(UNMEASURED), ON(20000), OFF(UNMEASURED),
+          ON(20000), OFF(UNMEASURED) }, 8,
+    },
+    {
+        // First sensor drops out for 10 ms while the key is held: no Note Off
+        // until the key is really released
+        "first sensor glitch while held",
+        { PRESS(0, 0), EDGE(50000, SENSOR_FIRST, false), EDGE(60000, SENSOR_FIRST, true),
+          EDGE(100000, SENSOR_SECOND, false), EDGE(120000, SENSOR_FIRST, false) }, 6,
+        { ON(PRESS_DELTA_US), OFF(20000) }, 2,
+        { ON(PRESS_DELTA_US), OFF_BEFORE(120000) }, 2,
+    },
+    {
+        // All Notes Off while the key is held: the note ends there, and the
+        // release that follows sends nothing
+        "all notes off while held",
+        { PRESS(0, 0), { 50000, 0, EDGE_PANIC, true }, EDGE(100000, SENSOR_SECOND, false),
+          EDGE(120000, SENSOR_FIRST, false) }, 5,
+        { ON(PRESS_DELTA_US), OFF_BEFORE(70000) }, 2,
+        { ON(PRESS_DELTA_US), OFF_BEFORE(70000) }, 2,
+    },
+    {
+        // Mode switched on while the key is on its way up: the note still ends
+        "early mode switched on mid-release",
+        { PRESS(0, 0), EDGE(100000, SENSOR_SECOND, false), EDGE(120000, EDGE_MODE, true),
+          EDGE(140000, SENSOR_FIRST, false) }, 5,
+        { ON(PRESS_DELTA_US), OFF(40000) }, 2,
+        { ON(PRESS_DELTA_US), OFF_BEFORE(140000) }, 2,
+    },
+    {
+        // Key and the key two semitones up, 45 ms per strike, each lifted past its
+        // second sensor 10 ms before the next strike and fully 15 ms after it
+        "two-key trill",
+        { PRESS(0, 0), EDGE(35000, SENSOR_SECOND, false), PRESS(2, 45000), EDGE(60000, SENSOR_FIRST, false),
+          { 80000, 2, SENSOR_SECOND, false }, PRESS(0, 90000), { 105000, 2, SENSOR_FIRST, false },
+          EDGE(125000, SENSOR_SECOND, false), PRESS(2, 135000), EDGE(150000, SENSOR_FIRST, false),
+          { 170000, 2, SENSOR_SECOND, false }, { 195000, 2, SENSOR_FIRST, false } }, 16,
+        { ON(PRESS_DELTA_US), { 2, true, PRESS_DELTA_US, 0 }, { 0, false, 25000, 0 }, { 0, true, PRESS_DELTA_US, 0 },
+          { 2, false, 25000, 0 }, { 2, true, PRESS_DELTA_US, 0 }, { 0, false, 25000, 0 }, { 2, false, 25000, 0 } }, 8,
+        { ON(PRESS_DELTA_US), { 0, false, UNMEASURED, 60000 }, { 2, true, PRESS_DELTA_US, 0 },
+          { 2, false, UNMEASURED, 105000 }, { 0, true, PRESS_DELTA_US, 0 }, { 0, false, UNMEASURED, 150000 },
+          { 2, true, PRESS_DELTA_US, 0 }, { 2, false, UNMEASURED, 195000 } }, 8,
+    },
+};
+
+#define NUM_CASES   (sizeof(cases) / sizeof(cases[0]))
+#define TRILL_CASE  (NUM_CASES - 1)
+
+// Mean Note Off time of the last run, from the script start
+static double mean_off_us(uint32_t start_us) {
+    double sum = 0;
+    uint32_t offs = 0;
+    for (uint8_t i = 0; i < event_count; i++) {
+        if (!events[i].on) {
+            sum += events[i].time_us - start_us;
+            offs++;
+        }
+    }
+    return offs ? sum / offs : 0;
+}
+
+bool release_check_run(void) {
+    uint32_t descriptors[NUM_DRIVE_PINS];
+    uint32_t offset_us[NUM_DRIVE_PINS];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        descriptors[drive] = pio_scan_descriptor(drive, SCAN_SETTLE_US);
+    }
+    pio_scan_sample_offsets(descriptors, offset_us);
+
+    uint32_t period = SCAN_PERIOD_US;
+    bool was_early = scan_engine_early_note_off();
+    bool ok = true;
+
+    printf("== release-check ==\n");
+    printf("  scan period %u us, velocities within +-%u us of the interval\n", period, period);
+    printf("  %-38s %16s %16s\n", "case", "standard", "early");
+    for (size_t c = 0; c < NUM_CASES; c++) {
+        uint32_t runs[2] = { 0 }, failures[2];
+        failures[0] = run_case(&cases[c], false, offset_us, period, &runs[0]);
+        failures[1] = run_case(&cases[c], true, offset_us, period, &runs[1]);
+        bool pass = failures[0] == 0 && failures[1] == 0 && runs[0] && runs[1];
+
+        char standard[24], early[24];
+        snprintf(standard, sizeof(standard), "%u/%u", runs[0] - failures[0], runs[0]);
+        snprintf(early, sizeof(early), "%u/%u", runs[1] - failures[1], runs[1]);
+        printf("  %-38s %16s %16s %s\n", cases[c].name, standard, early, pass ? "ok" : "FAIL");
+        ok &= pass;
+    }
+
+    // How much earlier the trill's Note Offs come in the early mode
+    uint32_t start_us = START_US + period;
+    double standard_off = 0, early_off = 0;
+    if (play(&cases[TRILL_CASE], FIRST_KEY + 24, start_us, false, offset_us, period)) {
+        standard_off = mean_off_us(start_us);
+    }
+    if (play(&cases[TRILL_CASE], FIRST_KEY + 24, start_us, true, offset_us, period)) {
+        early_off = mean_off_us(start_us);
+    }
+    printf("  two-key trill Note Offs, early mode: %.0f us earlier\n", standard_off - early_off);
+
+    // Runtime switch through the MIDI input path
+    sim_hal_reset();
+    uint8_t cc_on[4] = { 0x0B, 0xB0, EARLY_NOTE_OFF_CC, 127 };
+    uint8_t cc_off[4] = { 0x0B, 0xB5, EARLY_NOTE_OFF_CC, 0 };
+    sim_midi_host_send(cc_on);
+    midi_in_task();
+    ok &= expect(scan_engine_early_note_off(), "CC turns the early mode on");
+    sim_midi_host_send(cc_off);
+    midi_in_task();
+    ok &= expect(!scan_engine_early_note_off(), "CC on another channel turns it off");
+
+    scan_engine_set_early_note_off(was_early);
+    return ok;
+}
@@ -0,0 +1,14 @@
+/*
+ * Release Velocity and Early Note-Off Check - see release_check.c
+ */
+
+#ifndef RELEASE_CHECK_H
+#define RELEASE_CHECK_H
+
+#include <stdbool.h>
+
+// Runs the scripted release cases in both note-off modes; returns true if
+// every case produced the expected events
+bool release_check_run(void);
+
+#endif // RELEASE_CHECK_H
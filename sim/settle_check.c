@@ -0,0 +1,128 @@
+/*
+ * Settle Sweep Check
+ *
+ * Runs examples/gpio-test/settle_sweep.c against the simulator's settle
+ * model (sim_hal_set_settle_model) with known per-row settle times, twice:
+ * all 61 keys held, then every other key. For every drive/read pair the
+ * first settle step from which all reads match the reference must be the
+ * step the model predicts, from the row's own rising edge (idle samples)
+ * and the discharge of the previous row (precharged samples).
+ *
+ * The recording is what the characterization firmware prints, so
+ * tools/settle_profile.py can be run on it: with --margin-pct 0 --margin-us 0
+ * its profile is the model rounded up to the sweep's steps.
+ */
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "sim_hal.h"
+#include "settle_sweep.h"
+#include "sim_check.h"
+#include "settle_check.h"
+
+// Modelled settle per drive row: a few slow rows among fast ones
+static const uint32_t model_settle_us[NUM_DRIVE_PINS] = {
+    2, 2, 3, 3, 5, 5, 7, 7, 11, 40, 3, 3,
+};
+
+// Close both sensors of every step-th key
+static void hold_keys(uint8_t step) {
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        for (uint8_t read = 0; read < NUM_READ_PINS; read++) {
+            uint8_t first = first_sensor_map[drive][read];
+            uint8_t second = second_sensor_map[drive][read];
+            uint8_t note = first != NOTE_NONE ? first : second;
+            bool held = note != NOTE_NONE && note >= FIRST_KEY && note < FIRST_KEY + NUM_KEYS &&
+                        (note - FIRST_KEY) % step == 0;
+            sim_set_position(drive, read, held);
+        }
+    }
+}
+
+// What the model reads on a pair: the row's switch once it has settled,
+// and after a precharge, the previous row's switch until it has discharged
+static bool model_read(bool closed, bool prev_closed, uint8_t drive, uint8_t prev,
+                       uint32_t settle_us, bool precharge) {
+    return (closed && settle_us >= model_settle_us[drive]) ||
+           (precharge && prev_closed && settle_us < model_settle_us[prev]);
+}
+
+// First step from which every later step has no mismatches (STEPS if none)
+static uint8_t first_stable_step(const uint8_t counts[SETTLE_SWEEP_STEPS][NUM_READ_PINS], uint8_t read) {
+    uint8_t stable = SETTLE_SWEEP_STEPS;
+    while (stable > 0 && counts[stable - 1][read] == 0) stable--;
+    return stable;
+}
+
+static bool check_sweep(const char *name, const settle_sweep_t *sweep) {
+    bool ok = true;
+    uint32_t worst[NUM_DRIVE_PINS] = { 0 };
+
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        uint8_t prev = drive ? drive - 1 : NUM_DRIVE_PINS - 1;
+        for (uint8_t read = 0; read < NUM_READ_PINS; read++) {
+            bool closed = (sweep->reference[drive] >> read) & 1;
+            bool prev_closed = (sweep->reference[prev] >> read) & 1;
+
+            uint8_t expected = SETTLE_SWEEP_STEPS;
+            while (expected > 0) {
+                uint32_t settle_us = settle_sweep_steps_us[expected - 1];
+                if (model_read(closed, prev_closed, drive, prev, settle_us, false) != closed ||
+                    model_read(closed, prev_closed, drive, prev, settle_us, true) != closed) {
+                    break;
+                }
+                expected--;
+            }
+
+            uint8_t measured = first_stable_step(sweep->mismatches[drive], read);
+            if (measured != expected) {
+                printf("  %s: drive %u read %u stable from step %u, model says %u\n",
+                       name, drive, read, measured, expected);
+                ok = false;
+            }
+            if (measured < SETTLE_SWEEP_STEPS && settle_sweep_steps_us[measured] > worst[drive]) {
+                worst[drive] = settle_sweep_steps_us[measured];
+            }
+        }
+    }
+
+    printf("  %-12s stable from (us):", name);
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) printf(" %3u", worst[drive]);
+    printf("\n");
+    return ok;
+}
+
+bool settle_check_run(FILE *out) {
+    static settle_sweep_t sweep;
+    bool ok = true;
+
+    printf("== settle-sweep ==\n");
+    printf("  %-12s model settle (us):", "");
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) printf(" %3u", model_settle_us[drive]);
+    printf("\n");
+
+    static const struct { const char *name; uint8_t step; } runs[] = {
+        { "all keys", 1 },
+        { "every other", 2 },
+    };
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        sim_hal_reset();
+        sim_hal_set_settle_model(model_settle_us);
+        hold_keys(runs[i].step);
+
+        settle_sweep_run(&sweep);
+        ok &= check_sweep(runs[i].name, &sweep);
+
+        if (out) {
+            fprintf(out, "# sweep %zu (simulated, %s held)\n", i + 1, runs[i].name);
+            settle_sweep_write(&sweep, out);
+        }
+    }
+
+    sim_hal_set_settle_model(NULL);
+    sim_hal_reset();
+    printf("  %s\n", ok ? "OK" : "FAILED");
+    return ok;
+}
@@ -0,0 +1,16 @@
+/*
+ * Settle Sweep Check - see settle_check.c
+ */
+
+#ifndef SETTLE_CHECK_H
+#define SETTLE_CHECK_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Runs the characterization sweep against a modelled matrix, checks it
+// against the model and writes the recording to out (NULL: no recording).
+// Returns true if every pair settled where the model says.
+bool settle_check_run(FILE *out);
+
+#endif // SETTLE_CHECK_H
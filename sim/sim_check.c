@@ -0,0 +1,15 @@
+/*
+ * Simulator Check Helpers - see sim_check.h
+ */
+
+#include <stdio.h>
+#include "sim_check.h"
+
+const char *const curve_names[VELOCITY_CURVE_COUNT] = {
+    "linear", "logarithmic", "exponential", "s-curve",
+};
+
+bool expect(bool ok, const char *what) {
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAIL");
+    return ok;
+}
@@ -0,0 +1,28 @@
+/*
+ * Simulator Check Helpers
+ *
+ * The keyboard range, start time and result line shared by the checks and
+ * benchmarks built into keyboard_sim.
+ */
+
+#ifndef SIM_CHECK_H
+#define SIM_CHECK_H
+
+#include <stdbool.h>
+#include "velocity_curves.h"
+
+// 61-key keyboard range (C2 to C7)
+#define FIRST_KEY   36
+#define NUM_KEYS    61
+#define LAST_KEY    (FIRST_KEY + NUM_KEYS - 1)
+
+// First scripted press, clear of the zeroed debounce timestamps
+#define START_US    1000000
+
+// Curve names indexed by velocity_curve_t
+extern const char *const curve_names[VELOCITY_CURVE_COUNT];
+
+// Print one named result line ("ok" or "FAIL") and return ok
+bool expect(bool ok, const char *what);
+
+#endif // SIM_CHECK_H
@@ -0,0 +1,872 @@
+/*
+ * Simulated Hardware Layer - see sim_hal.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/uart.h"
+#include "hardware/dma.h"
+#include "hardware/structs/systick.h"
+#include "tusb.h"
+#include "midi_out.h"
+#include "sysex.h"
+#include "ump.h"
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "sim_hal.h"
+
+static uint64_t sim_clock_us;
+static uint64_t sim_epoch_us;                   // Added to the firmware-visible clock
+static uint32_t drive_pins;                     // Output levels set by gpio_put
+static uint16_t matrix_rows[NUM_DRIVE_PINS];    // Closed read columns per drive row
+
+static uint32_t settle_model_us[NUM_DRIVE_PINS];   // 0: rows switch instantly
+static uint64_t drive_settled_us[NUM_DRIVE_PINS];   // When each row's last edge has settled
+
+static gpio_function_t pin_function[32];       // As set by gpio_set_function
+
+// Rising-edge IRQs: enabled read pins, their level when last polled
+static uint32_t irq_rise_enabled;
+static uint32_t irq_last_level;
+static gpio_irq_callback_t irq_callback;
+
+static uint32_t noise_per_million;
+static uint32_t noise_seed;
+static uint32_t noise_state;
+static uint64_t noise_flips;
+
+static uint32_t cpu_cycles_per_us;             // 0: firmware code takes no time
+static uint64_t cpu_mark;                       // Host cycles when firmware code last resumed
+static uint64_t cpu_carry;                      // Charged host cycles short of a whole us
+static uint64_t cpu_overhead;                   // Host cycles one counter read adds to a span
+
+static sim_input_hook_t input_hook;
+static void *input_hook_ctx;
+
+static sim_tick_hook_t tick_hook;
+static void *tick_hook_ctx;
+static repeating_timer_t tick_timer;
+
+static repeating_timer_t *timers[SIM_MAX_TIMERS];
+
+static uint8_t midi_tx[SIM_MIDI_TX_FIFO_PACKETS][4];
+static size_t midi_tx_count;
+static uint64_t last_tx_frame;
+
+// USB host frame model (sim_hal_set_usb_frames), and SOFs handed out so far
+static uint32_t usb_poll_us = SIM_USB_POLL_ANY;
+static bool usb_sof;
+static bool sof_cb_enabled;
+static uint64_t last_sof_frame;
+static uint64_t last_poll_us;                   // Last IN poll taken into account (UINT64_MAX: none)
+
+static sim_midi_event_t midi_log[SIM_MIDI_LOG_SIZE];
+static size_t midi_log_count;
+
+static uint8_t midi_rx[SIM_MIDI_RX_SIZE][4];
+static size_t midi_rx_head, midi_rx_tail;
+
+// USB-MIDI 2.0 host: the FIFO and receive queue hold UMP words instead
+static bool ump_selected;
+static sim_ump_message_t ump_log[SIM_UMP_LOG_SIZE];
+static size_t ump_log_count;
+
+// UART: FIFO of bytes with the time each entered it, and when the line is
+// free for the next start bit
+typedef struct {
+    uint8_t byte;
+    uint64_t entered_us;
+} uart_slot_t;
+
+static uint32_t uart_byte_us;                   // 0: uart_init() not called
+static uart_slot_t uart_fifo[SIM_UART_FIFO_BYTES];
+static size_t uart_fifo_head, uart_fifo_tail;
+static uint64_t uart_line_free_us;
+static uint64_t uart_slot_free_us;              // When the FIFO last gave up a byte
+
+static sim_uart_byte_t uart_log[SIM_UART_LOG_SIZE];
+static size_t uart_log_count;
+
+typedef struct {
+    bool claimed;
+    dma_channel_config config;
+    const volatile uint8_t *read_addr;
+    uint32_t remaining;
+    uint64_t start_us;
+} sim_dma_channel_t;
+
+static sim_dma_channel_t dma[SIM_DMA_CHANNELS];
+
+void sim_hal_reset(void) {
+    sim_clock_us = 0;
+    cpu_cycles_per_us = 0;
+    cpu_carry = 0;
+    noise_state = noise_seed ? noise_seed : 1;
+    noise_flips = 0;
+    drive_pins = 0;
+    memset(matrix_rows, 0, sizeof(matrix_rows));
+    memset(drive_settled_us, 0, sizeof(drive_settled_us));
+    for (int pin = 0; pin < 32; pin++) {
+        pin_function[pin] = GPIO_FUNC_NULL;
+    }
+    irq_rise_enabled = 0;
+    irq_last_level = 0;
+    irq_callback = NULL;
+    midi_tx_count = 0;
+    last_tx_frame = UINT64_MAX;
+    sof_cb_enabled = false;
+    last_sof_frame = UINT64_MAX;
+    last_poll_us = UINT64_MAX;
+    midi_log_count = 0;
+    midi_rx_head = 0;
+    midi_rx_tail = 0;
+    ump_selected = false;
+    ump_log_count = 0;
+    uart_byte_us = 0;
+    uart_fifo_head = 0;
+    uart_fifo_tail = 0;
+    uart_line_free_us = 0;
+    uart_slot_free_us = 0;
+    uart_log_count = 0;
+    memset(dma, 0, sizeof(dma));
+    input_hook = NULL;
+    input_hook_ctx = NULL;
+    tick_hook = NULL;
+    tick_hook_ctx = NULL;
+    memset(timers, 0, sizeof(timers));
+}
+
+void sim_hal_set_input_hook(sim_input_hook_t hook, void *ctx) {
+    input_hook = hook;
+    input_hook_ctx = ctx;
+}
+
+static bool tick_hook_timer(repeating_timer_t *rt) {
+    (void)rt;
+    tick_hook(tick_hook_ctx);
+    return true;
+}
+
+void sim_hal_set_tick_hook(sim_tick_hook_t hook, uint32_t period_us, void *ctx) {
+    cancel_repeating_timer(&tick_timer);
+    tick_hook = hook;
+    tick_hook_ctx = ctx;
+    if (hook) {
+        add_repeating_timer_us(-(int64_t)period_us, tick_hook_timer, NULL, &tick_timer);
+    }
+}
+
+uint64_t sim_now_us(void) {
+    return sim_clock_us;
+}
+
+// Host cycle counter (nanoseconds without one)
+static uint64_t host_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void sim_hal_cpu_begin(uint32_t host_cycles_per_us) {
+    // Back-to-back counter reads: the part of every span that is the
+    // counter itself (slow under some hypervisors)
+    cpu_overhead = UINT64_MAX;
+    for (int i = 0; i < 64; i++) {
+        uint64_t t0 = host_cycles();
+        uint64_t t1 = host_cycles();
+        if (t1 - t0 < cpu_overhead) cpu_overhead = t1 - t0;
+    }
+
+    cpu_cycles_per_us = host_cycles_per_us;
+    cpu_mark = host_cycles();
+}
+
+// Charge the firmware code run since the last stand-in call to the clock
+static void cpu_enter(void) {
+    if (!cpu_cycles_per_us) return;
+    uint64_t now = host_cycles();
+    uint64_t spent = now - cpu_mark;
+    cpu_carry += spent > cpu_overhead ? spent - cpu_overhead : 0;
+    cpu_mark = now;
+    uint64_t us = cpu_carry / cpu_cycles_per_us;
+    cpu_carry %= cpu_cycles_per_us;
+    if (us) sim_advance_us(us);
+}
+
+// Firmware code resumes: the stand-in's own time is not charged
+static void cpu_leave(void) {
+    if (cpu_cycles_per_us) cpu_mark = host_cycles();
+}
+
+// SysTick stand-in: host cycles as a 24-bit down-counter
+systick_hw_t *sim_systick_sample(void) {
+    static systick_hw_t systick;
+    cpu_enter();
+    systick.cvr = (uint32_t)~host_cycles() & 0xFFFFFFu;
+    cpu_leave();
+    return &systick;
+}
+
+void sim_hal_cpu_end(void) {
+    cpu_enter();
+    cpu_cycles_per_us = 0;
+}
+
+// Earliest timer due at or before target, or NULL
+static repeating_timer_t *next_due_timer(uint64_t target) {
+    repeating_timer_t *next = NULL;
+    for (int i = 0; i < SIM_MAX_TIMERS; i++) {
+        if (timers[i] && timers[i]->next_us <= target &&
+            (!next || timers[i]->next_us < next->next_us)) {
+            next = timers[i];
+        }
+    }
+    return next;
+}
+
+// Every clock advance goes through here so timers fire at their due time
+void sim_advance_us(uint64_t us) {
+    uint64_t target = sim_clock_us + us;
+
+    repeating_timer_t *rt;
+    while ((rt = next_due_timer(target)) != NULL) {
+        sim_clock_us = rt->next_us;
+        if (!rt->callback(rt)) {
+            cancel_repeating_timer(rt);
+            continue;
+        }
+        // Callbacks take no simulated time, so both delay signs give the same spacing
+        int64_t delay = rt->delay_us < 0 ? -rt->delay_us : rt->delay_us;
+        rt->next_us = sim_clock_us + (uint64_t)(delay ? delay : 1);
+    }
+    sim_clock_us = target;
+}
+
+void sim_hal_set_epoch(uint64_t epoch_us) {
+    sim_epoch_us = epoch_us;
+}
+
+void sim_hal_set_settle_model(const uint32_t settle_us[NUM_DRIVE_PINS]) {
+    if (settle_us) {
+        memcpy(settle_model_us, settle_us, sizeof(settle_model_us));
+    } else {
+        memset(settle_model_us, 0, sizeof(settle_model_us));
+    }
+}
+
+void sim_hal_set_read_noise(uint32_t per_million, uint32_t seed) {
+    noise_per_million = per_million;
+    noise_seed = seed;
+    noise_state = seed ? seed : 1;
+}
+
+uint64_t sim_hal_noise_flips(void) {
+    return noise_flips;
+}
+
+// xorshift32
+static uint32_t noise_next(void) {
+    noise_state ^= noise_state << 13;
+    noise_state ^= noise_state >> 17;
+    noise_state ^= noise_state << 5;
+    return noise_state;
+}
+
+// Columns flipped by noise for one read
+static uint16_t read_noise(void) {
+    if (noise_per_million == 0) return 0;
+
+    uint16_t flips = 0;
+    for (uint8_t read = 0; read < NUM_READ_PINS; read++) {
+        if (noise_next() % 1000000u < noise_per_million) {
+            flips |= (uint16_t)(1u << read);
+            noise_flips++;
+        }
+    }
+    return flips;
+}
+
+void sim_set_position(uint8_t drive, uint8_t read, bool closed) {
+    if (drive >= NUM_DRIVE_PINS || read >= NUM_READ_PINS) return;
+
+    if (closed) {
+        matrix_rows[drive] |= (uint16_t)(1u << read);
+    } else {
+        matrix_rows[drive] &= (uint16_t)~(1u << read);
+    }
+}
+
+const sim_midi_event_t *sim_midi_log(size_t *count) {
+    *count = midi_log_count;
+    return midi_log;
+}
+
+static void uart_catch_up(void);
+
+const sim_uart_byte_t *sim_uart_log(size_t *count) {
+    uart_catch_up();
+    *count = uart_log_count;
+    return uart_log;
+}
+
+bool sim_midi_host_send(const uint8_t packet[4]) {
+    if (midi_rx_head - midi_rx_tail >= SIM_MIDI_RX_SIZE) return false;
+
+    memcpy(midi_rx[midi_rx_head++ % SIM_MIDI_RX_SIZE], packet, 4);
+    return true;
+}
+
+// ============================================================================
+// PICO SDK STAND-INS
+// ============================================================================
+
+uint64_t time_us_64(void) {
+    cpu_enter();
+    uint64_t now = sim_epoch_us + sim_clock_us;
+    cpu_leave();
+    return now;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+void busy_wait_us_32(uint32_t delay_us) {
+    cpu_enter();
+    sim_advance_us(delay_us);
+    cpu_leave();
+}
+
+void sleep_us(uint64_t us) {
+    cpu_enter();
+    sim_advance_us(us);
+    cpu_leave();
+}
+
+alarm_pool_t *alarm_pool_create_with_unused_hardware_alarm(unsigned max_timers) {
+    static int pool;
+    (void)max_timers;
+    return (alarm_pool_t *)&pool;
+}
+
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t *pool, int64_t delay_us,
+                                       repeating_timer_callback_t callback,
+                                       void *user_data, repeating_timer_t *out) {
+    for (int i = 0; i < SIM_MAX_TIMERS; i++) {
+        if (timers[i]) continue;
+
+        int64_t delay = delay_us < 0 ? -delay_us : delay_us;
+        out->delay_us = delay_us;
+        out->pool = pool;
+        out->callback = callback;
+        out->user_data = user_data;
+        out->next_us = sim_clock_us + (uint64_t)(delay ? delay : 1);
+        timers[i] = out;
+        return true;
+    }
+    return false;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback,
+                            void *user_data, repeating_timer_t *out) {
+    return alarm_pool_add_repeating_timer_us(NULL, delay_us, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+    for (int i = 0; i < SIM_MAX_TIMERS; i++) {
+        if (timers[i] == timer) {
+            timers[i] = NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+void gpio_put(unsigned int gpio, bool value) {
+    if (gpio >= 32) return;
+
+    cpu_enter();
+    uint32_t old = drive_pins;
+    if (value) {
+        drive_pins |= 1u << gpio;
+    } else {
+        drive_pins &= ~(1u << gpio);
+    }
+    if (old != drive_pins && gpio - DRIVE0 < NUM_DRIVE_PINS) {
+        drive_settled_us[gpio - DRIVE0] = sim_clock_us + settle_model_us[gpio - DRIVE0];
+    }
+    cpu_leave();
+}
+
+// Whether a row's closed switches reach the read pins: from settle time after
+// it is driven until settle time after it is released
+static bool row_visible(uint8_t drive) {
+    bool driven = drive_pins & (1u << (DRIVE0 + drive));
+    return sim_clock_us >= drive_settled_us[drive] ? driven : !driven;
+}
+
+// Read columns: every closed switch on any driven row
+static uint16_t visible_columns(void) {
+    uint16_t columns = 0;
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        if (row_visible(drive)) {
+            columns |= matrix_rows[drive];
+        }
+    }
+    return columns;
+}
+
+// Columns 0-10 = GPIO 12-22, Column 11 = GPIO 26
+static uint32_t columns_to_pins(uint16_t columns) {
+    uint32_t pins = (uint32_t)(columns & 0x7FF) << READ0;
+    if (columns & (1u << 11)) {
+        pins |= 1u << 26;
+    }
+    return pins;
+}
+
+// Read pins see every closed switch on any driven row
+uint32_t gpio_get_all(void) {
+    cpu_enter();
+    if (input_hook) {
+        input_hook(sim_clock_us, input_hook_ctx);
+    }
+
+    uint32_t state = drive_pins | columns_to_pins(visible_columns() ^ read_noise());
+    cpu_leave();
+    return state;
+}
+
+void gpio_set_dir(unsigned int gpio, bool out) {
+    (void)gpio;
+    (void)out;
+}
+
+// Enabling an edge IRQ clears the edge latch: only later rises count
+void gpio_set_irq_enabled(unsigned int gpio, uint32_t events, bool enabled) {
+    if (gpio >= 32 || !(events & GPIO_IRQ_EDGE_RISE)) return;
+
+    if (enabled) {
+        irq_rise_enabled |= 1u << gpio;
+        irq_last_level = (irq_last_level & ~(1u << gpio)) |
+                         (columns_to_pins(visible_columns()) & (1u << gpio));
+    } else {
+        irq_rise_enabled &= ~(1u << gpio);
+    }
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback) {
+    irq_callback = callback;
+}
+
+void irq_set_enabled(unsigned int num, bool enabled) {
+    (void)num;
+    (void)enabled;
+}
+
+void sim_hal_gpio_irq_poll(void) {
+    if (!irq_rise_enabled) return;
+
+    if (input_hook) {
+        input_hook(sim_clock_us, input_hook_ctx);
+    }
+    uint32_t level = columns_to_pins(visible_columns());
+    uint32_t rose = level & ~irq_last_level & irq_rise_enabled;
+    irq_last_level = level;
+
+    for (unsigned int gpio = 0; rose && gpio < 32; gpio++) {
+        // The callback may disable the remaining pins
+        if ((rose & (1u << gpio)) && (irq_rise_enabled & (1u << gpio)) && irq_callback) {
+            irq_callback(gpio, GPIO_IRQ_EDGE_RISE);
+        }
+        rose &= ~(1u << gpio);
+    }
+}
+
+// Bytes of MIDI data per USB-MIDI code index number
+static uint8_t cin_length(uint8_t cin) {
+    static const uint8_t length[16] = { 0, 0, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1 };
+    return length[cin & 0x0F];
+}
+
+static void log_midi(const uint8_t *bytes, uint8_t len, uint64_t at_us) {
+    if (midi_log_count >= SIM_MIDI_LOG_SIZE) return;
+
+    sim_midi_event_t *ev = &midi_log[midi_log_count++];
+    ev->time_us = at_us;
+    ev->len = len;
+    memset(ev->msg, 0, sizeof(ev->msg));
+    memcpy(ev->msg, bytes, len);
+}
+
+// MIDI 1.0 translation of a UMP message for the MIDI log: channel voice
+// messages as bytes (16-bit velocities and 32-bit values to their top 7
+// bits, Note On velocity at least 1), SysEx as F0 ... F7 bytes. Stream and
+// other messages only go to the UMP log.
+static void log_ump(const uint32_t *words, uint32_t count, uint64_t at_us) {
+    if (ump_log_count < SIM_UMP_LOG_SIZE) {
+        sim_ump_message_t *m = &ump_log[ump_log_count++];
+        m->time_us = at_us;
+        memset(m->words, 0, sizeof(m->words));
+        memcpy(m->words, words, count * sizeof(words[0]));
+        m->count = (uint8_t)count;
+    }
+
+    uint8_t status = (uint8_t)(words[0] >> 16);
+    uint8_t bytes[UMP_SYSEX_BYTES + 2];
+    uint8_t len = 0;
+    switch (ump_type(words[0])) {
+    case UMP_MT_MIDI1:
+        bytes[0] = status;
+        bytes[1] = (uint8_t)(words[0] >> 8) & 0x7F;
+        bytes[2] = (uint8_t)words[0] & 0x7F;
+        log_midi(bytes, (status & 0xE0) == 0xC0 ? 2 : 3, at_us);
+        break;
+    case UMP_MT_MIDI2:
+        bytes[0] = status;
+        bytes[1] = (uint8_t)(words[0] >> 8) & 0x7F;
+        bytes[2] = (uint8_t)(words[1] >> 25);
+        if ((status & 0xF0) == 0x90 && bytes[2] == 0) bytes[2] = 1;
+        if ((status & 0xF0) == 0xC0) bytes[1] = (uint8_t)(words[1] >> 24) & 0x7F;
+        log_midi(bytes, (status & 0xE0) == 0xC0 ? 2 : 3, at_us);
+        break;
+    case UMP_MT_DATA64: {
+        uint8_t data[UMP_SYSEX_BYTES];
+        uint8_t packet_status;
+        uint32_t n = ump_sysex7_bytes(words, &packet_status, data);
+        if (packet_status == UMP_SYSEX_COMPLETE || packet_status == UMP_SYSEX_START) {
+            bytes[len++] = SYSEX_START;
+        }
+        memcpy(&bytes[len], data, n);
+        len += (uint8_t)n;
+        if (packet_status == UMP_SYSEX_COMPLETE || packet_status == UMP_SYSEX_END) {
+            bytes[len++] = SYSEX_END;
+        }
+        for (uint8_t i = 0; i < len; i += 3) {
+            log_midi(&bytes[i], len - i < 3 ? len - i : 3, at_us);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// The host takes the whole FIFO in one bulk transfer at at_us
+static void send_fifo(uint64_t at_us) {
+    if (ump_selected) {
+        // Words of whole messages (usb_midi_ump_write)
+        size_t i = 0;
+        while (i < midi_tx_count) {
+            uint32_t words[UMP_MAX_WORDS];
+            memcpy(&words[0], midi_tx[i], 4);
+            uint32_t count = ump_message_words(words[0]);
+            for (uint32_t w = 1; w < count; w++) memcpy(&words[w], midi_tx[i + w], 4);
+            log_ump(words, count, at_us);
+            i += count;
+        }
+        midi_tx_count = 0;
+        return;
+    }
+
+    for (size_t i = 0; i < midi_tx_count; i++) {
+        if (midi_log_count >= SIM_MIDI_LOG_SIZE) break;
+
+        sim_midi_event_t *ev = &midi_log[midi_log_count++];
+        ev->time_us = at_us;
+        ev->len = cin_length(midi_tx[i][0]);
+        memcpy(ev->msg, &midi_tx[i][1], 3);
+    }
+    midi_tx_count = 0;
+}
+
+// Fixed-phase host polls: the latest poll due by now takes what the FIFO
+// held. Called before anything reads or changes the FIFO, so it only ever
+// holds packets written before that poll.
+static void usb_catch_up(void) {
+    if (usb_poll_us == SIM_USB_POLL_ANY) return;
+
+    uint64_t poll = sim_clock_us / SIM_USB_FRAME_US * SIM_USB_FRAME_US + usb_poll_us;
+    if (poll > sim_clock_us) {
+        if (poll < SIM_USB_FRAME_US) return;
+        poll -= SIM_USB_FRAME_US;
+    }
+    if (last_poll_us != UINT64_MAX && poll <= last_poll_us) return;
+
+    last_poll_us = poll;
+    if (midi_tx_count) send_fifo(poll);
+}
+
+void sim_hal_set_usb_frames(uint32_t poll_us, bool sof) {
+    usb_poll_us = poll_us;
+    usb_sof = sof;
+}
+
+void tud_sof_cb_enable(bool enable) {
+    sof_cb_enabled = enable;
+}
+
+// SOF events first, as TinyUSB queues them ahead of the transfers; then one
+// bulk transfer of the whole FIFO per USB frame
+void tud_task(void) {
+    uint64_t frame = sim_clock_us / SIM_USB_FRAME_US;
+    if (usb_sof && sof_cb_enabled && frame != last_sof_frame) {
+        last_sof_frame = frame;
+        tud_sof_cb((uint32_t)(frame & 0x7FF));
+    }
+
+    if (usb_poll_us != SIM_USB_POLL_ANY) {
+        usb_catch_up();
+        return;
+    }
+    if (midi_tx_count == 0 || frame == last_tx_frame) return;
+    last_tx_frame = frame;
+    send_fifo(sim_clock_us);
+}
+
+// Without SCAN_SOF_LOCK nothing takes the SOFs
+__attribute__((weak)) void tud_sof_cb(uint32_t frame_count) {
+    (void)frame_count;
+}
+
+bool tud_midi_mounted(void) {
+    return true;
+}
+
+// midi_out.c: the IN endpoint is busy until tud_task() sends the FIFO
+bool usb_midi_tx_busy(void) {
+    usb_catch_up();
+    return midi_tx_count != 0;
+}
+
+void sim_ump_host_select(bool selected) {
+    ump_selected = selected;
+    midi_tx_count = 0;
+    midi_rx_tail = midi_rx_head;
+}
+
+bool sim_ump_host_send(const uint32_t *words, uint32_t count) {
+    if (midi_rx_head - midi_rx_tail + count > SIM_MIDI_RX_SIZE) return false;
+
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(midi_rx[midi_rx_head++ % SIM_MIDI_RX_SIZE], &words[i], 4);
+    }
+    return true;
+}
+
+const sim_ump_message_t *sim_ump_log(size_t *count) {
+    *count = ump_log_count;
+    return ump_log;
+}
+
+bool usb_midi_ump_selected(void) {
+    return ump_selected;
+}
+
+bool usb_midi_ump_write(const uint32_t *words, uint32_t count) {
+    usb_catch_up();
+    if (!ump_selected || midi_tx_count + count > SIM_MIDI_TX_FIFO_PACKETS) return false;
+
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(midi_tx[midi_tx_count++], &words[i], 4);
+    }
+    return true;
+}
+
+bool usb_midi_ump_read(uint32_t *word) {
+    if (!ump_selected || midi_rx_head == midi_rx_tail) return false;
+
+    memcpy(word, midi_rx[midi_rx_tail++ % SIM_MIDI_RX_SIZE], 4);
+    return true;
+}
+
+bool tud_midi_packet_write(uint8_t const packet[4]) {
+    usb_catch_up();
+    if (midi_tx_count >= SIM_MIDI_TX_FIFO_PACKETS) return false;
+
+    memcpy(midi_tx[midi_tx_count++], packet, 4);
+    return true;
+}
+
+uint32_t tud_midi_available(void) {
+    return (uint32_t)(midi_rx_head - midi_rx_tail) * 4;
+}
+
+bool tud_midi_packet_read(uint8_t packet[4]) {
+    if (midi_rx_head == midi_rx_tail) return false;
+
+    memcpy(packet, midi_rx[midi_rx_tail++ % SIM_MIDI_RX_SIZE], 4);
+    return true;
+}
+
+// ============================================================================
+// UART + DMA STAND-INS
+// ============================================================================
+
+static struct sim_uart {
+    uart_hw_t hw;
+} uart0_inst;
+
+uart_inst_t *const sim_uart0 = &uart0_inst;
+
+// Next byte a channel reads, wrapping inside its read ring
+static uint8_t dma_read_byte(sim_dma_channel_t *ch) {
+    const volatile uint8_t *p = ch->read_addr;
+    uint8_t byte = *p;
+    uintptr_t next = (uintptr_t)p + 1;
+    if (ch->config.ring_bits && !ch->config.ring_write) {
+        uintptr_t mask = ((uintptr_t)1 << ch->config.ring_bits) - 1;
+        next = ((uintptr_t)p & ~mask) | (next & mask);
+    }
+    ch->read_addr = (const volatile uint8_t *)next;
+    return byte;
+}
+
+// Bring the UART and the channels feeding it up to the clock: DMA fills
+// free FIFO slots, the shifter starts the next byte once the line is free
+static void uart_catch_up(void) {
+    if (!uart_byte_us) return;
+
+    for (;;) {
+        for (int c = 0; c < SIM_DMA_CHANNELS; c++) {
+            sim_dma_channel_t *ch = &dma[c];
+            if (ch->config.dreq != SIM_DREQ_UART0_TX) continue;
+            while (ch->remaining && uart_fifo_head - uart_fifo_tail < SIM_UART_FIFO_BYTES) {
+                uart_slot_t *slot = &uart_fifo[uart_fifo_head++ % SIM_UART_FIFO_BYTES];
+                slot->byte = dma_read_byte(ch);
+                slot->entered_us = ch->start_us > uart_slot_free_us ? ch->start_us : uart_slot_free_us;
+                ch->remaining--;
+            }
+        }
+        if (uart_fifo_head == uart_fifo_tail) return;
+
+        const uart_slot_t *slot = &uart_fifo[uart_fifo_tail % SIM_UART_FIFO_BYTES];
+        uint64_t start = slot->entered_us > uart_line_free_us ? slot->entered_us : uart_line_free_us;
+        if (start > sim_clock_us) return;
+
+        if (uart_log_count < SIM_UART_LOG_SIZE) {
+            uart_log[uart_log_count].time_us = start;
+            uart_log[uart_log_count].byte = slot->byte;
+            uart_log_count++;
+        }
+        uart_fifo_tail++;
+        uart_line_free_us = start + uart_byte_us;
+        uart_slot_free_us = start;
+    }
+}
+
+void gpio_set_function(unsigned int gpio, gpio_function_t fn) {
+    if (gpio < 32) pin_function[gpio] = fn;
+}
+
+gpio_function_t gpio_get_function(unsigned int gpio) {
+    return gpio < 32 ? pin_function[gpio] : GPIO_FUNC_NULL;
+}
+
+// 8N1: start bit, 8 data bits, stop bit
+uint32_t uart_init(uart_inst_t *uart, uint32_t baudrate) {
+    (void)uart;
+    uart_catch_up();
+    uart_byte_us = 10000000u / baudrate;
+    uart_fifo_tail = uart_fifo_head;
+    return baudrate;
+}
+
+uart_hw_t *uart_get_hw(uart_inst_t *uart) {
+    return &uart->hw;
+}
+
+unsigned uart_get_dreq_num(uart_inst_t *uart, bool is_tx) {
+    (void)uart;
+    return is_tx ? SIM_DREQ_UART0_TX : SIM_DREQ_UART0_TX + 1;
+}
+
+int dma_claim_unused_channel(bool required) {
+    for (int c = 0; c < SIM_DMA_CHANNELS; c++) {
+        if (!dma[c].claimed) {
+            dma[c].claimed = true;
+            return c;
+        }
+    }
+    if (required) {
+        fprintf(stderr, "sim: no free DMA channel\n");
+        exit(2);
+    }
+    return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(unsigned channel) {
+    (void)channel;
+    dma_channel_config c = {
+        .size = DMA_SIZE_32,
+        .read_increment = true,
+        .write_increment = false,
+        .dreq = 0x3F,   // DREQ_FORCE: unpaced
+    };
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) {
+    c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *c, bool incr) {
+    c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) {
+    c->write_increment = incr;
+}
+
+void channel_config_set_ring(dma_channel_config *c, bool write, unsigned size_bits) {
+    c->ring_write = write;
+    c->ring_bits = size_bits;
+}
+
+void channel_config_set_dreq(dma_channel_config *c, unsigned dreq) {
+    c->dreq = dreq;
+}
+
+void dma_channel_configure(unsigned channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *read_addr,
+                           unsigned transfer_count, bool trigger) {
+    (void)write_addr;
+    uart_catch_up();
+    sim_dma_channel_t *ch = &dma[channel];
+    ch->config = *config;
+    ch->read_addr = read_addr;
+    ch->remaining = trigger ? transfer_count : 0;
+    ch->start_us = sim_clock_us;
+}
+
+void dma_channel_transfer_from_buffer_now(unsigned channel, const volatile void *read_addr,
+                                          uint32_t transfer_count) {
+    uart_catch_up();
+    sim_dma_channel_t *ch = &dma[channel];
+    ch->read_addr = read_addr;
+    ch->remaining = transfer_count;
+    ch->start_us = sim_clock_us;
+    uart_catch_up();
+}
+
+bool dma_channel_is_busy(unsigned channel) {
+    uart_catch_up();
+    return dma[channel].remaining != 0;
+}
+
+void dma_channel_abort(unsigned channel) {
+    uart_catch_up();
+    dma[channel].remaining = 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Simulated Hardware Layer
+ *
+ * Backs the stand-in Pico SDK headers in hal/: a simulated microsecond
+ * clock, the 12×12 key matrix seen through gpio_put/gpio_get_all and the
+ * read pins' rising-edge IRQs, a model of the TinyUSB MIDI TX FIFO and a
+ * log of every MIDI message it sends, and a UART fed by DMA with a log of
+ * every byte it sends.
+ */
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "note_map.h"
+
+// Maximum MIDI messages kept in the log per run
+#define SIM_MIDI_LOG_SIZE  65536
+
+// Repeating timers (alarm pool stand-in) active at once
+#define SIM_MAX_TIMERS     4
+
+// USB-MIDI packets the simulated host can queue towards the device
+#define SIM_MIDI_RX_SIZE   256
+
+// TX FIFO (CFG_TUD_MIDI_TX_BUFSIZE at full speed) and USB frame period: the
+// host takes at most one 64-byte bulk transfer per frame
+#define SIM_MIDI_TX_FIFO_PACKETS  16
+#define SIM_USB_FRAME_US          1000
+
+// UART TX FIFO depth, DMA channels, DREQ of the UART0 TX FIFO and bytes
+// kept in the UART log per run
+#define SIM_UART_FIFO_BYTES       32
+#define SIM_DMA_CHANNELS          12
+#define SIM_DREQ_UART0_TX         20
+#define SIM_UART_LOG_SIZE         131072
+
+// One MIDI message as sent over USB
+typedef struct {
+    uint64_t time_us;   // Simulated time of the USB transfer
+    uint8_t msg[3];
+    uint8_t len;
+} sim_midi_event_t;
+
+// Raw UMP messages kept in the UMP log per run
+#define SIM_UMP_LOG_SIZE          65536
+
+// One UMP message as sent over USB (USB-MIDI 2.0 host only)
+typedef struct {
+    uint64_t time_us;   // Simulated time of the USB transfer
+    uint32_t words[4];
+    uint8_t count;
+} sim_ump_message_t;
+
+// One byte as sent by the UART
+typedef struct {
+    uint64_t time_us;   // Simulated time of its start bit
+    uint8_t byte;
+} sim_uart_byte_t;
+
+// Called before every matrix read so pending timeline edges can be applied
+typedef void (*sim_input_hook_t)(uint64_t now_us, void *ctx);
+
+// Called every period_us of simulated time, whoever advances the clock
+typedef void (*sim_tick_hook_t)(void *ctx);
+
+// Reset clock, matrix, drive pins, pin functions, GPIO IRQs, USB FIFO, MIDI
+// log, UART, DMA, hooks and timers
+void sim_hal_reset(void);
+
+// Install the hook that updates the matrix from a timeline
+void sim_hal_set_input_hook(sim_input_hook_t hook, void *ctx);
+
+// Install a periodic hook, e.g. the core0 USB loop running alongside the
+// scanner. The hook and timer callbacks must not advance the clock.
+void sim_hal_set_tick_hook(sim_tick_hook_t hook, uint32_t period_us, void *ctx);
+
+// Simulated clock
+uint64_t sim_now_us(void);
+void sim_advance_us(uint64_t us);
+
+// Host IN polls at any time: the first tud_task() of each frame sends
+#define SIM_USB_POLL_ANY  UINT32_MAX
+
+// USB host frame model. poll_us: the host polls the IN endpoint once per
+// frame, poll_us after its SOF, and takes what the FIFO held by then
+// (SIM_USB_POLL_ANY: whenever tud_task() first runs in a frame). sof: SOFs
+// reach tud_sof_cb() from tud_task(), once per frame, when enabled with
+// tud_sof_cb_enable(). Survives reset; the default is SIM_USB_POLL_ANY with
+// no SOFs, so the scan scheduler runs free of the USB clock.
+void sim_hal_set_usb_frames(uint32_t poll_us, bool sof);
+
+// Offset added to the clock the firmware sees (time_us_64/time_us_32), e.g.
+// to run a scenario across the 32-bit microsecond wrap. Survives reset.
+void sim_hal_set_epoch(uint64_t epoch_us);
+
+// Settle model: a row's closed switches reach the read pins settle_us[drive]
+// after it is driven, and keep reaching them for settle_us[drive] after it
+// is released. NULL turns it off (rows switch instantly). Survives reset.
+void sim_hal_set_settle_model(const uint32_t settle_us[NUM_DRIVE_PINS]);
+
+// Read noise: every matrix position read flips with probability
+// per_million / 1e6, from a generator restarted with seed on every reset.
+// 0 turns it off. Survives reset.
+void sim_hal_set_read_noise(uint32_t per_million, uint32_t seed);
+
+// Positions flipped by read noise since the last reset
+uint64_t sim_hal_noise_flips(void);
+
+// Charge firmware CPU time to the simulated clock: from begin to end, host
+// cycles spent outside the stand-in calls (gpio_put, gpio_get_all,
+// time_us_64/32, busy waits) advance the clock at host_cycles_per_us.
+// Outside begin/end, and after a reset, firmware code takes no time.
+void sim_hal_cpu_begin(uint32_t host_cycles_per_us);
+void sim_hal_cpu_end(void);
+
+// Raise the GPIO bank IRQ for read pins that rose since the last poll (or
+// since their rising-edge IRQ was enabled), calling the gpio_set_irq_callback()
+// callback once per pin. Applies pending timeline edges first; read noise
+// does not reach it. The simulated core calls it while it sleeps.
+void sim_hal_gpio_irq_poll(void);
+
+// Open or close one matrix position (drive row, read column)
+void sim_set_position(uint8_t drive, uint8_t read, bool closed);
+
+// MIDI messages written so far
+const sim_midi_event_t *sim_midi_log(size_t *count);
+
+// Act as a USB-MIDI 2.0 host: select the UMP alternate setting (reset
+// deselects it). While selected, USB traffic is UMP words: the TX FIFO holds
+// SIM_MIDI_TX_FIFO_PACKETS words, every message sent goes to the UMP log and
+// its MIDI 1.0 translation (16-bit velocity >> 9) to the MIDI log.
+void sim_ump_host_select(bool selected);
+
+// Queue a UMP message from the host for usb_midi_ump_read(). Returns false
+// if the receive queue cannot take all of it.
+bool sim_ump_host_send(const uint32_t *words, uint32_t count);
+
+// UMP messages sent so far
+const sim_ump_message_t *sim_ump_log(size_t *count);
+
+// Bytes the UART has started sending by now
+const sim_uart_byte_t *sim_uart_log(size_t *count);
+
+// Queue a 4-byte USB-MIDI packet from the host for tud_midi_packet_read().
+// Returns false if the receive queue is full.
+bool sim_midi_host_send(const uint8_t packet[4]);
+
+#endif // SIM_HAL_H
@@ -0,0 +1,1380 @@
+/*
+ * Keyboard Host Simulator
+ *
+ * Runs src/scan_engine.c against the simulated hardware layer, replays
+ * scripted matrix timelines and reports throughput, scan-to-MIDI latency
+ * and host CPU cost per scan.
+ *
+ * Usage: keyboard_sim [--scan gpio|pio] [--midi-out FILE] [--epoch US] [--hist]
+ *                     [--profile] [--health] [--bounce US] [--noise PPM] [--sweep-out FILE]
+ *                     [--trace-out FILE] [--update-golden] [--ump midi1|midi2] [--sof]
+ *                     <scenario | script | trace> ...
+ *   Built-in scenarios: idle, chord, gliss, trill, pianissimo
+ *   FILE.trace: replay a recorded trace and compare its MIDI with FILE.golden
+ *   pio-check: verify the PIO scanner frame format and timing model
+ *   queue-stress: two-thread stress test of the core1 -> core0 note queue
+ *   bench-scan: cycles per processed frame with 0, 10 and 61 keys held
+ *   bench-frame: CPU scan frame period with firmware CPU time on the clock
+ *   curve-check: velocity curve tables and the curve-select MIDI CC
+ *   velocity-check: velocity error against known sensor deltas at every phase
+ *   settle-sweep: settle-time characterization sweep against a modelled matrix
+ *   stream-check: byte-exact checks of the byte-stream MIDI encoder
+ *   ump-check: UMP packets, 16-bit velocity tables and MIDI 2.0 negotiation
+ *   release-check: release velocity and early Note Off on scripted releases
+ *   wake-check: idle wake parking, read pin wake-ups and first-note latency
+ *   sof-check: scan end to USB transfer spread with and without the SOF lock
+ *
+ * --scan selects the acquisition path: the busy-wait scan_matrix() loop or
+ * the PIO + DMA scanner model. Defaults to the firmware's SCAN_USE_PIO setting.
+ * --hist fetches the latency histograms after each run with the SysEx dump
+ * request, prints them and checks them against the firmware's RAM copy.
+ * --profile fetches the main loop phase profiles the same way and prints them
+ * (host cycles: the SysTick stand-in counts the workstation's clock).
+ * --health fetches the health counters the same way, prints them and checks
+ * them against the counters in RAM.
+ * --bounce adds 1-3 contact bounces within US after every scripted edge and
+ * --noise flips each matrix read with probability PPM per million, to compare
+ * the debounce engines (keyboard_sim_vertical is built with DEBOUNCE_VERTICAL).
+ * --sweep-out writes the settle-sweep recording (tools/settle_profile.py input).
+ * --trace-out records each scenario through the firmware's SysEx trace capture
+ * and writes the trace (trace.h); --update-golden writes each replayed trace's
+ * MIDI log as its golden file instead of comparing against it.
+ * --ump makes the simulated host select USB-MIDI 2.0 (UMP) and ask for the
+ * given protocol at the start of each run; the MIDI log then holds the notes'
+ * MIDI 1.0 translation, so goldens still compare.
+ * --sof makes the simulated host send SOFs and poll the IN endpoint
+ * USB_POLL_US after each one, so the scan scheduler locks to the USB frame.
+ * --epoch offsets the clock the firmware sees; --epoch 4294500000 makes the
+ * built-in scenarios cross the 32-bit microsecond wrap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "hardware/gpio.h"
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "scan_engine.h"
+#include "pio_scanner.h"
+#include "scan_scheduler.h"
+#include "midi_out.h"
+#include "midi_in.h"
+#include "latency_hist.h"
+#include "health.h"
+#include "sysex.h"
+#include "profiler.h"
+#include "settle_profile.h"
+#include "note_queue.h"
+#include "sim_hal.h"
+#include "sim_check.h"
+#include "pio_model.h"
+#include "queue_stress.h"
+#include "bench.h"
+#include "curve_check.h"
+#include "velocity_check.h"
+#include "settle_check.h"
+#include "stream_check.h"
+#include "midi_stream.h"
+#include "midi_uart.h"
+#include "din_check.h"
+#include "ump.h"
+#include "ump_check.h"
+#include "release_check.h"
+#include "wake_check.h"
+#include "idle_wake.h"
+#include "timeline.h"
+#include "trace.h"
+#include "trace_capture.h"
+
+// Time run past the last scripted edge so timeouts and releases complete
+#define RUN_TAIL_US  (VELOCITY_TIMEOUT_US + 50000)
+
+// How often the simulated core0 loop runs
+#define CORE0_PERIOD_US  100
+
+// --sof: the host polls the IN endpoint this long after every SOF
+#define USB_POLL_US  50
+
+// Bursts pushed through the note queue by queue-stress
+#define QUEUE_STRESS_BURSTS  100000
+
+// --trace-out: capture stops this long before the run ends, leaving time for
+// the closing frame and the queued records to reach the host
+#define TRACE_STOP_LEAD_US  (RUN_TAIL_US / 2)
+
+typedef struct {
+    uint32_t count;
+    uint64_t min, max, sum;
+} stat_t;
+
+typedef struct {
+    uint64_t scans;
+    uint64_t sim_time_us;
+    uint32_t note_on, note_off;
+    uint32_t missing;           // Expected events never produced
+    uint32_t unexpected;        // Events no script command asked for
+    uint32_t max_sounding;      // Most notes sounding after any scan
+    uint32_t end_sounding;      // Notes still sounding when the run ended
+    stat_t latency_on;          // Sensor edge to note-on write (us)
+    stat_t latency_off;         // Sensor edge to note-off write (us)
+    stat_t usb_wait_us;         // Scan end (events queued) to the USB transfer of its first
+    stat_t scan_cpu_ns;         // Host time spent in scan_matrix()
+    midi_out_stats_t usb;       // MIDI output packet counters
+    uint32_t max_backlog;       // Most packets left in midi_out after a flush
+    scan_scheduler_stats_t sched; // Scheduler counters at the end of the run
+    idle_wake_stats_t wake;     // Idle wake counters at the end of the run
+    uint64_t idle_scans;        // Scans started at the idle period
+    stat_t scan_jitter_us;      // Scan start interval minus scheduled period
+    uint64_t noise_flips;       // Matrix reads flipped by --noise
+    uint64_t trace_frames;      // Frames replayed (trace runs)
+#ifdef MIDI_UART_ENABLED
+    midi_uart_stats_t din_stats; // DIN transport counters
+    din_result_t din;           // Its wire checked against what it was handed
+    bool din_ok;
+#endif
+} sim_report_t;
+
+typedef enum {
+    SCAN_GPIO,  // scan_matrix(): gpio_put + busy_wait + gpio_get_all per row
+    SCAN_PIO,   // PIO state machine + DMA, CPU only processes frames
+} scan_mode_t;
+
+static timeline_t timeline;
+
+// Bounce model applied to every timeline (--bounce), 0 = clean edges
+static uint32_t bounce_us;
+
+// Stands in for the core1 -> core0 queue
+static note_queue_t note_queue;
+
+// When each note event was queued, in order (end of the scan that found it),
+// and whether the scheduler had locked to the SOF by then
+static uint64_t queued_at[SIM_MIDI_LOG_SIZE];
+static bool queued_locked[SIM_MIDI_LOG_SIZE];
+static size_t queued_count;
+
+static void queue_note_event(const note_event_t *ev) {
+    note_queue_push(&note_queue, ev);
+    if (queued_count < SIM_MIDI_LOG_SIZE) {
+        scan_scheduler_stats_t sched;
+        scan_scheduler_get_stats(&sched);
+        queued_locked[queued_count] = sched.sof_locked > 0;
+        queued_at[queued_count++] = sim_now_us();
+    }
+}
+
+// --sof: SOFs and fixed-phase IN polls from the simulated host
+static bool usb_sof;
+
+// Protocol the simulated host asks for over UMP (--ump), 0 = USB-MIDI 1.0
+static uint8_t ump_protocol;
+
+// Send F0 7D <command> F7 from the simulated host
+static void send_sysex_request(uint8_t command) {
+    if (ump_protocol) {
+        uint8_t data[2] = { SYSEX_MANUFACTURER_ID, command };
+        uint32_t words[2];
+        ump_sysex7(UMP_SYSEX_COMPLETE, data, 2, words);
+        sim_ump_host_send(words, 2);
+        return;
+    }
+
+    uint8_t request[4] = { 0x04, SYSEX_START, SYSEX_MANUFACTURER_ID, command };
+    uint8_t request_end[4] = { 0x05, SYSEX_END, 0, 0 };
+    sim_midi_host_send(request);
+    sim_midi_host_send(request_end);
+}
+
+#ifdef MIDI_UART_ENABLED
+// Messages midi_out handed the DIN transport, and when
+static din_message_t din_queued[SIM_MIDI_LOG_SIZE];
+static size_t din_queued_count;
+
+static bool sim_din_send(const uint8_t msg[3]) {
+    if (!midi_uart_transport.send(msg)) return false;
+
+    if (din_queued_count < SIM_MIDI_LOG_SIZE) {
+        din_message_t *m = &din_queued[din_queued_count++];
+        m->time_us = sim_now_us();
+        memcpy(m->msg, msg, 3);
+    }
+    return true;
+}
+
+static void sim_din_flush(void) {
+    midi_uart_transport.flush();
+}
+
+// The firmware's DIN transport, recording what it is handed
+static const midi_transport_t sim_din_transport = {
+    .send = sim_din_send,
+    .flush = sim_din_flush,
+};
+#endif
+
+// --trace-out: every frame the engine processed, and when to stop the
+// firmware's capture (0: not pending)
+static trace_t engine_frames;
+static bool recording;
+static uint64_t trace_stop_us;
+
+// Frame tap: the firmware's capture, plus the frames as the engine saw them
+static void sim_frame_tap(const uint16_t rows[NUM_DRIVE_PINS], const uint32_t row_time[NUM_DRIVE_PINS]) {
+#ifdef TRACE_CAPTURE
+    trace_capture_frame(rows, row_time);
+#endif
+    if (recording && !trace_record(&engine_frames, rows, row_time)) {
+        fprintf(stderr, "trace: out of memory\n");
+        exit(2);
+    }
+}
+
+// core0 loop from src/keyboard.c, run every CORE0_PERIOD_US alongside the
+// scanner: service USB, then forward queued events as one USB write
+static void core0_service(void *ctx) {
+    sim_report_t *r = ctx;
+    if (trace_stop_us && sim_now_us() >= trace_stop_us) {
+        send_sysex_request(SYSEX_CMD_TRACE_STOP);
+        trace_stop_us = 0;
+    }
+
+    PROFILE_BEGIN(tud_start);
+    tud_task();
+    PROFILE_END(tud_start, PROFILE_TUD_TASK);
+
+    PROFILE_BEGIN(midi_in_start);
+    midi_in_task();
+    PROFILE_END(midi_in_start, PROFILE_MIDI_IN);
+
+    PROFILE_BEGIN(midi_out_start);
+    note_event_t ev;
+    while (note_queue_pop(&note_queue, &ev)) {
+        midi_out_note_event(&ev);
+    }
+#ifdef TRACE_CAPTURE
+    trace_capture_task();
+#endif
+    midi_out_flush();
+    PROFILE_END(midi_out_start, PROFILE_MIDI_OUT);
+
+    if (midi_out_backlog() > r->max_backlog) {
+        r->max_backlog = midi_out_backlog();
+    }
+}
+
+static void stat_add(stat_t *s, uint64_t v) {
+    if (s->count == 0 || v < s->min) s->min = v;
+    if (v > s->max) s->max = v;
+    s->sum += v;
+    s->count++;
+}
+
+static double stat_mean(const stat_t *s) {
+    return s->count ? (double)s->sum / s->count : 0.0;
+}
+
+static uint64_t host_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// ============================================================================
+// BUILT-IN SCENARIOS
+// ============================================================================
+
+// Nothing pressed: pure scan overhead
+static void scenario_idle(timeline_t *tl) {
+    timeline_set(tl, 1000000, 0, 0, false);
+}
+
+// All 61 keys down in the same instant, held, then released together
+static void scenario_chord(timeline_t *tl) {
+    for (uint8_t note = FIRST_KEY; note <= LAST_KEY; note++) {
+        timeline_press(tl, 10000, note, 5000);
+        timeline_release(tl, 500000, note, 5000);
+    }
+}
+
+// Fast upward glissando, one key every 10 ms with overlapping releases
+static void scenario_gliss(timeline_t *tl) {
+    uint64_t t = 10000;
+    for (uint8_t note = FIRST_KEY; note <= LAST_KEY; note++) {
+        timeline_press(tl, t, note, 3000);
+        timeline_release(tl, t + 30000, note, 3000);
+        t += 10000;
+    }
+}
+
+// C4/D4 trill at 16 notes per second for two seconds
+static void scenario_trill(timeline_t *tl) {
+    uint64_t t = 10000;
+    for (int i = 0; i < 32; i++) {
+        uint8_t note = (i & 1) ? D4 : C4;
+        timeline_press(tl, t, note, 4000);
+        timeline_release(tl, t + 40000, note, 4000);
+        t += 62500;
+    }
+}
+
+// Soft playing: 13 slow presses rising over two octaves, first-to-second
+// sensor deltas from 20 ms to 120 ms (velocity timeout is 150 ms)
+static void scenario_pianissimo(timeline_t *tl) {
+    uint64_t t = 10000;
+    for (int i = 0; i <= 12; i++) {
+        uint8_t note = (uint8_t)(C3 + 2 * i);
+        uint32_t delta = 20000 + (uint32_t)i * 100000 / 12;
+        timeline_press(tl, t, note, delta);
+        timeline_release(tl, t + delta + 200000, note, delta);
+        t += 120000;
+    }
+}
+
+static bool build_timeline(timeline_t *tl, const char *name) {
+    timeline_init(tl);
+
+    if (strcmp(name, "idle") == 0) {
+        scenario_idle(tl);
+    } else if (strcmp(name, "chord") == 0) {
+        scenario_chord(tl);
+    } else if (strcmp(name, "gliss") == 0) {
+        scenario_gliss(tl);
+    } else if (strcmp(name, "trill") == 0) {
+        scenario_trill(tl);
+    } else if (strcmp(name, "pianissimo") == 0) {
+        scenario_pianissimo(tl);
+    } else if (!timeline_load(tl, name)) {
+        return false;
+    }
+
+    if (!timeline_add_bounce(tl, bounce_us, 1)) {
+        fprintf(stderr, "%s: too many edges with --bounce %u\n", name, bounce_us);
+        return false;
+    }
+    timeline_finalize(tl);
+    return true;
+}
+
+// ============================================================================
+// RUN + REPORT
+// ============================================================================
+
+// Decode a logged message to engine note index (channel 1 carries 128-143)
+static bool decode_note(const sim_midi_event_t *ev, uint8_t *note, bool *on) {
+    if (ev->len != 3) return false;
+
+    uint8_t status = ev->msg[0] & 0xF0;
+    uint8_t channel = ev->msg[0] & 0x0F;
+    if (status != 0x90 && status != 0x80) return false;
+
+    *note = (uint8_t)(ev->msg[1] + (channel == 1 ? 128 : 0));
+    *on = status == 0x90 && ev->msg[2] != 0;
+    return true;
+}
+
+// Pair every MIDI event with the earliest unmatched expectation for it
+static void match_latency(const timeline_t *tl, sim_report_t *r) {
+    static bool matched[TIMELINE_MAX_EXPECTS];
+    memset(matched, 0, sizeof(matched));
+
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t note;
+        bool on;
+        if (!decode_note(&log[i], &note, &on)) continue;
+
+        if (on) r->note_on++; else r->note_off++;
+
+        bool found = false;
+        for (uint32_t x = 0; x < tl->num_expects; x++) {
+            const timeline_expect_t *exp = &tl->expects[x];
+            if (matched[x] || exp->note != note || exp->note_on != on) continue;
+            if (exp->ref_time_us > log[i].time_us) break;
+
+            matched[x] = true;
+            found = true;
+            stat_add(on ? &r->latency_on : &r->latency_off, log[i].time_us - exp->ref_time_us);
+            break;
+        }
+        if (!found) r->unexpected++;
+    }
+
+    for (uint32_t x = 0; x < tl->num_expects; x++) {
+        if (!matched[x]) r->missing++;
+    }
+}
+
+// Pair note messages on the wire with the queued events, in order, and time
+// the first of each scan's events (the rest may queue behind a full FIFO).
+// With --sof, scans before the scheduler first locked are left out.
+static void match_usb_wait(sim_report_t *r) {
+    size_t count, queued = 0;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+    for (size_t i = 0; i < count && queued < queued_count; i++) {
+        uint8_t note;
+        bool on;
+        if (!decode_note(&log[i], &note, &on)) continue;
+
+        bool first = queued == 0 || queued_at[queued] != queued_at[queued - 1];
+        if (first && (!usb_sof || queued_locked[queued])) {
+            stat_add(&r->usb_wait_us, log[i].time_us - queued_at[queued]);
+        }
+        queued++;
+    }
+}
+
+// ============================================================================
+// SIMULATED CORE1: scans started by the scan scheduler's alarm
+// ============================================================================
+
+static volatile bool scan_requested;
+static bool scan_running;
+
+// Trigger for the CPU scan, as request_cpu_scan() in src/keyboard.c
+static bool request_cpu_scan(void) {
+    if (scan_requested) return false;
+    scan_requested = true;
+    return true;
+}
+
+// Trigger for the PIO model, as pio_scanner_start_frame()
+static bool request_pio_frame(void) {
+    if (scan_requested || scan_running) return false;
+    scan_requested = true;
+    return true;
+}
+
+// Scan started or waiting to be processed, as idle_wake's pending check
+static bool scan_pending(void) {
+    return scan_requested || scan_running;
+}
+
+// __wfe() until the next tick (or read pin IRQ while parked); false once the
+// run is over
+static bool wait_for_scan(uint64_t end, sim_report_t *r) {
+    static uint64_t last_start;
+    static uint32_t last_period;
+    bool woke = false;
+
+    while (!scan_requested) {
+        if (sim_now_us() >= end) return false;
+        sim_advance_us(1);
+#ifdef IDLE_WAKE
+        sim_hal_gpio_irq_poll();
+#ifdef TRACE_CAPTURE
+        if (trace_capture_active()) idle_wake_resume();
+#endif
+        woke |= idle_wake_poll();
+#endif
+    }
+    scan_requested = false;
+
+    // Deviation of this scan's start from the period it was scheduled at
+    // (not across a park)
+    scan_scheduler_stats_t sched;
+    scan_scheduler_get_stats(&sched);
+    uint64_t now = sim_now_us();
+    if (r->scans != 0 && sched.period_us == last_period && !woke) {
+        uint64_t interval = now - last_start;
+        stat_add(&r->scan_jitter_us, interval > sched.period_us ? interval - sched.period_us
+                                                              : sched.period_us - interval);
+    }
+    if (sched.period_us == SCAN_IDLE_PERIOD_US) r->idle_scans++;
+    last_start = now;
+    last_period = sched.period_us;
+    return true;
+}
+
+// Record per-scan peaks and let the scheduler adapt the rate
+static void after_scan(sim_report_t *r) {
+    r->scans++;
+    if (scan_engine_sounding_count() > r->max_sounding) {
+        r->max_sounding = scan_engine_sounding_count();
+    }
+    scan_scheduler_frame_done(scan_engine_keys_moving());
+#ifdef IDLE_WAKE
+    bool busy = scan_engine_keys_moving() || scan_engine_any_closed();
+#ifdef TRACE_CAPTURE
+    busy |= trace_capture_active();
+#endif
+    idle_wake_frame_done(busy);
+#endif
+}
+
+// Same order as scanner_step() in src/keyboard.c
+static void run_gpio_loop(uint64_t end, sim_report_t *r) {
+    // Drive pins as init_matrix_pins() leaves them
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        gpio_set_function(DRIVE0 + drive, GPIO_FUNC_SIO);
+    }
+    scan_scheduler_init(request_cpu_scan);
+#ifdef IDLE_WAKE
+    idle_wake_init(scan_pending);
+#endif
+
+    while (wait_for_scan(end, r)) {
+        uint64_t t0 = host_ns();
+        scan_matrix();
+        stat_add(&r->scan_cpu_ns, host_ns() - t0);
+        after_scan(r);
+    }
+}
+
+// PIO scanner: the tick starts a frame, the CPU only processes it
+static void run_pio_loop(uint64_t end, sim_report_t *r) {
+    uint32_t descriptors[NUM_DRIVE_PINS];
+    uint32_t offset_us[NUM_DRIVE_PINS];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        descriptors[drive] = pio_scan_descriptor(drive, settle_profile_us[drive]);
+    }
+    pio_scan_sample_offsets(descriptors, offset_us);
+
+    // The state machine owns the drive pins (pio_gpio_init)
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        gpio_set_function(DRIVE0 + drive, GPIO_FUNC_PIO0);
+    }
+    scan_scheduler_init(request_pio_frame);
+#ifdef IDLE_WAKE
+    idle_wake_init(scan_pending);
+#endif
+
+    while (wait_for_scan(end, r)) {
+        uint32_t raw[NUM_DRIVE_PINS];
+        uint64_t sample_us[NUM_DRIVE_PINS];
+        uint32_t start = time_us_32();      // As pio_scanner_start_frame()
+        scan_running = true;
+        pio_model_run_frame(descriptors, raw, sample_us);
+        scan_running = false;
+
+        // Rows and sample times as pio_scanner_get_frame() builds them
+        uint64_t t0 = host_ns();
+        uint16_t rows[NUM_DRIVE_PINS];
+        uint32_t row_time[NUM_DRIVE_PINS];
+        for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+            rows[drive] = pio_scan_sample_to_row(raw[drive]);
+            row_time[drive] = start + offset_us[drive];
+        }
+        scan_engine_process_frame(rows, row_time);
+        stat_add(&r->scan_cpu_ns, host_ns() - t0);
+        after_scan(r);
+    }
+}
+
+// Add the DIN transport as keyboard.c does (after midi_out_init)
+static void start_din(void) {
+#ifdef MIDI_UART_ENABLED
+    midi_uart_init();
+    din_queued_count = 0;
+    midi_out_add_transport(&sim_din_transport);
+#endif
+}
+
+// Let the UART send what is still queued, with the core0 loop restarting
+// the DMA as usual, then check its wire against what it was handed
+static void finish_din(sim_report_t *r) {
+#ifdef MIDI_UART_ENABLED
+    uint32_t byte_us = 10000000u / MIDI_UART_BAUD;
+    size_t sent;
+    midi_uart_get_stats(&r->din_stats);
+    for (int i = 0; i < 100000; i++) {
+        sim_uart_log(&sent);
+        if (sent >= r->din_stats.bytes) break;
+        sim_advance_us(CORE0_PERIOD_US);
+    }
+
+    const sim_uart_byte_t *wire = sim_uart_log(&sent);
+    r->din_ok = din_check(din_queued, din_queued_count, MIDI_UART_STREAM_FLAGS, wire, sent,
+                          byte_us, CORE0_PERIOD_US, &r->din);
+#else
+    (void)r;
+#endif
+}
+
+#ifdef MIDI_UART_ENABLED
+static void print_din(const sim_report_t *r) {
+    const din_result_t *d = &r->din;
+    printf("  din midi         %zu messages, %zu bytes (%.2f/message), %u dropped (ring max %u)\n",
+           d->decoded, d->bytes, d->decoded ? (double)d->bytes / d->decoded : 0.0,
+           r->din_stats.dropped, r->din_stats.max_fill);
+    printf("  din timing       queued to first byte max %llu us, to last byte done mean %.0f max %llu us\n",
+           (unsigned long long)d->max_wait_us,
+           d->decoded ? (double)d->sum_done_us / d->decoded : 0.0,
+           (unsigned long long)d->max_done_us);
+    if (r->din_ok) {
+        printf("  din check        same %zu messages as queued, in order, bytes back to back\n", d->queued);
+    } else {
+        printf("  din check        FAILED: first difference at message ");
+        if (d->first_diff == SIZE_MAX) printf("none"); else printf("%zu", d->first_diff);
+        printf(" (%zu queued, %zu on the wire), %u overlapping bytes, %u early, %u stalled\n",
+               d->queued, d->decoded, d->overlaps, d->early, d->stalls);
+    }
+}
+#endif
+
+// --ump: the host selects UMP and asks for its protocol before the first
+// scan; midi_in negotiates on the first core0 pass
+static void start_ump(void) {
+    if (!ump_protocol) return;
+
+    uint32_t request[4];
+    sim_ump_host_select(true);
+    ump_stream_config_request(ump_protocol, request);
+    sim_ump_host_send(request, 4);
+}
+
+static void print_ump(void) {
+    if (!ump_protocol) return;
+
+    size_t count;
+    const sim_ump_message_t *log = sim_ump_log(&count);
+    static bool seen[65536];
+    uint32_t notes = 0, words = 0, distinct = 0;
+    memset(seen, 0, sizeof(seen));
+    for (size_t i = 0; i < count; i++) {
+        const sim_ump_message_t *m = &log[i];
+        words += m->count;
+        if (!ump_is_note(m->words[0])) continue;
+
+        notes++;
+        bool on = ((m->words[0] >> 16) & 0xF0) == 0x90;
+        uint16_t velocity = ump_type(m->words[0]) == UMP_MT_MIDI2 ? (uint16_t)(m->words[1] >> 16)
+                                                                 : (uint16_t)(m->words[0] & 0x7F);
+        if (on && !seen[velocity]) {
+            seen[velocity] = true;
+            distinct++;
+        }
+    }
+    printf("  ump              %s, %u notes in %zu messages / %u words, %u distinct note-on velocities\n",
+           midi_out_protocol() == MIDI_OUT_UMP_MIDI2 ? "MIDI 2.0 protocol" : "MIDI 1.0 protocol",
+           notes, count, words, distinct);
+}
+
+static void run_timeline(timeline_t *tl, scan_mode_t mode, sim_report_t *r) {
+    memset(r, 0, sizeof(*r));
+
+    sim_hal_reset();
+    sim_hal_set_input_hook(timeline_apply, tl);
+#ifdef SCAN_SOF_LOCK
+    tud_sof_cb_enable(true);
+#endif
+    note_queue_init(&note_queue);
+    queued_count = 0;
+    midi_out_init();
+    start_din();
+    start_ump();
+    latency_hist_clear();
+#ifdef PROFILE_ENABLED
+    profile_clear();
+#endif
+    scan_engine_init(queue_note_event);
+    scan_engine_set_frame_tap(sim_frame_tap);
+    sim_hal_set_tick_hook(core0_service, CORE0_PERIOD_US, r);
+    scan_requested = false;
+    scan_running = false;
+
+    uint64_t end = tl->end_time_us + RUN_TAIL_US;
+    trace_free(&engine_frames);
+    if (recording) {
+        send_sysex_request(SYSEX_CMD_TRACE_START);
+        trace_stop_us = end - TRACE_STOP_LEAD_US;
+    }
+    if (mode == SCAN_PIO) {
+        run_pio_loop(end, r);
+    } else {
+        run_gpio_loop(end, r);
+    }
+
+    r->sim_time_us = sim_now_us();
+    r->end_sounding = scan_engine_sounding_count();
+    r->noise_flips = sim_hal_noise_flips();
+    midi_out_get_stats(&r->usb);
+    scan_scheduler_get_stats(&r->sched);
+#ifdef IDLE_WAKE
+    idle_wake_get_stats(&r->wake);
+#endif
+    match_latency(tl, r);
+    match_usb_wait(r);
+    finish_din(r);
+}
+
+static void print_report(const char *name, scan_mode_t mode, const sim_report_t *r) {
+    uint32_t events = r->note_on + r->note_off;
+    double sim_s = r->sim_time_us / 1e6;
+    double cpu_s = r->scan_cpu_ns.sum / 1e9;
+
+    printf("== %s (%s scan) ==\n", name, mode == SCAN_PIO ? "pio" : "gpio");
+    printf("  scans            %llu over %.3f s simulated (%.1f us/scan, %.1f scans/s)\n",
+           (unsigned long long)r->scans, sim_s,
+           r->scans ? (double)r->sim_time_us / r->scans : 0.0,
+           sim_s > 0 ? r->scans / sim_s : 0.0);
+    printf("  scan schedule    rate counter %u Hz, %llu of %llu scans at the idle period, %u overruns\n",
+           r->sched.rate_hz, (unsigned long long)r->idle_scans,
+           (unsigned long long)r->scans, r->sched.overruns);
+    printf("  scan jitter      timer max %u us, scan start max %llu us mean %.1f us (n=%u)\n",
+           r->sched.max_jitter_us, (unsigned long long)r->scan_jitter_us.max,
+           stat_mean(&r->scan_jitter_us), r->scan_jitter_us.count);
+#ifdef IDLE_WAKE
+    printf("  idle wake        %u parks, %u wakes (IRQ to scan max %u us), parked %.1f%% of the run\n",
+           r->wake.parks, r->wake.wakes, r->wake.max_wake_us,
+           r->sim_time_us ? 100.0 * r->wake.parked_us / r->sim_time_us : 0.0);
+#endif
+#if DEBOUNCE_ENGINE == DEBOUNCE_VERTICAL
+    printf("  debounce         vertical counters, %u samples", DEBOUNCE_SAMPLES);
+#else
+    printf("  debounce         timed, %u us", DEBOUNCE_TIME_US);
+#endif
+    printf(" (bounce %u us, %llu noisy reads)\n", bounce_us, (unsigned long long)r->noise_flips);
+    printf("  midi events      %u (%u on, %u off), %u missing, %u unexpected\n",
+           events, r->note_on, r->note_off, r->missing, r->unexpected);
+    printf("  sounding notes   max %u, %u at end\n", r->max_sounding, r->end_sounding);
+    printf("  usb packets      %u sent, %u deferred, %u dropped (backlog max %u)\n",
+           r->usb.sent, r->usb.deferred, r->usb.dropped, r->max_backlog);
+    printf("  events/s         %.1f simulated, %.0f per host CPU second\n",
+           sim_s > 0 ? events / sim_s : 0.0, cpu_s > 0 ? events / cpu_s : 0.0);
+    printf("  latency note-on  min %llu  mean %.0f  max %llu us (n=%u)\n",
+           (unsigned long long)r->latency_on.min, stat_mean(&r->latency_on),
+           (unsigned long long)r->latency_on.max, r->latency_on.count);
+    printf("  latency note-off min %llu  mean %.0f  max %llu us (n=%u)\n",
+           (unsigned long long)r->latency_off.min, stat_mean(&r->latency_off),
+           (unsigned long long)r->latency_off.max, r->latency_off.count);
+    printf("  usb wait         scan end to its first transfer min %llu  mean %.0f  max %llu us (%s)\n",
+           (unsigned long long)r->usb_wait_us.min, stat_mean(&r->usb_wait_us),
+           (unsigned long long)r->usb_wait_us.max,
+           usb_sof ? "host polls after each SOF" : "host polls any time");
+#ifdef SCAN_SOF_LOCK
+    if (usb_sof) {
+        printf("  sof lock         phase error last %d us, max %u us once locked, "
+               "%u scans within +-%u us, %u outside\n",
+               r->sched.sof_phase_error_us, r->sched.sof_max_error_us, r->sched.sof_locked,
+               SOF_LOCK_TOLERANCE_US, r->sched.sof_unlocked);
+    }
+#endif
+    printf("  cpu per scan     mean %.0f  max %llu ns (host)\n",
+           stat_mean(&r->scan_cpu_ns), (unsigned long long)r->scan_cpu_ns.max);
+#ifdef MIDI_UART_ENABLED
+    print_din(r);
+#endif
+    print_ump();
+}
+
+// ============================================================================
+// SYSEX DUMPS (latency histograms, phase profiles, health counters)
+// ============================================================================
+
+// Time for the simulated core0 to answer a SysEx request
+#define SYSEX_REPLY_US  20000
+
+static const char *stage_names[LATENCY_STAGE_COUNT] = { "accept", "decision", "fifo", "usb" };
+
+typedef void (*sysex_reply_t)(const uint8_t *msg, uint32_t len, void *ctx);
+
+// Send a request with no arguments over the simulated USB port and pass each
+// reply to it (F0 7D <command | 0x40> ... F7) to on_reply. Returns the
+// number of replies.
+static int fetch_sysex(uint8_t command, sysex_reply_t on_reply, void *ctx) {
+    size_t before;
+    sim_midi_log(&before);
+
+    send_sysex_request(command);
+    sim_advance_us(SYSEX_REPLY_US);
+
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+
+    // Reassemble SysEx bytes and split into messages
+    static uint8_t msg[256];
+    uint32_t len = 0;
+    int replies = 0;
+    for (size_t i = before; i < count; i++) {
+        for (uint8_t b = 0; b < log[i].len && len < sizeof(msg); b++) {
+            msg[len++] = log[i].msg[b];
+        }
+        if (len == 0 || msg[len - 1] != SYSEX_END) continue;
+
+        if (len >= 4 && msg[0] == SYSEX_START && msg[1] == SYSEX_MANUFACTURER_ID &&
+            msg[2] == (command | SYSEX_RESPONSE)) {
+            on_reply(msg, len, ctx);
+            replies++;
+        }
+        len = 0;
+    }
+    return replies;
+}
+
+// One stage's histogram: <stage> <bucket count> <counts>
+static void decode_latency_reply(const uint8_t *msg, uint32_t len, void *ctx) {
+    uint32_t (*counts)[LATENCY_HIST_BUCKETS] = ctx;
+    if (len != 6u + LATENCY_HIST_BUCKETS * 5 || msg[3] >= LATENCY_STAGE_COUNT ||
+        msg[4] != LATENCY_HIST_BUCKETS) {
+        return;
+    }
+    for (uint8_t bucket = 0; bucket < LATENCY_HIST_BUCKETS; bucket++) {
+        counts[msg[3]][bucket] = sysex_get_u32(&msg[5 + bucket * 5]);
+    }
+}
+
+// Print the histograms fetched over SysEx; false if they differ from RAM
+static bool print_latency_dump(void) {
+    static uint32_t counts[LATENCY_STAGE_COUNT][LATENCY_HIST_BUCKETS];
+    memset(counts, 0, sizeof(counts));
+    int stages = fetch_sysex(SYSEX_CMD_LATENCY_DUMP, decode_latency_reply, counts);
+
+    bool same = stages == LATENCY_STAGE_COUNT;
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        same &= memcmp(counts[stage], latency_hist_counts((latency_stage_t)stage),
+                       sizeof(counts[stage])) == 0;
+    }
+
+    printf("  latency histograms (SysEx dump, %d stages, %s RAM)\n",
+           stages, same ? "matches" : "DIFFERS FROM");
+    printf("    %-9s", ">= us");
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        printf("%10s", stage_names[stage]);
+    }
+    printf("\n");
+    for (uint8_t bucket = 0; bucket < LATENCY_HIST_BUCKETS; bucket++) {
+        uint32_t row = 0;
+        for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) row |= counts[stage][bucket];
+        if (!row) continue;
+
+        printf("    %-9u", latency_hist_bucket_floor_us(bucket));
+        for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+            printf("%10u", counts[stage][bucket]);
+        }
+        printf("\n");
+    }
+    return same;
+}
+
+#ifdef PROFILE_ENABLED
+static const char *phase_names[PROFILE_PHASE_COUNT] = {
+    "tud_task", "midi_in", "midi_out", "led", "scan_row", "debounce", "vel_timeout",
+};
+
+// One phase: <phase> <count> <min> <mean> <max> <p99>
+static void decode_profile_reply(const uint8_t *msg, uint32_t len, void *ctx) {
+    profile_stats_t *stats = ctx;
+    if (len != 5u + 5 * 5 || msg[3] >= PROFILE_PHASE_COUNT) return;
+
+    profile_stats_t *s = &stats[msg[3]];
+    s->count = sysex_get_u32(&msg[4]);
+    s->min_cycles = sysex_get_u32(&msg[9]);
+    s->mean_cycles = sysex_get_u32(&msg[14]);
+    s->max_cycles = sysex_get_u32(&msg[19]);
+    s->p99_cycles = sysex_get_u32(&msg[24]);
+}
+
+// Print the phase profiles fetched over SysEx; false if a phase is missing
+static bool print_profile_dump(void) {
+    profile_stats_t stats[PROFILE_PHASE_COUNT];
+    memset(stats, 0, sizeof(stats));
+    int phases = fetch_sysex(SYSEX_CMD_PROFILE_DUMP, decode_profile_reply, stats);
+
+    printf("  phase profile (SysEx dump, %d phases, host cycles)\n", phases);
+    printf("    %-12s %10s %8s %8s %8s %8s\n", "phase", "count", "min", "mean", "p99", "max");
+    for (int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+        const profile_stats_t *s = &stats[phase];
+        printf("    %-12s %10u %8u %8u %8u %8u\n", phase_names[phase], s->count,
+               s->min_cycles, s->mean_cycles, s->p99_cycles, s->max_cycles);
+    }
+    return phases == PROFILE_PHASE_COUNT;
+}
+#endif // PROFILE_ENABLED
+
+static const char *health_names[HEALTH_COUNTER_COUNT] = {
+    "uptime ms", "scan rate hz", "scans", "scan overruns", "debounce rejects",
+    "velocity timeouts", "second w/o first", "max frame events", "usb fifo full",
+    "usb dropped",
+};
+
+// <count> <counters>; counters past HEALTH_COUNTER_COUNT are ignored
+static void decode_health_reply(const uint8_t *msg, uint32_t len, void *ctx) {
+    uint32_t *counters = ctx;
+    if (len != 5u + msg[3] * 5u || msg[3] < HEALTH_COUNTER_COUNT) return;
+
+    for (uint8_t i = 0; i < HEALTH_COUNTER_COUNT; i++) {
+        counters[i] = sysex_get_u32(&msg[4 + i * 5]);
+    }
+}
+
+// Print the health counters fetched over SysEx; false if one is outside what
+// RAM held before the request and after the reply (the clock, the scheduler
+// and the reply's own flush keep counting in between)
+static bool print_health_dump(void) {
+    uint32_t before[HEALTH_COUNTER_COUNT], after[HEALTH_COUNTER_COUNT];
+    uint32_t counters[HEALTH_COUNTER_COUNT] = { 0 };
+    health_read(before);
+    int replies = fetch_sysex(SYSEX_CMD_HEALTH_DUMP, decode_health_reply, counters);
+    health_read(after);
+
+    bool same = replies == 1;
+    for (int i = 0; i < HEALTH_COUNTER_COUNT; i++) {
+        if (i == HEALTH_SCAN_RATE_HZ) continue;     // Not a count
+        same &= before[i] <= counters[i] && counters[i] <= after[i];
+    }
+
+    printf("  health counters (SysEx dump, %s RAM)\n", same ? "matches" : "DIFFERS FROM");
+    for (int i = 0; i < HEALTH_COUNTER_COUNT; i++) {
+        printf("    %-18s %10u\n", health_names[i], counters[i]);
+    }
+    return same;
+}
+
+static bool write_midi_log(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return false;
+    }
+
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(f, "%llu", (unsigned long long)log[i].time_us);
+        for (uint8_t b = 0; b < log[i].len; b++) {
+            fprintf(f, " %02X", log[i].msg[b]);
+        }
+        fprintf(f, "\n");
+    }
+
+    fclose(f);
+    return true;
+}
+
+// ============================================================================
+// TRACES (--trace-out recording, replay against golden MIDI logs)
+// ============================================================================
+
+// Simulated time of the first replayed frame's row 0 sample
+#define REPLAY_START_US  1000
+
+// Time run after the last frame so the USB side drains
+#define REPLAY_TAIL_US   20000
+
+// Rebuild the trace the firmware streamed during the last run, check it
+// against the frames the engine processed and save it
+static bool save_captured_trace(const char *path) {
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+    trace_t captured;
+    trace_capture_stats_t stats;
+    trace_init(&captured);
+
+    bool ok = trace_from_capture(&captured, log, count, &stats) && stats.stopped;
+    size_t diff = ok ? trace_compare(&captured, &engine_frames) : 0;
+    printf("  trace capture    %zu frames (%u seen, %u records, %u dropped), %s\n",
+           captured.count, stats.frames, stats.records, stats.dropped,
+           !ok ? "INCOMPLETE" : diff == SIZE_MAX ? "matches the engine's frames" : "DIFFERS");
+    if (ok && diff != SIZE_MAX) {
+        printf("    first difference at frame %zu of %zu\n", diff, engine_frames.count);
+    }
+
+    ok = ok && diff == SIZE_MAX && stats.frames == captured.count && stats.dropped == 0;
+    if (ok) ok = trace_save(&captured, path);
+    trace_free(&captured);
+    return ok;
+}
+
+// Feed every frame of a trace to the engine at its recorded time, with the
+// simulated core0 loop running alongside as in a scenario run
+static void run_trace(const trace_t *tr, sim_report_t *r) {
+    memset(r, 0, sizeof(*r));
+
+    sim_hal_reset();
+    note_queue_init(&note_queue);
+    midi_out_init();
+    start_din();
+    start_ump();
+    latency_hist_clear();
+#ifdef PROFILE_ENABLED
+    profile_clear();
+#endif
+    scan_engine_init(queue_note_event);
+    scan_engine_set_frame_tap(NULL);
+    sim_hal_set_tick_hook(core0_service, CORE0_PERIOD_US, r);
+
+    // A frame is processed once its last row is in
+    uint32_t last_offset = tr->offset_us[NUM_DRIVE_PINS - 1];
+    for (size_t i = 0; i < tr->count; i++) {
+        const trace_frame_t *frame = &tr->frames[i];
+        uint64_t done = REPLAY_START_US + frame->time_us + last_offset;
+        if (done > sim_now_us()) sim_advance_us(done - sim_now_us());
+
+        uint32_t now = time_us_32();
+        uint32_t row_time[NUM_DRIVE_PINS];
+        for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+            row_time[drive] = now - (last_offset - tr->offset_us[drive]);
+        }
+
+        uint64_t t0 = host_ns();
+        scan_engine_process_frame(frame->rows, row_time);
+        stat_add(&r->scan_cpu_ns, host_ns() - t0);
+
+        r->scans++;
+        if (scan_engine_sounding_count() > r->max_sounding) {
+            r->max_sounding = scan_engine_sounding_count();
+        }
+    }
+    sim_advance_us(REPLAY_TAIL_US);
+
+    r->trace_frames = tr->count;
+    r->sim_time_us = sim_now_us();
+    r->end_sounding = scan_engine_sounding_count();
+    midi_out_get_stats(&r->usb);
+
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t note;
+        bool on;
+        if (decode_note(&log[i], &note, &on)) {
+            if (on) r->note_on++; else r->note_off++;
+        }
+    }
+    finish_din(r);
+}
+
+// Bytes per event the replay's MIDI messages would take on a byte-stream
+// line (midi_stream.h) in each encoder mode
+static void print_stream_bytes(uint32_t events) {
+    static const uint8_t modes[] = { 0, MIDI_STREAM_RUNNING_STATUS, MIDI_STREAM_COMPACT };
+    double per_event[3];
+    uint32_t compact_bytes = 0;
+
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+    for (int m = 0; m < 3; m++) {
+        midi_stream_t s;
+        midi_stream_init(&s, modes[m]);
+        uint32_t bytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint8_t out[MIDI_STREAM_MAX_BYTES];
+            if (log[i].len == 3) {
+                bytes += midi_stream_channel_msg(&s, log[i].msg[0], log[i].msg[1], log[i].msg[2], out);
+            }
+        }
+        per_event[m] = events ? (double)bytes / events : 0.0;
+        compact_bytes = bytes;
+    }
+
+    // 10 bits per byte at 31250 baud
+    printf("  byte stream      %.2f plain, %.2f running status, %.2f compact bytes/event "
+           "(compact: %.1f ms on a 31250 baud line)\n", per_event[0], per_event[1], per_event[2],
+           compact_bytes * 0.32);
+}
+
+static void print_trace_report(const char *name, const trace_t *tr, const sim_report_t *r) {
+    uint32_t events = r->note_on + r->note_off;
+    double trace_s = tr->count ? tr->frames[tr->count - 1].time_us / 1e6 : 0.0;
+    double cpu_s = r->scan_cpu_ns.sum / 1e9;
+
+    printf("== %s (trace replay) ==\n", name);
+    printf("  frames           %llu over %.3f s\n", (unsigned long long)r->trace_frames, trace_s);
+#if DEBOUNCE_ENGINE == DEBOUNCE_VERTICAL
+    printf("  debounce         vertical counters, %u samples\n", DEBOUNCE_SAMPLES);
+#else
+    printf("  debounce         timed, %u us\n", DEBOUNCE_TIME_US);
+#endif
+    printf("  midi events      %u (%u on, %u off)\n", events, r->note_on, r->note_off);
+    printf("  sounding notes   max %u, %u at end\n", r->max_sounding, r->end_sounding);
+    printf("  usb packets      %u sent, %u deferred, %u dropped (backlog max %u)\n",
+           r->usb.sent, r->usb.deferred, r->usb.dropped, r->max_backlog);
+    printf("  events/s         %.1f simulated, %.0f per host CPU second\n",
+           trace_s > 0 ? events / trace_s : 0.0, cpu_s > 0 ? events / cpu_s : 0.0);
+    printf("  cpu per frame    mean %.0f  max %llu ns (host)\n",
+           stat_mean(&r->scan_cpu_ns), (unsigned long long)r->scan_cpu_ns.max);
+    print_stream_bytes(events);
+#ifdef MIDI_UART_ENABLED
+    print_din(r);
+#endif
+    print_ump();
+}
+
+// Golden log for a trace: FILE.trace -> FILE.golden
+static void golden_path(const char *trace_path, char *out, size_t size) {
+    size_t len = strlen(trace_path);
+    const char *suffix = ".trace";
+    if (len >= strlen(suffix) && strcmp(trace_path + len - strlen(suffix), suffix) == 0) {
+        len -= strlen(suffix);
+    }
+    snprintf(out, size, "%.*s.golden", (int)len, trace_path);
+}
+
+// Compare the replay's MIDI log with the trace's golden file, or write it
+static bool check_golden(const char *trace_path, bool update) {
+    char path[512];
+    golden_path(trace_path, path, sizeof(path));
+
+    if (update) {
+        if (!write_midi_log(path)) return false;
+        printf("  golden           wrote %s\n", path);
+        return true;
+    }
+
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+    golden_result_t g;
+    if (!golden_compare(path, log, count, &g)) {
+        printf("  golden           %s MISSING (--update-golden writes it)\n", path);
+        return false;
+    }
+
+    if (g.first_diff == SIZE_MAX) {
+        printf("  golden           %s: %zu messages, same bytes, timing max shift %llu us\n",
+               path, g.expected, (unsigned long long)g.max_shift_us);
+        return true;
+    }
+    printf("  golden           %s: DIFFERS at message %zu (%zu expected, %zu produced)\n",
+           path, g.first_diff, g.expected, g.produced);
+    return false;
+}
+
+// ============================================================================
+// SOF LOCK CHECK
+// ============================================================================
+
+// Scan end to USB transfer spread allowed once locked: the core0 pass that
+// drains the queue, plus the phase tolerance either side
+#define SOF_WAIT_SPREAD_US  (CORE0_PERIOD_US + 2 * SOF_LOCK_TOLERANCE_US)
+
+// Play each scenario with the host polling after every SOF, first with no
+// SOFs reaching the firmware (free-running alarm), then with them (locked)
+static bool sof_check_run(scan_mode_t mode) {
+#ifdef SCAN_SOF_LOCK
+    static const char *scenarios[] = { "trill", "gliss", "chord" };
+    bool was_sof = usb_sof;
+    bool ok = true;
+
+    printf("== sof-check (%s scan) ==\n", mode == SCAN_PIO ? "pio" : "gpio");
+    printf("  host polls %u us after each SOF; scans end %u us before one when locked "
+           "(period %u us, %u us free-running)\n",
+           USB_POLL_US, SOF_SCAN_LEAD_US, SCAN_SOF_PERIOD_US, SCAN_PERIOD_US);
+    printf("  %-10s %26s %26s %s\n", "scenario", "free: wait min-max us", "locked: wait min-max us",
+           "phase max / outside");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        sim_report_t free_run, locked;
+        recording = false;
+
+        sim_hal_set_usb_frames(USB_POLL_US, false);
+        usb_sof = false;
+        if (!build_timeline(&timeline, scenarios[i])) return false;
+        run_timeline(&timeline, mode, &free_run);
+
+        sim_hal_set_usb_frames(USB_POLL_US, true);
+        usb_sof = true;
+        if (!build_timeline(&timeline, scenarios[i])) return false;
+        run_timeline(&timeline, mode, &locked);
+
+        // The GPIO scan sends each row's events as the row is read, so only
+        // the PIO frame ends on a fixed phase for all of them
+        uint64_t spread = locked.usb_wait_us.max - locked.usb_wait_us.min;
+        bool pass = !locked.missing && !locked.unexpected && !free_run.missing && !free_run.unexpected &&
+                    (mode != SCAN_PIO || spread <= SOF_WAIT_SPREAD_US) &&
+                    locked.sched.sof_max_error_us <= SOF_LOCK_TOLERANCE_US && locked.sched.overruns == 0;
+        char free_wait[32], locked_wait[32];
+        snprintf(free_wait, sizeof(free_wait), "%llu-%llu", (unsigned long long)free_run.usb_wait_us.min,
+                 (unsigned long long)free_run.usb_wait_us.max);
+        snprintf(locked_wait, sizeof(locked_wait), "%llu-%llu", (unsigned long long)locked.usb_wait_us.min,
+                 (unsigned long long)locked.usb_wait_us.max);
+        printf("  %-10s %26s %26s %6u / %-6u %s\n", scenarios[i], free_wait, locked_wait,
+               locked.sched.sof_max_error_us, locked.sched.sof_unlocked, pass ? "ok" : "FAIL");
+        ok &= pass;
+    }
+    if (mode == SCAN_PIO) {
+        printf("  locked wait spread must stay within %u us (core0 pass + tolerance)\n", SOF_WAIT_SPREAD_US);
+    } else {
+        printf("  locked wait follows the row each event was read on (frame end locked only)\n");
+    }
+
+    usb_sof = was_sof;
+    sim_hal_set_usb_frames(was_sof ? USB_POLL_US : SIM_USB_POLL_ANY, was_sof);
+    return ok;
+#else
+    (void)mode;
+    printf("== sof-check ==\n  not built (SCAN_SOF_LOCK)\n");
+    return true;
+#endif
+}
+
+int main(int argc, char **argv) {
+    const char *midi_out = NULL;
+    const char *sweep_out = NULL;
+    const char *trace_out = NULL;
+    bool update_golden = false;
+#ifdef SCAN_USE_PIO
+    scan_mode_t mode = SCAN_PIO;
+#else
+    scan_mode_t mode = SCAN_GPIO;
+#endif
+    bool hist = false;
+    bool profile = false;
+    bool health = false;
+    int status = 0;
+    int runs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--midi-out") == 0 && i + 1 < argc) {
+            midi_out = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--sweep-out") == 0 && i + 1 < argc) {
+            sweep_out = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--trace-out") == 0 && i + 1 < argc) {
+            trace_out = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--update-golden") == 0) {
+            update_golden = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--hist") == 0) {
+            hist = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--health") == 0) {
+            health = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--bounce") == 0 && i + 1 < argc) {
+            bounce_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+            continue;
+        }
+        if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) {
+            sim_hal_set_read_noise((uint32_t)strtoul(argv[++i], NULL, 0), 1);
+            continue;
+        }
+        if (strcmp(argv[i], "--epoch") == 0 && i + 1 < argc) {
+            sim_hal_set_epoch(strtoull(argv[++i], NULL, 0));
+            continue;
+        }
+        if (strcmp(argv[i], "--ump") == 0 && i + 1 < argc) {
+            ump_protocol = strcmp(argv[++i], "midi2") == 0 ? UMP_PROTOCOL_MIDI2 : UMP_PROTOCOL_MIDI1;
+            continue;
+        }
+        if (strcmp(argv[i], "--sof") == 0) {
+            usb_sof = true;
+            sim_hal_set_usb_frames(USB_POLL_US, true);
+            continue;
+        }
+        if (strcmp(argv[i], "--scan") == 0 && i + 1 < argc) {
+            mode = strcmp(argv[++i], "pio") == 0 ? SCAN_PIO : SCAN_GPIO;
+            continue;
+        }
+
+        runs++;
+        if (strcmp(argv[i], "pio-check") == 0) {
+            if (!pio_model_check()) status = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "curve-check") == 0) {
+            if (!curve_check_run()) status = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "velocity-check") == 0) {
+            if (!velocity_check_run()) status = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "stream-check") == 0) {
+            if (!stream_check_run()) status = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "ump-check") == 0) {
+            if (!ump_check_run()) status = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "release-check") == 0) {
+            if (!release_check_run()) status = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "wake-check") == 0) {
+            if (!wake_check_run()) status = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "sof-check") == 0) {
+            if (!sof_check_run(mode)) status = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "settle-sweep") == 0) {
+            FILE *f = sweep_out ? fopen(sweep_out, "w") : NULL;
+            if (sweep_out && !f) {
+                fprintf(stderr, "cannot write %s\n", sweep_out);
+                return 2;
+            }
+            if (!settle_check_run(f)) status = 1;
+            if (f) fclose(f);
+            continue;
+        }
+        if (strcmp(argv[i], "bench-scan") == 0) {
+            bench_scan_run();
+            continue;
+        }
+        if (strcmp(argv[i], "bench-frame") == 0) {
+            bench_frame_run();
+            continue;
+        }
+        if (strcmp(argv[i], "queue-stress") == 0) {
+            if (!queue_stress_run(QUEUE_STRESS_BURSTS)) status = 1;
+            continue;
+        }
+
+        size_t len = strlen(argv[i]);
+        if (len > 6 && strcmp(argv[i] + len - 6, ".trace") == 0) {
+            trace_t trace;
+            trace_init(&trace);
+            if (!trace_load(&trace, argv[i])) return 2;
+
+            sim_report_t report;
+            run_trace(&trace, &report);
+            print_trace_report(argv[i], &trace, &report);
+            trace_free(&trace);
+#ifdef MIDI_UART_ENABLED
+            if (!report.din_ok) status = 1;
+#endif
+
+            if (!check_golden(argv[i], update_golden)) status = 1;
+            if (midi_out && !write_midi_log(midi_out)) return 2;
+            continue;
+        }
+
+        if (!build_timeline(&timeline, argv[i])) return 2;
+
+        sim_report_t report;
+        recording = trace_out != NULL;
+        run_timeline(&timeline, mode, &report);
+        print_report(argv[i], mode, &report);
+
+        if (report.missing || report.unexpected) status = 1;
+#ifdef MIDI_UART_ENABLED
+        if (!report.din_ok) status = 1;
+#endif
+        if (trace_out && !save_captured_trace(trace_out)) status = 1;
+        if (midi_out && !write_midi_log(midi_out)) return 2;
+        if (hist && !print_latency_dump()) status = 1;
+#ifdef PROFILE_ENABLED
+        if (profile && !print_profile_dump()) status = 1;
+#else
+        if (profile) printf("  phase profile    not built (PROFILE_ENABLED)\n");
+#endif
+        if (health && !print_health_dump()) status = 1;
+    }
+
+    if (runs == 0) {
+        fprintf(stderr, "usage: %s [--scan gpio|pio] [--midi-out FILE] [--epoch US] [--hist] "
+                "[--profile] [--health] [--bounce US] [--noise PPM] [--sweep-out FILE] [--trace-out FILE] "
+                "[--update-golden] [--ump midi1|midi2] [--sof] <idle|chord|gliss|trill|pianissimo|pio-check|queue-stress|bench-scan|"
+                "bench-frame|curve-check|velocity-check|settle-sweep|stream-check|ump-check|release-check|wake-check|sof-check|script|FILE.trace> ...\n", argv[0]);
+        return 2;
+    }
+    return status;
+}
@@ -0,0 +1,151 @@
+/*
+ * MIDI Byte-Stream Encoder Check
+ *
+ * Feeds fixed note event sequences through src/midi_stream.c in each mode
+ * and compares the bytes with hand-written expectations, then prints the
+ * bytes per event of a 61-key chord.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "keyboard_config.h"
+#include "note_map.h"
+#include "midi_stream.h"
+#include "sim_check.h"
+#include "stream_check.h"
+
+#define MAX_EVENTS  8
+#define MAX_BYTES   (MAX_EVENTS * MIDI_STREAM_MAX_BYTES)
+
+// Reset the running status before this event
+#define RESET  0x80
+
+typedef struct {
+    uint8_t note;
+    uint8_t velocity;   // 0: Note Off
+    uint8_t flags;      // RESET
+} event_spec_t;
+
+typedef struct {
+    const char *name;
+    uint8_t mode;
+    event_spec_t events[MAX_EVENTS];
+    uint8_t count;
+    uint8_t expected[MAX_BYTES];
+    uint8_t expected_len;
+} stream_case_t;
+
+static const stream_case_t cases[] = {
+    { "plain: full messages", 0,
+      { { C4, 100, 0 }, { E4, 90, 0 }, { C4, 0, 0 }, { E4, 0, 0 } }, 4,
+      { 0x90, 0x3C, 0x64, 0x90, 0x40, 0x5A, 0x80, 0x3C, 0x00, 0x80, 0x40, 0x00 }, 12 },
+    { "running status: off changes status", MIDI_STREAM_RUNNING_STATUS,
+      { { C4, 100, 0 }, { E4, 90, 0 }, { G4, 80, 0 }, { C4, 0, 0 }, { E4, 0, 0 } }, 5,
+      { 0x90, 0x3C, 0x64, 0x40, 0x5A, 0x43, 0x50, 0x80, 0x3C, 0x00, 0x40, 0x00 }, 12 },
+    { "zero-velocity off only", MIDI_STREAM_ZERO_VEL_OFF,
+      { { C4, 100, 0 }, { C4, 0, 0 } }, 2,
+      { 0x90, 0x3C, 0x64, 0x90, 0x3C, 0x00 }, 6 },
+    { "compact: chord on and off", MIDI_STREAM_COMPACT,
+      { { C4, 100, 0 }, { E4, 90, 0 }, { G4, 80, 0 }, { C4, 0, 0 }, { E4, 0, 0 }, { G4, 0, 0 } }, 6,
+      { 0x90, 0x3C, 0x64, 0x40, 0x5A, 0x43, 0x50, 0x3C, 0x00, 0x40, 0x00, 0x43, 0x00 }, 13 },
+    { "compact: extended note switches channel", MIDI_STREAM_COMPACT,
+      { { C4, 100, 0 }, { 130, 127, 0 }, { 130, 0, 0 }, { C4, 0, 0 } }, 4,
+      { 0x90, 0x3C, 0x64, 0x91, 0x02, 0x7F, 0x02, 0x00, 0x90, 0x3C, 0x00 }, 11 },
+    { "compact: reset resends status", MIDI_STREAM_COMPACT,
+      { { C4, 100, 0 }, { E4, 90, RESET }, { G4, 80, 0 } }, 3,
+      { 0x90, 0x3C, 0x64, 0x90, 0x40, 0x5A, 0x43, 0x50 }, 8 },
+};
+
+static void print_bytes(const char *label, const uint8_t *bytes, uint32_t len) {
+    printf("    %-9s", label);
+    for (uint32_t i = 0; i < len; i++) printf(" %02X", bytes[i]);
+    printf("\n");
+}
+
+static uint32_t encode_event(midi_stream_t *s, uint8_t note, uint8_t velocity, uint8_t *out) {
+    note_event_t ev = {
+        .note = note,
+        .velocity = velocity,
+        .flags = velocity ? NOTE_EVENT_ON : 0,
+    };
+    return midi_stream_note_event(s, &ev, out);
+}
+
+static bool run_case(const stream_case_t *c) {
+    midi_stream_t s;
+    midi_stream_init(&s, c->mode);
+
+    uint8_t bytes[MAX_BYTES];
+    uint32_t len = 0;
+    for (uint8_t i = 0; i < c->count; i++) {
+        const event_spec_t *e = &c->events[i];
+        if (e->flags & RESET) midi_stream_reset(&s);
+        len += encode_event(&s, e->note, e->velocity, &bytes[len]);
+    }
+
+    bool ok = len == c->expected_len && memcmp(bytes, c->expected, len) == 0;
+    expect(ok, c->name);
+    if (!ok) {
+        print_bytes("expected", c->expected, c->expected_len);
+        print_bytes("got", bytes, len);
+    }
+    return ok;
+}
+
+// Non-note messages: data byte counts, release velocity, status range
+static bool check_other_messages(void) {
+    midi_stream_t s;
+    midi_stream_init(&s, MIDI_STREAM_COMPACT);
+    uint8_t out[MIDI_STREAM_MAX_BYTES];
+    bool ok = true;
+
+    uint32_t len = midi_stream_channel_msg(&s, 0xC0, 5, 0, out);
+    ok &= expect(len == 2 && out[0] == 0xC0 && out[1] == 5, "program change: two bytes");
+    len = midi_stream_channel_msg(&s, 0xC0, 6, 0, out);
+    ok &= expect(len == 1 && out[0] == 6, "program change: running status, one byte");
+
+    len = midi_stream_channel_msg(&s, 0x80, C4, 64, out);
+    ok &= expect(len == 3 && out[0] == 0x90 && out[2] == 0, "release velocity dropped: note on, velocity 0");
+
+    midi_stream_init(&s, MIDI_STREAM_RUNNING_STATUS);
+    len = midi_stream_channel_msg(&s, 0x80, C4, 64, out);
+    ok &= expect(len == 3 && out[0] == 0x80 && out[2] == 64, "running status only: release velocity kept");
+
+    len = midi_stream_channel_msg(&s, 0xF0, 0, 0, out);
+    ok &= expect(len == 0, "system message rejected");
+    return ok;
+}
+
+// Bytes per event of all 61 keys pressed and released together
+static double chord_bytes_per_event(uint8_t mode) {
+    midi_stream_t s;
+    midi_stream_init(&s, mode);
+    uint8_t out[MIDI_STREAM_MAX_BYTES];
+    uint32_t bytes = 0, events = 0;
+
+    for (int on = 1; on >= 0; on--) {
+        for (uint8_t note = FIRST_KEY; note <= LAST_KEY; note++) {
+            bytes += encode_event(&s, note, on ? 100 : 0, out);
+            events++;
+        }
+    }
+    return (double)bytes / events;
+}
+
+bool stream_check_run(void) {
+    bool ok = true;
+
+    printf("== stream-check ==\n");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ok &= run_case(&cases[i]);
+    }
+    ok &= check_other_messages();
+
+    double plain = chord_bytes_per_event(0);
+    double running = chord_bytes_per_event(MIDI_STREAM_RUNNING_STATUS);
+    double compact = chord_bytes_per_event(MIDI_STREAM_COMPACT);
+    printf("  61-key chord on+off: %.2f bytes/event plain, %.2f running status, %.2f compact\n",
+           plain, running, compact);
+    ok &= expect(compact < 2.02, "compact chord about two bytes per event");
+    return ok;
+}
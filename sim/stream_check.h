@@ -0,0 +1,13 @@
+/*
+ * MIDI Byte-Stream Encoder Check - see stream_check.c
+ */
+
+#ifndef STREAM_CHECK_H
+#define STREAM_CHECK_H
+
+#include <stdbool.h>
+
+// Runs the byte-exact encoder cases; returns true if all of them matched
+bool stream_check_run(void);
+
+#endif // STREAM_CHECK_H
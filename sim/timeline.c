@@ -0,0 +1,225 @@
+/*
+ * Scripted Matrix Timelines - see timeline.h
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "sim_hal.h"
+#include "timeline.h"
+
+void timeline_init(timeline_t *tl) {
+    memset(tl, 0, sizeof(*tl));
+}
+
+// Find the matrix position of a note's sensor. Returns false if unmapped.
+static bool find_sensor(const uint8_t map[NUM_DRIVE_PINS][NUM_READ_PINS], uint8_t note,
+                        uint8_t *drive, uint8_t *read) {
+    for (uint8_t d = 0; d < NUM_DRIVE_PINS; d++) {
+        for (uint8_t r = 0; r < NUM_READ_PINS; r++) {
+            if (map[d][r] == note) {
+                *drive = d;
+                *read = r;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool timeline_set(timeline_t *tl, uint64_t time_us, uint8_t drive, uint8_t read, bool closed) {
+    if (tl->num_edges >= TIMELINE_MAX_EDGES) return false;
+    if (drive >= NUM_DRIVE_PINS || read >= NUM_READ_PINS) return false;
+
+    timeline_edge_t *e = &tl->edges[tl->num_edges++];
+    e->time_us = time_us;
+    e->drive = drive;
+    e->read = read;
+    e->closed = closed;
+    if (time_us > tl->end_time_us) tl->end_time_us = time_us;
+    return true;
+}
+
+static bool add_expect(timeline_t *tl, uint64_t ref_time_us, uint8_t note, bool note_on) {
+    if (tl->num_expects >= TIMELINE_MAX_EXPECTS) return false;
+
+    timeline_expect_t *x = &tl->expects[tl->num_expects++];
+    x->ref_time_us = ref_time_us;
+    x->note = note;
+    x->note_on = note_on;
+    return true;
+}
+
+bool timeline_press(timeline_t *tl, uint64_t time_us, uint8_t note, uint32_t delta_us) {
+    uint8_t d1 = 0, r1 = 0, d2 = 0, r2 = 0;
+    bool has_first = find_sensor(first_sensor_map, note, &d1, &r1);
+    bool has_second = find_sensor(second_sensor_map, note, &d2, &r2);
+    if (!has_first && !has_second) return false;
+
+    if (has_first && !timeline_set(tl, time_us, d1, r1, true)) return false;
+    if (has_second && !timeline_set(tl, time_us + delta_us, d2, r2, true)) return false;
+
+    // Second sensor completes the note-on, unless the timeout fires first
+    uint64_t ref = time_us + VELOCITY_TIMEOUT_US;
+    if (has_second && (!has_first || delta_us < VELOCITY_TIMEOUT_US)) {
+        ref = time_us + delta_us;
+    }
+    return add_expect(tl, ref, note, true);
+}
+
+bool timeline_release(timeline_t *tl, uint64_t time_us, uint8_t note, uint32_t delta_us) {
+    uint8_t d1 = 0, r1 = 0, d2 = 0, r2 = 0;
+    bool has_first = find_sensor(first_sensor_map, note, &d1, &r1);
+    bool has_second = find_sensor(second_sensor_map, note, &d2, &r2);
+    if (!has_first && !has_second) return false;
+
+    if (has_second && !timeline_set(tl, time_us, d2, r2, false)) return false;
+    if (has_first && !timeline_set(tl, time_us + delta_us, d1, r1, false)) return false;
+
+    // Note-off goes out once both sensors are open
+    uint64_t ref = has_first ? time_us + delta_us : time_us;
+    return add_expect(tl, ref, note, false);
+}
+
+// xorshift32, seeded per call so bounce patterns are repeatable
+static uint32_t bounce_next(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+bool timeline_add_bounce(timeline_t *tl, uint32_t bounce_us, uint32_t seed) {
+    uint32_t state = seed ? seed : 1;
+    uint32_t edges = tl->num_edges;
+    if (bounce_us < 2) return true;
+
+    for (uint32_t i = 0; i < edges; i++) {
+        timeline_edge_t e = tl->edges[i];
+        uint32_t toggles = 2 * (1 + bounce_next(&state) % 3);
+
+        // Strictly increasing offsets inside (0, bounce_us)
+        uint64_t t = e.time_us;
+        uint32_t step = bounce_us / (toggles + 1);
+        for (uint32_t k = 0; k < toggles; k++) {
+            t += 1 + bounce_next(&state) % (step ? step : 1);
+            bool closed = (k & 1) ? e.closed : !e.closed;
+            if (!timeline_set(tl, t, e.drive, e.read, closed)) return false;
+        }
+    }
+    return true;
+}
+
+static int compare_edges(const void *a, const void *b) {
+    const timeline_edge_t *ea = a, *eb = b;
+    if (ea->time_us != eb->time_us) return ea->time_us < eb->time_us ? -1 : 1;
+    return 0;
+}
+
+static int compare_expects(const void *a, const void *b) {
+    const timeline_expect_t *xa = a, *xb = b;
+    if (xa->ref_time_us != xb->ref_time_us) return xa->ref_time_us < xb->ref_time_us ? -1 : 1;
+    return 0;
+}
+
+void timeline_finalize(timeline_t *tl) {
+    // Stable insertion sort: edges at the same time keep script order
+    for (uint32_t i = 1; i < tl->num_edges; i++) {
+        timeline_edge_t e = tl->edges[i];
+        uint32_t j = i;
+        while (j > 0 && compare_edges(&tl->edges[j - 1], &e) > 0) {
+            tl->edges[j] = tl->edges[j - 1];
+            j--;
+        }
+        tl->edges[j] = e;
+    }
+    qsort(tl->expects, tl->num_expects, sizeof(tl->expects[0]), compare_expects);
+    tl->next_edge = 0;
+}
+
+void timeline_apply(uint64_t now_us, void *ctx) {
+    timeline_t *tl = ctx;
+    while (tl->next_edge < tl->num_edges && tl->edges[tl->next_edge].time_us <= now_us) {
+        const timeline_edge_t *e = &tl->edges[tl->next_edge++];
+        sim_set_position(e->drive, e->read, e->closed);
+    }
+}
+
+uint8_t timeline_parse_note(const char *text) {
+    static const int8_t semitone[7] = { 9, 11, 0, 2, 4, 5, 7 }; // A B C D E F G
+    char *end;
+
+    if (isdigit((unsigned char)text[0])) {
+        long n = strtol(text, &end, 10);
+        return (*end == '\0' && n >= 0 && n < MAX_NOTES) ? (uint8_t)n : NOTE_NONE;
+    }
+
+    char letter = (char)toupper((unsigned char)text[0]);
+    if (letter < 'A' || letter > 'G') return NOTE_NONE;
+    int note = semitone[letter - 'A'];
+    text++;
+
+    if (*text == '#' || *text == 's') {
+        note++;
+        text++;
+    }
+
+    // Octave -1 is written C_1 in note_map.h
+    int octave;
+    if (*text == '_' || *text == '-') {
+        octave = -(int)strtol(text + 1, &end, 10);
+    } else {
+        octave = (int)strtol(text, &end, 10);
+    }
+    if (end == text || *end != '\0') return NOTE_NONE;
+
+    note += (octave + 1) * 12;
+    return (note >= 0 && note < MAX_NOTES) ? (uint8_t)note : NOTE_NONE;
+}
+
+bool timeline_load(timeline_t *tl, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "timeline: cannot open %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    unsigned line_no = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        unsigned long long time_us;
+        char cmd[16], a[16], b[16], c[16];
+        int fields = sscanf(line, "%llu %15s %15s %15s %15s", &time_us, cmd, a, b, c);
+        if (fields <= 0) continue;   // Blank or comment
+
+        if (fields >= 2 && strcmp(cmd, "end") == 0) {
+            if (time_us > tl->end_time_us) tl->end_time_us = time_us;
+        } else if (fields == 4 && strcmp(cmd, "press") == 0) {
+            uint8_t note = timeline_parse_note(a);
+            ok = note != NOTE_NONE && timeline_press(tl, time_us, note, (uint32_t)atol(b));
+        } else if (fields == 4 && strcmp(cmd, "release") == 0) {
+            uint8_t note = timeline_parse_note(a);
+            ok = note != NOTE_NONE && timeline_release(tl, time_us, note, (uint32_t)atol(b));
+        } else if (fields == 5 && strcmp(cmd, "set") == 0) {
+            ok = timeline_set(tl, time_us, (uint8_t)atoi(a), (uint8_t)atoi(b), atoi(c) != 0);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "timeline: %s:%u: bad command: %s", path, line_no, line);
+        }
+    }
+
+    fclose(f);
+    return ok;
+}
@@ -0,0 +1,81 @@
+/*
+ * Scripted Matrix Timelines
+ *
+ * A timeline is a time-sorted list of matrix position edges plus the MIDI
+ * events they are expected to produce. Key-level commands are expanded to
+ * sensor edges using first_sensor_map / second_sensor_map, so a script can
+ * say "press C4 with 5 ms between sensors" instead of naming positions.
+ *
+ * Script format (one command per line, '#' starts a comment):
+ *
+ *   <time_us> press   <note> <delta_us>   first sensor closes at time_us,
+ *                                         second at time_us + delta_us
+ *   <time_us> release <note> <delta_us>   second sensor opens at time_us,
+ *                                         first at time_us + delta_us
+ *   <time_us> set     <drive> <read> <0|1>  raw matrix position edge
+ *   <time_us> end                         run until this time
+ *
+ * Notes are MIDI numbers or names such as C4, C#4 or Cs4.
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMELINE_MAX_EDGES    8192
+#define TIMELINE_MAX_EXPECTS  4096
+
+// One matrix position changing state
+typedef struct {
+    uint64_t time_us;
+    uint8_t drive;
+    uint8_t read;
+    bool closed;
+} timeline_edge_t;
+
+// MIDI event a key-level command should produce, and when its cause happened
+typedef struct {
+    uint64_t ref_time_us;   // Time of the sensor edge that completes the event
+    uint8_t note;           // Engine note index (0-143)
+    bool note_on;
+} timeline_expect_t;
+
+typedef struct {
+    timeline_edge_t edges[TIMELINE_MAX_EDGES];
+    uint32_t num_edges;
+    uint32_t next_edge;     // Playback cursor
+    timeline_expect_t expects[TIMELINE_MAX_EXPECTS];
+    uint32_t num_expects;
+    uint64_t end_time_us;
+} timeline_t;
+
+void timeline_init(timeline_t *tl);
+
+// Key-level commands. Return false if the note has no sensor or tl is full.
+bool timeline_press(timeline_t *tl, uint64_t time_us, uint8_t note, uint32_t delta_us);
+bool timeline_release(timeline_t *tl, uint64_t time_us, uint8_t note, uint32_t delta_us);
+
+// Raw position edge
+bool timeline_set(timeline_t *tl, uint64_t time_us, uint8_t drive, uint8_t read, bool closed);
+
+// Load a script file (format above). Prints the offending line on error.
+bool timeline_load(timeline_t *tl, const char *path);
+
+// Bounce model: follow every edge added so far with 1-3 contact bounces
+// (open/close pairs) at random times within bounce_us, ending in the edge's
+// state. Expectations keep the time of the first contact. Returns false if
+// tl fills up.
+bool timeline_add_bounce(timeline_t *tl, uint32_t bounce_us, uint32_t seed);
+
+// Sort edges/expectations by time and rewind playback. Call before running.
+void timeline_finalize(timeline_t *tl);
+
+// sim_input_hook_t: apply every edge up to now_us to the simulated matrix
+void timeline_apply(uint64_t now_us, void *ctx);
+
+// Parse "60", "C4", "C#4" or "Cs4". Returns NOTE_NONE on failure.
+uint8_t timeline_parse_note(const char *text);
+
+#endif // TIMELINE_H
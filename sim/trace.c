@@ -0,0 +1,298 @@
+/*
+ * Matrix Traces - see trace.h
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sysex.h"
+#include "trace_capture.h"
+#include "trace.h"
+
+// Longest SysEx message trace_from_capture() reassembles
+#define CAPTURE_MSG_MAX  128
+
+void trace_init(trace_t *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+void trace_free(trace_t *t) {
+    free(t->frames);
+    trace_init(t);
+}
+
+static bool trace_add(trace_t *t, uint64_t time_us, const uint16_t rows[NUM_DRIVE_PINS]) {
+    if (t->count == t->capacity) {
+        size_t capacity = t->capacity ? t->capacity * 2 : 1024;
+        trace_frame_t *frames = realloc(t->frames, capacity * sizeof(*frames));
+        if (!frames) return false;
+        t->frames = frames;
+        t->capacity = capacity;
+    }
+
+    trace_frame_t *f = &t->frames[t->count++];
+    f->time_us = time_us;
+    memcpy(f->rows, rows, sizeof(f->rows));
+    return true;
+}
+
+// Time from frame 0 of a frame whose row 0 was sampled at time_us_32 now,
+// given that it follows the last frame of t (wrap-safe)
+static uint64_t trace_time_after(const trace_t *t, uint32_t now) {
+    if (t->count == 0) return 0;
+    uint64_t last = t->frames[t->count - 1].time_us;
+    return last + (uint32_t)(now - (uint32_t)(t->origin_us + last));
+}
+
+bool trace_record(trace_t *t, const uint16_t rows[NUM_DRIVE_PINS],
+                  const uint32_t row_time[NUM_DRIVE_PINS]) {
+    if (t->count == 0) {
+        t->origin_us = row_time[0];
+        for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+            t->offset_us[drive] = row_time[drive] - row_time[0];
+        }
+    }
+    return trace_add(t, trace_time_after(t, row_time[0]), rows);
+}
+
+// ============================================================================
+// FILES
+// ============================================================================
+
+bool trace_load(trace_t *t, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "trace: cannot open %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    unsigned line_no = 0;
+    bool header = false, offsets = false, ok = true;
+    uint16_t rows[NUM_DRIVE_PINS] = { 0 };
+
+    while (ok && fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char *p = line;
+        char word[32];
+        int used;
+        if (sscanf(p, "%31s%n", word, &used) != 1) continue;   // Blank or comment
+        p += used;
+
+        if (strcmp(word, "keyboard-trace") == 0) {
+            int format, drives, reads;
+            ok = sscanf(p, "%d drive %d read %d", &format, &drives, &reads) == 3 &&
+                 format == TRACE_FORMAT && drives == NUM_DRIVE_PINS && reads == NUM_READ_PINS;
+            header = ok;
+        } else if (!header) {
+            ok = false;
+        } else if (strcmp(word, "offsets") == 0) {
+            for (uint8_t drive = 0; ok && drive < NUM_DRIVE_PINS; drive++) {
+                unsigned offset;
+                ok = sscanf(p, "%u%n", &offset, &used) == 1;
+                t->offset_us[drive] = offset;
+                p += used;
+            }
+            offsets = ok;
+        } else if (strcmp(word, "end") == 0) {
+            break;
+        } else {
+            // Frame: time, then all rows or none
+            char *end;
+            unsigned long long time_us = strtoull(word, &end, 10);
+            ok = *end == '\0' && offsets &&
+                 (t->count == 0 || time_us >= t->frames[t->count - 1].time_us);
+            uint8_t drive = 0;
+            unsigned row;
+            while (ok && drive < NUM_DRIVE_PINS && sscanf(p, "%x%n", &row, &used) == 1) {
+                rows[drive++] = (uint16_t)row;
+                p += used;
+            }
+            ok = ok && (drive == NUM_DRIVE_PINS || (drive == 0 && t->count != 0));
+            if (ok && !trace_add(t, time_us, rows)) {
+                fprintf(stderr, "trace: %s: out of memory\n", path);
+                fclose(f);
+                return false;
+            }
+        }
+
+        if (!ok) {
+            fprintf(stderr, "trace: %s:%u: bad line: %s", path, line_no, line);
+        }
+    }
+
+    fclose(f);
+    if (ok && t->count == 0) {
+        fprintf(stderr, "trace: %s: no frames\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+bool trace_save(const trace_t *t, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "trace: cannot write %s\n", path);
+        return false;
+    }
+
+    fprintf(f, "keyboard-trace %d drive %d read %d\n", TRACE_FORMAT, NUM_DRIVE_PINS, NUM_READ_PINS);
+    fprintf(f, "offsets");
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        fprintf(f, " %u", t->offset_us[drive]);
+    }
+    fprintf(f, "\n");
+
+    for (size_t i = 0; i < t->count; i++) {
+        const trace_frame_t *frame = &t->frames[i];
+        fprintf(f, "%llu", (unsigned long long)frame->time_us);
+        if (i == 0 || memcmp(frame->rows, frame[-1].rows, sizeof(frame->rows)) != 0) {
+            for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+                fprintf(f, " %03x", frame->rows[drive]);
+            }
+        }
+        fprintf(f, "\n");
+    }
+    fprintf(f, "end\n");
+
+    fclose(f);
+    return true;
+}
+
+// ============================================================================
+// CAPTURE
+// ============================================================================
+
+// One TRACE_START / TRACE_STOP reply (F0 7D <command | 0x40> ... F7)
+static bool decode_capture_msg(trace_t *t, const uint8_t *msg, uint32_t len,
+                               trace_capture_stats_t *stats) {
+    if (len < 4 || msg[1] != SYSEX_MANUFACTURER_ID) return true;
+
+    if (msg[2] == (SYSEX_CMD_TRACE_STOP | SYSEX_RESPONSE) && len == 3 + 3 * 5 + 1) {
+        stats->stopped = true;
+        stats->frames = sysex_get_u32(&msg[3]);
+        stats->records = sysex_get_u32(&msg[8]);
+        stats->dropped = sysex_get_u32(&msg[13]);
+        return true;
+    }
+    if (msg[2] != (SYSEX_CMD_TRACE_START | SYSEX_RESPONSE)) return true;
+
+    if (msg[3] == TRACE_CAPTURE_HEADER && len == 5u + NUM_DRIVE_PINS * 5) {
+        for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+            t->offset_us[drive] = sysex_get_u32(&msg[4 + drive * 5]);
+        }
+        return true;
+    }
+    if (msg[3] != TRACE_CAPTURE_FRAME || len != 20u + NUM_DRIVE_PINS * 2) return true;
+
+    uint32_t now = sysex_get_u32(&msg[4]);
+    uint32_t skipped = sysex_get_u32(&msg[9]);
+    uint32_t period_us = sysex_get_u32(&msg[14]);
+    uint16_t rows[NUM_DRIVE_PINS];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        rows[drive] = (uint16_t)(msg[19 + drive * 2] | (msg[20 + drive * 2] << 7));
+    }
+
+    if (t->count == 0) {
+        t->origin_us = now;
+    } else {
+        // Unchanged frames the tap skipped, one period apart
+        const trace_frame_t last = t->frames[t->count - 1];
+        for (uint32_t i = 1; i <= skipped; i++) {
+            if (!trace_add(t, last.time_us + (uint64_t)i * period_us, last.rows)) return false;
+        }
+    }
+    return trace_add(t, trace_time_after(t, now), rows);
+}
+
+bool trace_from_capture(trace_t *t, const sim_midi_event_t *log, size_t count,
+                        trace_capture_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    // Reassemble SysEx messages; note messages between them are skipped
+    uint8_t msg[CAPTURE_MSG_MAX];
+    uint32_t len = 0;
+    bool in_sysex = false;
+    for (size_t i = 0; i < count; i++) {
+        for (uint8_t b = 0; b < log[i].len; b++) {
+            uint8_t byte = log[i].msg[b];
+            if (byte == SYSEX_START) {
+                in_sysex = true;
+                len = 0;
+            }
+            if (!in_sysex) continue;
+
+            if (len < sizeof(msg)) msg[len++] = byte;
+            if (byte == SYSEX_END) {
+                in_sysex = false;
+                if (!decode_capture_msg(t, msg, len, stats)) return false;
+            }
+        }
+    }
+    return t->count != 0;
+}
+
+size_t trace_compare(const trace_t *part, const trace_t *whole) {
+    size_t start = 0;
+    while (start < whole->count &&
+           (uint32_t)(whole->origin_us + whole->frames[start].time_us) != part->origin_us) {
+        start++;
+    }
+    if (memcmp(part->offset_us, whole->offset_us, sizeof(part->offset_us)) != 0) return 0;
+
+    for (size_t i = 0; i < part->count; i++) {
+        if (start + i >= whole->count) return i;
+        const trace_frame_t *a = &part->frames[i];
+        const trace_frame_t *b = &whole->frames[start + i];
+        if (a->time_us != b->time_us - whole->frames[start].time_us ||
+            memcmp(a->rows, b->rows, sizeof(a->rows)) != 0) {
+            return i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+// ============================================================================
+// GOLDEN MIDI LOGS
+// ============================================================================
+
+bool golden_compare(const char *path, const sim_midi_event_t *log, size_t count,
+                    golden_result_t *out) {
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    memset(out, 0, sizeof(*out));
+    out->produced = count;
+    out->first_diff = SIZE_MAX;
+
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long time_us;
+        unsigned b[3];
+        int fields = sscanf(line, "%llu %x %x %x", &time_us, &b[0], &b[1], &b[2]);
+        if (fields < 2) continue;
+
+        size_t i = out->expected++;
+        if (out->first_diff != SIZE_MAX) continue;
+
+        const sim_midi_event_t *ev = i < count ? &log[i] : NULL;
+        bool same = ev && ev->len == fields - 1;
+        for (int k = 0; same && k < fields - 1; k++) {
+            same = ev->msg[k] == b[k];
+        }
+        if (!same) {
+            out->first_diff = i;
+            continue;
+        }
+
+        uint64_t shift = ev->time_us > time_us ? ev->time_us - time_us : time_us - ev->time_us;
+        if (shift > out->max_shift_us) out->max_shift_us = shift;
+    }
+    fclose(f);
+
+    // Extra messages in the run
+    if (out->first_diff == SIZE_MAX && count > out->expected) out->first_diff = out->expected;
+    return true;
+}
@@ -0,0 +1,93 @@
+/*
+ * Matrix Traces
+ *
+ * A trace is every frame the scan engine processed, as raw row words plus
+ * when each row was sampled. Replaying one through
+ * scan_engine_process_frame() feeds the engine exactly what it saw, so a
+ * debounce, velocity or batching change can be checked against a golden MIDI
+ * log of the same trace and timed on the host.
+ *
+ * Traces come from the firmware's SysEx capture (trace_capture.h), recorded
+ * from real playing by tools/trace_capture.py or from a simulated run by
+ * keyboard_sim --trace-out.
+ *
+ * File format (one item per line, '#' starts a comment):
+ *
+ *   keyboard-trace <format> drive <n> read <n>
+ *   offsets <us> ...                  sample time of each row after row 0
+ *   <time_us> <row 0> ... <row 11>    one frame: row 0 sampled at time_us
+ *                                     (from the first frame), rows as hex
+ *                                     words of read columns 0-11
+ *   <time_us>                         one frame, rows as in the previous one
+ *   end
+ *
+ * Golden files are MIDI logs as written by --midi-out: one message per line,
+ * "<time_us> <byte> ...", bytes in hex.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "note_map.h"
+#include "sim_hal.h"
+
+// Version of the text format
+#define TRACE_FORMAT  1
+
+typedef struct {
+    uint64_t time_us;                   // Row 0 sample time, from frame 0
+    uint16_t rows[NUM_DRIVE_PINS];
+} trace_frame_t;
+
+typedef struct {
+    uint32_t offset_us[NUM_DRIVE_PINS]; // Row sample times after row 0
+    uint32_t origin_us;                 // time_us_32 of frame 0 (not saved)
+    trace_frame_t *frames;
+    size_t count;
+    size_t capacity;
+} trace_t;
+
+// What a capture's stop reply reported
+typedef struct {
+    bool stopped;       // Stop reply seen
+    uint32_t frames;    // Frames the tap saw while capturing
+    uint32_t records;   // Records it queued
+    uint32_t dropped;   // Records lost to a full queue
+} trace_capture_stats_t;
+
+typedef struct {
+    size_t expected;        // Messages in the golden file
+    size_t produced;        // Messages in the run's MIDI log
+    size_t first_diff;      // First message whose bytes differ (SIZE_MAX: none)
+    uint64_t max_shift_us;  // Largest time difference of messages with equal bytes
+} golden_result_t;
+
+void trace_init(trace_t *t);
+void trace_free(trace_t *t);
+
+// Append a frame as the engine saw it (row_time in time_us_32); the first
+// frame sets the origin and row offsets. False when out of memory.
+bool trace_record(trace_t *t, const uint16_t rows[NUM_DRIVE_PINS],
+                  const uint32_t row_time[NUM_DRIVE_PINS]);
+
+bool trace_load(trace_t *t, const char *path);
+bool trace_save(const trace_t *t, const char *path);
+
+// Rebuild the trace a capture streamed into a MIDI log (TRACE_START replies,
+// skipped frames put back at their period). False if the log holds none.
+bool trace_from_capture(trace_t *t, const sim_midi_event_t *log, size_t count,
+                        trace_capture_stats_t *stats);
+
+// Index of the first frame of part that differs from whole, comparing part
+// with whole from the frame that has part's origin (SIZE_MAX: none differ)
+size_t trace_compare(const trace_t *part, const trace_t *whole);
+
+// Compare a MIDI log with a golden file; false if the file cannot be read
+bool golden_compare(const char *path, const sim_midi_event_t *log, size_t count,
+                    golden_result_t *out);
+
+#endif // TRACE_H
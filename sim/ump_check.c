@@ -0,0 +1,376 @@
+/*
+ * Universal MIDI Packet Check
+ *
+ * Compares UMP messages built by src/ump.c with hand-written words, checks
+ * the 16-bit velocity tables against the 7-bit ones, prints what a 61-key
+ * chord costs on the USB port in each format, and runs the protocol
+ * negotiation through midi_in / midi_out against the simulated USB-MIDI 2.0
+ * host (sim_ump_host_select()).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "tusb.h"
+#include "keyboard_config.h"
+#include "note_map.h"
+#include "velocity_curves.h"
+#include "latency_hist.h"
+#include "scan_engine.h"
+#include "sysex.h"
+#include "ump.h"
+#include "midi_out.h"
+#include "midi_in.h"
+#include "sim_hal.h"
+#include "sim_check.h"
+#include "ump_check.h"
+
+// Bytes a full-speed bulk transfer carries per USB frame (16 packets/words)
+#define FRAME_BYTES  (SIM_MIDI_TX_FIFO_PACKETS * 4)
+
+// USB frames run by service() before giving up on a reply
+#define MAX_FRAMES   64
+
+static bool check_words(const char *what, const uint32_t *words, const uint32_t *expected,
+                        uint32_t count) {
+    bool ok = memcmp(words, expected, count * sizeof(words[0])) == 0 &&
+              ump_message_words(words[0]) == count;
+    expect(ok, what);
+    if (!ok) {
+        printf("    expected");
+        for (uint32_t i = 0; i < count; i++) printf(" %08X", expected[i]);
+        printf("\n    got     ");
+        for (uint32_t i = 0; i < count; i++) printf(" %08X", words[i]);
+        printf("\n");
+    }
+    return ok;
+}
+
+static note_event_t note_on(uint8_t note, uint8_t velocity, uint16_t velocity16, uint16_t delta) {
+    note_event_t ev = {
+        .note = note,
+        .velocity = velocity,
+        .velocity16 = velocity16,
+        .sensor_delta = delta,
+        .flags = NOTE_EVENT_ON | (delta ? NOTE_EVENT_MEASURED : 0),
+    };
+    return ev;
+}
+
+static note_event_t note_off(uint8_t note) {
+    note_event_t ev = { .note = note };
+    return ev;
+}
+
+// ============================================================================
+// PACKETS
+// ============================================================================
+
+static bool check_packets(void) {
+    bool ok = true;
+    uint32_t w[UMP_MAX_WORDS];
+
+    w[0] = ump_midi1(0x90, C4, 100);
+    ok &= check_words("MT2 note on", w, (uint32_t[]){ 0x20903C64 }, 1);
+
+    note_event_t ev = note_on(C4, 100, 0xC8F0, 1234);
+    ump_note_event(&ev, UMP_PROTOCOL_MIDI2, true, w);
+    ok &= check_words("MT4 note on, 16-bit velocity, delta attribute", w,
+                      (uint32_t[]){ 0x40903C01, 0xC8F004D2 }, 2);
+    ump_note_event(&ev, UMP_PROTOCOL_MIDI2, false, w);
+    ok &= check_words("MT4 note on without attribute", w,
+                      (uint32_t[]){ 0x40903C00, 0xC8F00000 }, 2);
+
+    ev = note_on(C4, VELOCITY_DEFAULT, VELOCITY_DEFAULT << 9, 0);
+    ump_note_event(&ev, UMP_PROTOCOL_MIDI2, true, w);
+    ok &= check_words("MT4 default velocity: no attribute", w,
+                      (uint32_t[]){ 0x40903C00, (uint32_t)VELOCITY_DEFAULT << 25 }, 2);
+
+    ev = note_off(C4);
+    ump_note_event(&ev, UMP_PROTOCOL_MIDI2, true, w);
+    ok &= check_words("MT4 note off", w, (uint32_t[]){ 0x40803C00, 0x00000000 }, 2);
+
+    ev = note_on(130, 127, 0xFFFF, 0);
+    ump_note_event(&ev, UMP_PROTOCOL_MIDI2, true, w);
+    ok &= check_words("MT4 extended note on channel 1", w,
+                      (uint32_t[]){ 0x40910200, 0xFFFF0000 }, 2);
+    ump_note_event(&ev, UMP_PROTOCOL_MIDI1, true, w);
+    ok &= check_words("MT2 extended note on channel 1", w, (uint32_t[]){ 0x2091027F }, 1);
+
+    const uint8_t sysex[] = { 0x7D, 0x01, 0x02, 0x03, 0x04, 0x05 };
+    ump_sysex7(UMP_SYSEX_COMPLETE, sysex, 2, w);
+    ok &= check_words("MT3 complete, two bytes", w, (uint32_t[]){ 0x30027D01, 0x00000000 }, 2);
+    ump_sysex7(UMP_SYSEX_START, sysex, 6, w);
+    ok &= check_words("MT3 start, six bytes", w, (uint32_t[]){ 0x30167D01, 0x02030405 }, 2);
+
+    uint8_t status, bytes[UMP_SYSEX_BYTES];
+    uint32_t count = ump_sysex7_bytes(w, &status, bytes);
+    ok &= expect(count == 6 && status == UMP_SYSEX_START && memcmp(bytes, sysex, 6) == 0,
+                 "MT3 bytes read back");
+
+    ump_endpoint_info(UMP_PROTOCOL_MIDI1 | UMP_PROTOCOL_MIDI2, w);
+    ok &= check_words("endpoint info: UMP 1.1, MIDI 1.0 and 2.0", w,
+                      (uint32_t[]){ 0xF0010101, 0x00000300, 0, 0 }, 4);
+    ump_stream_config_notify(UMP_PROTOCOL_MIDI2, w);
+    ok &= check_words("stream configuration notify: MIDI 2.0", w,
+                      (uint32_t[]){ 0xF0060200, 0, 0, 0 }, 4);
+    return ok;
+}
+
+// ============================================================================
+// VELOCITY
+// ============================================================================
+
+// 16-bit velocity against the 7-bit table, every curve at 1 us resolution
+static bool check_velocity(void) {
+    bool exact = true, monotonic = true;
+    uint32_t end = VELOCITY_MIN_TIME_US + (VELOCITY_CURVE_STEPS << VELOCITY_CURVE_SHIFT);
+
+    printf("  distinct velocities over %u-%u us:", VELOCITY_MIN_TIME_US, end);
+    for (int c = 0; c < VELOCITY_CURVE_COUNT; c++) {
+        velocity_curve_t curve = (velocity_curve_t)c;
+        uint32_t distinct7 = 0, distinct16 = 0;
+        uint32_t last7 = UINT32_MAX, last16 = UINT32_MAX;
+
+        for (uint32_t delta = VELOCITY_MIN_TIME_US; delta <= end; delta++) {
+            uint32_t v7 = velocity_curve_lookup(curve, delta);
+            uint32_t v16 = velocity_curve_lookup16(curve, delta);
+
+            // Interpolated inside a step, never outside its 7-bit velocity
+            exact &= v16 >> 9 == v7;
+            monotonic &= v16 <= last16 || last16 == UINT32_MAX;
+
+            distinct7 += v7 != last7;
+            distinct16 += v16 != last16;
+            last7 = v7;
+            last16 = v16;
+        }
+        printf(" %s %u/%u", curve_names[c], distinct7, distinct16);
+    }
+    printf(" (7/16-bit)\n");
+
+    bool ok = expect(exact, "16-bit >> 9 is the 7-bit velocity at every delta");
+    ok &= expect(monotonic, "16-bit velocity never increases with delta");
+    return ok;
+}
+
+// ============================================================================
+// THROUGHPUT
+// ============================================================================
+
+// USB bytes of a 61-key chord pressed and released, one format
+static uint32_t chord_bytes(midi_out_protocol_t format) {
+    uint32_t words[UMP_MAX_WORDS];
+    uint32_t bytes = 0;
+
+    for (int on = 1; on >= 0; on--) {
+        for (uint8_t note = FIRST_KEY; note <= LAST_KEY; note++) {
+            note_event_t ev = on ? note_on(note, 100, 100 << 9, 1000) : note_off(note);
+            if (format == MIDI_OUT_USB_MIDI1) {
+                bytes += 4;     // One event packet
+            } else {
+                uint8_t protocol = format == MIDI_OUT_UMP_MIDI2 ? UMP_PROTOCOL_MIDI2 : UMP_PROTOCOL_MIDI1;
+                bytes += 4 * ump_note_event(&ev, protocol, true, words);
+            }
+        }
+    }
+    return bytes;
+}
+
+static void print_throughput(void) {
+    uint32_t events = 2 * (LAST_KEY - FIRST_KEY + 1);
+    uint32_t midi1 = chord_bytes(MIDI_OUT_USB_MIDI1);
+    uint32_t ump1 = chord_bytes(MIDI_OUT_UMP_MIDI1);
+    uint32_t ump2 = chord_bytes(MIDI_OUT_UMP_MIDI2);
+
+    printf("  61-key chord on+off (%u events): USB-MIDI 1.0 %u B / %u frames, "
+           "UMP MIDI 1.0 %u B / %u frames, UMP MIDI 2.0 %u B / %u frames\n",
+           events, midi1, (midi1 + FRAME_BYTES - 1) / FRAME_BYTES,
+           ump1, (ump1 + FRAME_BYTES - 1) / FRAME_BYTES,
+           ump2, (ump2 + FRAME_BYTES - 1) / FRAME_BYTES);
+}
+
+// ============================================================================
+// NEGOTIATION
+// ============================================================================
+
+// One pass of the core0 loop, then the host's transfer at the next frame
+static void service(void) {
+    midi_in_task();
+    midi_out_flush();
+    sim_advance_us(SIM_USB_FRAME_US);
+    tud_task();
+}
+
+// Run the loop until the backlog is sent
+static void service_all(void) {
+    for (int i = 0; i < MAX_FRAMES; i++) {
+        service();
+        if (midi_out_backlog() == 0 && !usb_midi_tx_busy()) return;
+    }
+}
+
+static const sim_ump_message_t *last_ump(void) {
+    size_t count;
+    const sim_ump_message_t *log = sim_ump_log(&count);
+    return count ? &log[count - 1] : NULL;
+}
+
+static const sim_midi_event_t *last_midi(void) {
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+    return count ? &log[count - 1] : NULL;
+}
+
+static bool ump_is(const sim_ump_message_t *m, const uint32_t *words, uint32_t count) {
+    return m && m->count == count && memcmp(m->words, words, count * sizeof(words[0])) == 0;
+}
+
+static bool midi_is(const sim_midi_event_t *ev, uint8_t b0, uint8_t b1, uint8_t b2) {
+    return ev && ev->len == 3 && ev->msg[0] == b0 && ev->msg[1] == b1 && ev->msg[2] == b2;
+}
+
+static void send_note(const note_event_t *ev) {
+    midi_out_note_event(ev);
+    service_all();
+}
+
+// Host sends F0 7D <command> F7 as one MT3 packet
+static void send_ump_sysex(uint8_t command) {
+    uint8_t data[2] = { SYSEX_MANUFACTURER_ID, command };
+    uint32_t words[2];
+    ump_sysex7(UMP_SYSEX_COMPLETE, data, 2, words);
+    sim_ump_host_send(words, 2);
+    service_all();
+}
+
+// Latency dump replies: MT3 packets in start / continue / end order, and the
+// same F0 ... F7 messages in the MIDI log as USB-MIDI 1.0 would carry
+static bool check_sysex_replies(size_t ump_before, size_t midi_before) {
+    size_t count;
+    const sim_ump_message_t *log = sim_ump_log(&count);
+    bool ok = count > ump_before;
+    bool open = false;
+    for (size_t i = ump_before; ok && i < count; i++) {
+        uint8_t status = (uint8_t)((log[i].words[0] >> 20) & 0x0F);
+        ok = ump_type(log[i].words[0]) == UMP_MT_DATA64 && log[i].count == 2;
+        ok = ok && ((status == UMP_SYSEX_START || status == UMP_SYSEX_COMPLETE) != open);
+        open = status == UMP_SYSEX_START || (open && status == UMP_SYSEX_CONTINUE);
+    }
+    ok = ok && !open;
+
+    const sim_midi_event_t *midi = sim_midi_log(&count);
+    uint32_t replies = 0, bytes = 0;
+    for (size_t i = midi_before; i < count; i++) {
+        for (uint8_t b = 0; b < midi[i].len; b++) {
+            if (midi[i].msg[b] == SYSEX_START) bytes = 0;
+            bytes++;
+            if (midi[i].msg[b] == SYSEX_END) replies += bytes > 4;
+        }
+    }
+    return ok && replies == LATENCY_STAGE_COUNT;
+}
+
+static bool check_negotiation(void) {
+    bool ok = true;
+    uint32_t w[UMP_MAX_WORDS];
+    size_t ump_count, midi_count;
+
+    sim_hal_reset();
+    midi_out_init();
+    latency_hist_clear();
+    note_event_t on = note_on(C4, 100, 0xC8F0, 1234);
+    note_event_t off = note_off(C4);
+
+    // Host that never selects UMP
+    service();
+    send_note(&on);
+    sim_ump_log(&ump_count);
+    ok &= expect(midi_out_protocol() == MIDI_OUT_USB_MIDI1 && ump_count == 0 &&
+                 midi_is(last_midi(), 0x90, C4, 100),
+                 "no UMP selected: USB-MIDI 1.0 packets");
+
+    // UMP selected, no Stream Configuration Request yet
+    sim_ump_host_select(true);
+    service();
+    send_note(&on);
+    ok &= expect(midi_out_protocol() == MIDI_OUT_UMP_MIDI1 &&
+                 ump_is(last_ump(), (uint32_t[]){ 0x20903C64 }, 1),
+                 "UMP selected: MIDI 1.0 protocol (MT2) until negotiated");
+
+    // Endpoint discovery
+    w[0] = (uint32_t)UMP_MT_STREAM << 28 | (uint32_t)UMP_STREAM_ENDPOINT_DISCOVERY << 16 | 0x0101;
+    w[1] = UMP_DISCOVERY_ENDPOINT_INFO;
+    w[2] = w[3] = 0;
+    sim_ump_host_send(w, 4);
+    service_all();
+    ump_endpoint_info(UMP_PROTOCOL_MIDI1 | UMP_PROTOCOL_MIDI2, w);
+    ok &= expect(ump_is(last_ump(), w, 4), "endpoint discovery: info offers MIDI 1.0 and 2.0");
+
+    // Host asks for MIDI 2.0
+    ump_stream_config_request(UMP_PROTOCOL_MIDI2, w);
+    sim_ump_host_send(w, 4);
+    service_all();
+    ump_stream_config_notify(UMP_PROTOCOL_MIDI2, w);
+    ok &= expect(midi_out_protocol() == MIDI_OUT_UMP_MIDI2 && ump_is(last_ump(), w, 4),
+                 "configuration request: MIDI 2.0, notified");
+
+    send_note(&on);
+    uint32_t expected[UMP_MAX_WORDS];
+    ump_note_event(&on, UMP_PROTOCOL_MIDI2, true, expected);
+#ifdef MIDI_UMP_DELTA_ATTR
+    ok &= expect(ump_is(last_ump(), expected, 2) && (expected[0] & 0xFF) == UMP_ATTR_MANUFACTURER,
+                 "MIDI 2.0 note on: MT4, 16-bit velocity and delta");
+#else
+    ok &= expect(ump_is(last_ump(), expected, 2), "MIDI 2.0 note on: MT4, 16-bit velocity");
+#endif
+    ok &= expect(midi_is(last_midi(), 0x90, C4, 0xC8F0 >> 9), "MIDI log: velocity16 >> 9");
+    send_note(&off);
+    ok &= expect(ump_is(last_ump(), (uint32_t[]){ 0x40803C00, 0 }, 2), "MIDI 2.0 note off: MT4");
+
+    // CC with a 32-bit value selects a curve like its 7-bit value
+    uint8_t curve = scan_engine_velocity_curve();
+    w[0] = (uint32_t)UMP_MT_MIDI2 << 28 | 0xB0u << 16 | VELOCITY_CURVE_CC << 8;
+    w[1] = (uint32_t)VELOCITY_CURVE_S << 25;
+    sim_ump_host_send(w, 2);
+    service();
+    ok &= expect(scan_engine_velocity_curve() == VELOCITY_CURVE_S, "MIDI 2.0 CC selects the velocity curve");
+    scan_engine_set_velocity_curve(curve);
+
+    // SysEx requests arrive and replies leave as MT3
+    send_ump_sysex(SYSEX_CMD_LATENCY_CLEAR);
+    uint8_t clear[2] = { SYSEX_MANUFACTURER_ID, SYSEX_CMD_LATENCY_CLEAR | SYSEX_RESPONSE };
+    ump_sysex7(UMP_SYSEX_COMPLETE, clear, 2, w);
+    ok &= expect(ump_is(last_ump(), w, 2), "SysEx request over MT3: MT3 reply");
+
+    sim_ump_log(&ump_count);
+    sim_midi_log(&midi_count);
+    send_ump_sysex(SYSEX_CMD_LATENCY_DUMP);
+    ok &= expect(check_sysex_replies(ump_count, midi_count), "multi-packet SysEx replies: MT3 start ... end");
+
+    // Host drops back to alternate setting 0
+    sim_ump_host_select(false);
+    service();
+    sim_ump_log(&ump_count);
+    send_note(&on);
+    size_t after;
+    sim_ump_log(&after);
+    ok &= expect(midi_out_protocol() == MIDI_OUT_USB_MIDI1 && after == ump_count &&
+                 midi_is(last_midi(), 0x90, C4, 100),
+                 "UMP deselected: back to USB-MIDI 1.0");
+    return ok;
+}
+
+bool ump_check_run(void) {
+    bool ok = true;
+
+    printf("== ump-check ==\n");
+    ok &= check_packets();
+    ok &= check_velocity();
+    print_throughput();
+#ifdef MIDI_UMP_ENABLED
+    ok &= check_negotiation();
+#else
+    printf("  negotiation: MIDI_UMP_ENABLED is off, host always gets USB-MIDI 1.0\n");
+#endif
+    return ok;
+}
@@ -0,0 +1,14 @@
+/*
+ * Universal MIDI Packet Check - see ump_check.c
+ */
+
+#ifndef UMP_CHECK_H
+#define UMP_CHECK_H
+
+#include <stdbool.h>
+
+// Runs the packet, velocity mapping and protocol negotiation checks; returns
+// true if all of them passed
+bool ump_check_run(void);
+
+#endif // UMP_CHECK_H
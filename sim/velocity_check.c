@@ -0,0 +1,169 @@
+/*
+ * Velocity Precision Check
+ *
+ * Feeds scan_engine_process_frame() presses with known first-to-second
+ * sensor deltas, at every phase against the frame, and compares the note-on
+ * velocity with the velocity of the true delta (linear curve).
+ *
+ * Each sensor is seen at the first sample of its row after it closes, so
+ * with per-row timestamps the measured delta is within one scan period P of
+ * the true delta: the velocity must lie between the curve at delta + P and
+ * at delta - P. The same presses are also run with every row stamped with
+ * the frame time (the old single timestamp), which adds the sample-time
+ * distance between the two sensors' rows as a bias.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "velocity_curves.h"
+#include "sensor_positions.h"
+#include "scan_engine.h"
+#include "pio_scanner.h"
+#include "sim_check.h"
+#include "velocity_check.h"
+
+#define PHASES          32          // Press start phases per scan period
+#define DELTA_STEP_US   250
+
+typedef struct {
+    const char *name;
+    uint32_t settle_us;
+    uint32_t period_us;     // Scan period: one sample per row per period
+} precision_config_t;
+
+typedef struct {
+    uint32_t presses;
+    uint32_t in_bound;
+    uint32_t missing;       // No note-on at all
+    int64_t error_sum;      // Measured minus ideal velocity
+    uint64_t abs_error_sum;
+    uint32_t max_error;
+} precision_stats_t;
+
+static uint8_t captured_velocity;
+static bool captured;
+
+static void capture_note_on(const note_event_t *ev) {
+    if ((ev->flags & NOTE_EVENT_ON) && !captured) {
+        captured_velocity = ev->velocity;
+        captured = true;
+    }
+}
+
+// Matrix position of one of a note's sensors
+static bool find_sensor(uint8_t note, uint8_t role, uint8_t *drive, uint8_t *read) {
+    for (uint8_t d = 0; d < NUM_DRIVE_PINS; d++) {
+        for (uint8_t r = 0; r < NUM_READ_PINS; r++) {
+            const sensor_position_t *pos = sensor_position(d, r);
+            if (pos->note == note && pos->role == role) {
+                *drive = d;
+                *read = r;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Press note: first sensor closes phase_us into the run, the second delta_us
+// later. Returns the note-on velocity, or 0 if none came.
+static uint8_t measure_press(uint8_t note, uint32_t phase_us, uint32_t delta_us,
+                             const uint32_t offset_us[NUM_DRIVE_PINS], uint32_t period_us,
+                             bool row_stamps) {
+    uint8_t d1, r1, d2, r2;
+    if (!find_sensor(note, SENSOR_FIRST, &d1, &r1) || !find_sensor(note, SENSOR_SECOND, &d2, &r2)) {
+        return 0;
+    }
+
+    scan_engine_init(capture_note_on);
+    scan_engine_set_velocity_curve(VELOCITY_CURVE_LINEAR);
+    captured = false;
+
+    uint32_t first_us = START_US + phase_us;
+    uint32_t second_us = first_us + delta_us;
+    uint32_t end_us = second_us + (DEBOUNCE_SAMPLES + 2) * period_us;
+
+    for (uint32_t start = START_US; start < end_us && !captured; start += period_us) {
+        uint16_t rows[NUM_DRIVE_PINS] = { 0 };
+        uint32_t row_time[NUM_DRIVE_PINS];
+        for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+            uint32_t sample = start + offset_us[drive];
+            if (drive == d1 && sample >= first_us) rows[drive] |= (uint16_t)(1u << r1);
+            if (drive == d2 && sample >= second_us) rows[drive] |= (uint16_t)(1u << r2);
+            row_time[drive] = row_stamps ? sample : start + offset_us[NUM_DRIVE_PINS - 1];
+        }
+        scan_engine_process_frame(rows, row_time);
+    }
+    return captured ? captured_velocity : 0;
+}
+
+static void run_config(const precision_config_t *cfg, bool row_stamps, precision_stats_t *st) {
+    uint32_t descriptors[NUM_DRIVE_PINS];
+    uint32_t offset_us[NUM_DRIVE_PINS];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        descriptors[drive] = pio_scan_descriptor(drive, cfg->settle_us);
+    }
+    pio_scan_sample_offsets(descriptors, offset_us);
+
+    uint32_t period = cfg->period_us;
+    uint32_t trial = 0;
+    for (uint32_t delta = DELTA_STEP_US; delta <= VELOCITY_MAX_TIME_US + period; delta += DELTA_STEP_US) {
+        for (uint32_t phase = 0; phase < PHASES; phase++, trial++) {
+            uint8_t note = (uint8_t)(FIRST_KEY + trial % NUM_KEYS);
+            uint8_t v = measure_press(note, phase * period / PHASES, delta, offset_us, period, row_stamps);
+
+            st->presses++;
+            if (v == 0) {
+                st->missing++;
+                continue;
+            }
+
+            uint8_t ideal = velocity_curve_lookup(VELOCITY_CURVE_LINEAR, delta);
+            uint8_t slowest = velocity_curve_lookup(VELOCITY_CURVE_LINEAR, delta + period);
+            uint8_t fastest = velocity_curve_lookup(VELOCITY_CURVE_LINEAR, delta > period ? delta - period : 0);
+            if (v >= slowest && v <= fastest) st->in_bound++;
+
+            int error = (int)v - ideal;
+            st->error_sum += error;
+            st->abs_error_sum += (uint64_t)abs(error);
+            if ((uint32_t)abs(error) > st->max_error) st->max_error = (uint32_t)abs(error);
+        }
+    }
+}
+
+static void print_stats(const char *stamps, const precision_stats_t *st) {
+    double n = st->presses ? st->presses : 1;
+    printf("    %-12s %6u presses, %6u within bound, %u missing, velocity error "
+           "mean %+.2f mean abs %.2f max %u\n",
+           stamps, st->presses, st->in_bound, st->missing,
+           st->error_sum / n, st->abs_error_sum / n, st->max_error);
+}
+
+bool velocity_check_run(void) {
+    // The firmware's scan timing, and the same with a short settle time
+    const precision_config_t configs[] = {
+        { "firmware", SCAN_SETTLE_US, SCAN_PERIOD_US },
+        { "settle 20 us", 20, 300 },
+    };
+    bool ok = true;
+
+    printf("== velocity-check ==\n");
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+        const precision_config_t *cfg = &configs[c];
+        precision_stats_t rows = { 0 }, frame = { 0 };
+        run_config(cfg, true, &rows);
+        run_config(cfg, false, &frame);
+
+        printf("  %s: settle %u us, scan period %u us, bound +-%u us of delta\n",
+               cfg->name, cfg->settle_us, cfg->period_us, cfg->period_us);
+        print_stats("row stamps", &rows);
+        print_stats("frame stamp", &frame);
+
+        bool pass = rows.missing == 0 && rows.in_bound == rows.presses;
+        printf("  %-52s %s\n", "per-row timestamps keep every press within bound", pass ? "ok" : "FAIL");
+        ok &= pass;
+    }
+    return ok;
+}
@@ -0,0 +1,14 @@
+/*
+ * Velocity Precision Check - see velocity_check.c
+ */
+
+#ifndef VELOCITY_CHECK_H
+#define VELOCITY_CHECK_H
+
+#include <stdbool.h>
+
+// Runs the sweep and prints error statistics; returns true if every press
+// with per-row timestamps stayed within the error bound
+bool velocity_check_run(void);
+
+#endif // VELOCITY_CHECK_H
@@ -0,0 +1,476 @@
+/*
+ * Idle Wake Check
+ *
+ * Runs the scan scheduler, the PIO scanner model and idle_wake.c together,
+ * as scanner_step() in src/keyboard.c does, on scripted timelines: the
+ * scanner must park after IDLE_WAKE_FRAMES quiet scans with every drive pin
+ * high and no scans, stay awake while any sensor is closed, and wake at the
+ * first rising read pin - including a sensor that closes in the very frame
+ * that parks, and a glitch that is gone by the first scan. A trace capture
+ * started while parked must resume scanning, hold off parking until the
+ * frame tap has closed the trace, and get its stop answered.
+ *
+ * Presses that wake the scanner are checked for the same velocity bound as
+ * velocity-check (linear curve at delta +- P), and their first sensor
+ * detection and Note On latency are compared with the same presses played
+ * with parking disabled, i.e. found by scanning at SCAN_IDLE_PERIOD_US.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "velocity_curves.h"
+#include "sensor_positions.h"
+#include "scan_engine.h"
+#include "scan_scheduler.h"
+#include "pio_scanner.h"
+#include "settle_profile.h"
+#include "idle_wake.h"
+#include "midi_out.h"
+#include "trace_capture.h"
+#include "tusb.h"
+#include "sim_hal.h"
+#include "trace.h"
+#include "pio_model.h"
+#include "timeline.h"
+#include "sim_check.h"
+#include "wake_check.h"
+
+#ifdef IDLE_WAKE
+
+#define MAX_EVENTS      64
+#define MAX_PARKS       16
+#define MAX_PRESSES     8
+
+#define DRIVE_MASK      (((1u << NUM_DRIVE_PINS) - 1) << DRIVE0)
+
+// Scans an edge needs before the engine acts on it
+#if DEBOUNCE_ENGINE == DEBOUNCE_VERTICAL
+#define ACCEPT_SCANS    DEBOUNCE_SAMPLES
+#else
+#define ACCEPT_SCANS    1
+#endif
+
+// Quiet time the scanner needs to park, with room to spare
+#define PARK_US         ((IDLE_WAKE_FRAMES + 2) * SCAN_IDLE_PERIOD_US)
+
+// Core0 pass while a trace capture runs, as in sim_main.c
+#define CORE0_PERIOD_US 100
+
+typedef struct {
+    uint8_t note;
+    bool on;
+    uint8_t velocity;
+    uint64_t at_us;         // Simulated time the engine handed it over
+} captured_t;
+
+// A press whose first sensor detection and Note On are timed
+typedef struct {
+    uint8_t note;
+    uint64_t first_us;      // First sensor closes
+    uint32_t delta_us;      // Second sensor closes this much later
+    uint8_t drive, read;    // First sensor position
+    uint64_t seen_us;       // First frame row to sample it closed (0: not yet)
+} press_t;
+
+typedef struct {
+    bool parking;               // false: idle_wake_frame_done() never called
+    uint64_t scans;
+    uint32_t scans_parked;      // Scans started while parked (must be 0)
+    uint32_t rows_low;          // Polls while parked with a drive pin low
+    uint32_t wrong_function;    // Drive pin functions wrong parked / after a wake
+    uint64_t park_at[MAX_PARKS];
+    uint32_t park_count;
+    idle_wake_stats_t wake;
+    press_t presses[MAX_PRESSES];
+    uint32_t press_count;
+    uint32_t race_frame;        // Frame the tap closes race_note in (0: none)
+    uint8_t race_note;
+    uint64_t capture_start_us;  // TRACE_START / TRACE_STOP times (0: no capture)
+    uint64_t capture_stop_us;
+} wake_run_t;
+
+static captured_t events[MAX_EVENTS];
+static uint32_t event_count;
+
+static wake_run_t *current;
+static uint32_t frames;
+static volatile bool scan_requested;
+static bool scan_running;
+
+static void capture_event(const note_event_t *ev) {
+    if (event_count < MAX_EVENTS) {
+        events[event_count++] = (captured_t){
+            .note = ev->note,
+            .on = (ev->flags & NOTE_EVENT_ON) != 0,
+            .velocity = ev->velocity,
+            .at_us = sim_now_us(),
+        };
+    }
+}
+
+// Matrix position of one of a note's sensors
+static bool find_sensor(uint8_t note, uint8_t role, uint8_t *drive, uint8_t *read) {
+    for (uint8_t d = 0; d < NUM_DRIVE_PINS; d++) {
+        for (uint8_t r = 0; r < NUM_READ_PINS; r++) {
+            const sensor_position_t *pos = sensor_position(d, r);
+            if (pos->note == note && pos->role == role) {
+                *drive = d;
+                *read = r;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// As pio_scanner_start_frame()
+static bool request_frame(void) {
+    if (scan_requested || scan_running) return false;
+    scan_requested = true;
+    return true;
+}
+
+// As pio_scanner_busy()
+static bool frame_pending(void) {
+    return scan_requested || scan_running;
+}
+
+// Times first sensor detections; closes the race note's sensors in its frame
+static void wake_tap(const uint16_t rows[NUM_DRIVE_PINS], const uint32_t row_time[NUM_DRIVE_PINS]) {
+    frames++;
+#ifdef TRACE_CAPTURE
+    trace_capture_frame(rows, row_time);
+#endif
+    for (uint32_t i = 0; i < current->press_count; i++) {
+        press_t *p = &current->presses[i];
+        uint32_t now = time_us_32();
+        if (!p->seen_us && (rows[p->drive] & (1u << p->read))) {
+            p->seen_us = sim_now_us() - (uint32_t)(now - row_time[p->drive]);
+        }
+    }
+
+    if (frames == current->race_frame) {
+        uint8_t drive, read;
+        if (find_sensor(current->race_note, SENSOR_FIRST, &drive, &read)) sim_set_position(drive, read, true);
+        if (find_sensor(current->race_note, SENSOR_SECOND, &drive, &read)) sim_set_position(drive, read, true);
+    }
+}
+
+// Scan until end_us: wait for a tick or a read pin IRQ, run a PIO frame,
+// hand it to the engine, then the scheduler and idle wake
+static void run(timeline_t *tl, uint64_t end_us, wake_run_t *r) {
+    uint32_t descriptors[NUM_DRIVE_PINS];
+    uint32_t offset_us[NUM_DRIVE_PINS];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        descriptors[drive] = pio_scan_descriptor(drive, settle_profile_us[drive]);
+    }
+    pio_scan_sample_offsets(descriptors, offset_us);
+
+    sim_hal_reset();
+    timeline_finalize(tl);
+    sim_hal_set_input_hook(timeline_apply, tl);
+    scan_engine_init(capture_event);
+    scan_engine_set_velocity_curve(VELOCITY_CURVE_LINEAR);
+    scan_engine_set_frame_tap(wake_tap);
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        gpio_set_function(DRIVE0 + drive, GPIO_FUNC_PIO0);
+    }
+    event_count = 0;
+    current = r;
+    frames = 0;
+    scan_requested = false;
+    scan_running = false;
+
+    scan_scheduler_init(request_frame);
+    idle_wake_init(frame_pending);
+
+    bool check_functions = false;
+    while (sim_now_us() < end_us) {
+        sim_advance_us(1);
+        sim_hal_gpio_irq_poll();
+#ifdef TRACE_CAPTURE
+        // Core0's side of a capture: the SysEx commands, then sending the
+        // records and the stop reply every CORE0_PERIOD_US
+        if (r->capture_start_us && sim_now_us() == r->capture_start_us) trace_capture_start();
+        if (r->capture_stop_us && sim_now_us() == r->capture_stop_us) trace_capture_stop();
+        if (r->capture_start_us && sim_now_us() % CORE0_PERIOD_US == 0) {
+            tud_task();
+            trace_capture_task();
+            midi_out_flush();
+        }
+        if (trace_capture_active()) idle_wake_resume();
+#endif
+        if (idle_wake_poll()) check_functions = true;
+
+        if (idle_wake_state() == IDLE_WAKE_PARKED) {
+            if ((gpio_get_all() & DRIVE_MASK) != DRIVE_MASK) r->rows_low++;
+            if (scan_requested) r->scans_parked++;
+        }
+        if (!scan_requested) continue;
+
+        if (check_functions) {
+            for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+                if (gpio_get_function(DRIVE0 + drive) != GPIO_FUNC_PIO0) r->wrong_function++;
+            }
+            check_functions = false;
+        }
+
+        uint32_t raw[NUM_DRIVE_PINS];
+        uint64_t sample_us[NUM_DRIVE_PINS];
+        uint32_t start = time_us_32();
+        scan_requested = false;
+        scan_running = true;
+        pio_model_run_frame(descriptors, raw, sample_us);
+        scan_running = false;
+
+        uint16_t rows[NUM_DRIVE_PINS];
+        uint32_t row_time[NUM_DRIVE_PINS];
+        for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+            rows[drive] = pio_scan_sample_to_row(raw[drive]);
+            row_time[drive] = start + offset_us[drive];
+        }
+        scan_engine_process_frame(rows, row_time);
+        r->scans++;
+
+        scan_scheduler_frame_done(scan_engine_keys_moving());
+        bool busy = scan_engine_keys_moving() || scan_engine_any_closed();
+#ifdef TRACE_CAPTURE
+        busy |= trace_capture_active();
+#endif
+        if (r->parking && idle_wake_frame_done(busy)) {
+            if (r->park_count < MAX_PARKS) r->park_at[r->park_count] = sim_now_us();
+            r->park_count++;
+            for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+                if (gpio_get_function(DRIVE0 + drive) != GPIO_FUNC_SIO) r->wrong_function++;
+            }
+        }
+    }
+    idle_wake_get_stats(&r->wake);
+    scan_engine_set_frame_tap(NULL);
+}
+
+static void run_init(wake_run_t *r, bool parking) {
+    memset(r, 0, sizeof(*r));
+    r->parking = parking;
+}
+
+// A timed press of note: first sensor at first_us, second delta_us later,
+// released hold_us after the first sensor
+static void add_press(timeline_t *tl, wake_run_t *r, uint8_t note, uint64_t first_us,
+                      uint32_t delta_us, uint32_t hold_us) {
+    press_t *p = &r->presses[r->press_count++];
+    p->note = note;
+    p->first_us = first_us;
+    p->delta_us = delta_us;
+    find_sensor(note, SENSOR_FIRST, &p->drive, &p->read);
+    timeline_press(tl, first_us, note, delta_us);
+    timeline_release(tl, first_us + hold_us, note, 5000);
+}
+
+static bool parked_between(const wake_run_t *r, uint64_t from_us, uint64_t to_us) {
+    for (uint32_t i = 0; i < r->park_count && i < MAX_PARKS; i++) {
+        if (r->park_at[i] >= from_us && r->park_at[i] < to_us) return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// CASES
+// ============================================================================
+
+static timeline_t tl;
+
+// Notes across the range and deltas from fortissimo to soft
+static const uint8_t wake_notes[] = { C2, F3, C4, G5, C7 };
+static const uint32_t wake_deltas[] = { 2000, 5000, 12000, 30000, 60000 };
+#define NUM_WAKE_PRESSES  (sizeof(wake_notes) / sizeof(wake_notes[0]))
+
+typedef struct {
+    uint32_t velocity_failures;
+    uint32_t missing;           // Presses without exactly one Note On and Note Off
+    uint64_t max_seen_us;       // First sensor edge to the first sample that saw it
+    uint64_t max_on_us;         // Second sensor edge to Note On
+    double mean_on_us;
+} press_result_t;
+
+// One press per second after the scanner had time to park before each
+static void wake_presses(wake_run_t *r, bool parking, press_result_t *out) {
+    timeline_init(&tl);
+    run_init(r, parking);
+    uint64_t t = PARK_US;
+    for (uint32_t i = 0; i < NUM_WAKE_PRESSES; i++) {
+        add_press(&tl, r, wake_notes[i], t + i * 37, wake_deltas[i], 150000);
+        t += PARK_US + 150000;
+    }
+    run(&tl, t, r);
+
+    memset(out, 0, sizeof(*out));
+    double on_sum = 0;
+    for (uint32_t i = 0; i < r->press_count; i++) {
+        const press_t *p = &r->presses[i];
+        uint32_t on = 0, off = 0;
+        for (uint32_t e = 0; e < event_count; e++) {
+            const captured_t *ev = &events[e];
+            if (ev->note != p->note) continue;
+            if (!ev->on) {
+                off++;
+                continue;
+            }
+            on++;
+            uint64_t latency = ev->at_us - (p->first_us + p->delta_us);
+            if (latency > out->max_on_us) out->max_on_us = latency;
+            on_sum += (double)latency;
+
+            uint8_t slowest = velocity_curve_lookup(VELOCITY_CURVE_LINEAR, p->delta_us + SCAN_PERIOD_US);
+            uint8_t fastest = velocity_curve_lookup(VELOCITY_CURVE_LINEAR,
+                                                    p->delta_us > SCAN_PERIOD_US ? p->delta_us - SCAN_PERIOD_US : 0);
+            if (ev->velocity < slowest || ev->velocity > fastest) out->velocity_failures++;
+        }
+        if (on != 1 || off != 1 || !p->seen_us) {
+            out->missing++;
+        } else if (p->seen_us - p->first_us > out->max_seen_us) {
+            out->max_seen_us = p->seen_us - p->first_us;
+        }
+    }
+    out->mean_on_us = r->press_count ? on_sum / r->press_count : 0;
+}
+
+bool wake_check_run(void) {
+    static wake_run_t r;
+    bool ok = true;
+    char what[96];
+
+    // Frame length: the PIO model's last sample of a frame
+    uint32_t descriptors[NUM_DRIVE_PINS];
+    uint32_t offset_us[NUM_DRIVE_PINS];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        descriptors[drive] = pio_scan_descriptor(drive, settle_profile_us[drive]);
+    }
+    pio_scan_sample_offsets(descriptors, offset_us);
+    uint32_t frame_us = offset_us[NUM_DRIVE_PINS - 1] + 1;
+
+    printf("== wake-check ==\n");
+    printf("  park after %u quiet scans, scan period %u us (idle %u us), frame %u us\n",
+           IDLE_WAKE_FRAMES, SCAN_PERIOD_US, SCAN_IDLE_PERIOD_US, frame_us);
+
+    // Nothing played: park once, then no scans at all
+    timeline_init(&tl);
+    run_init(&r, true);
+    run(&tl, 2 * PARK_US, &r);
+    snprintf(what, sizeof(what), "quiet matrix parks after %u scans", IDLE_WAKE_FRAMES);
+    ok &= expect(r.park_count == 1 && r.scans == IDLE_WAKE_FRAMES && r.wake.wakes == 0, what);
+    ok &= expect(r.scans_parked == 0, "no scans while parked");
+    ok &= expect(r.rows_low == 0 && r.wrong_function == 0, "all drive pins SIO outputs, high while parked");
+
+    // Presses that each wake the scanner, against the same presses found by
+    // scanning at the idle rate
+    press_result_t woken, idle;
+    wake_presses(&r, true, &woken);
+    uint32_t wakes = r.wake.wakes;
+    uint32_t max_wake_us = r.wake.max_wake_us;
+    bool functions_ok = r.wrong_function == 0 && r.rows_low == 0 && r.scans_parked == 0;
+    wake_presses(&r, false, &idle);
+
+    snprintf(what, sizeof(what), "%u presses each wake the scanner, one note each",
+             (unsigned)NUM_WAKE_PRESSES);
+    ok &= expect(wakes == NUM_WAKE_PRESSES && woken.missing == 0, what);
+    ok &= expect(functions_ok, "drive pins back to the PIO after every wake");
+    snprintf(what, sizeof(what), "read pin IRQ to scan start max %u us", max_wake_us);
+    ok &= expect(max_wake_us <= 1, what);
+    snprintf(what, sizeof(what), "first sensor seen max %llu us after its edge (<= frame)",
+             (unsigned long long)woken.max_seen_us);
+    ok &= expect(woken.max_seen_us <= frame_us, what);
+    ok &= expect(woken.velocity_failures == 0, "velocities within +-P of the delta");
+    snprintf(what, sizeof(what), "Note On max %llu us after the second sensor (<= %uP + frame)",
+             (unsigned long long)woken.max_on_us, ACCEPT_SCANS);
+    ok &= expect(woken.max_on_us <= ACCEPT_SCANS * SCAN_PERIOD_US + frame_us, what);
+    printf("  first note after a park: sensor seen max %llu us, Note On mean %.0f max %llu us\n",
+           (unsigned long long)woken.max_seen_us, woken.mean_on_us, (unsigned long long)woken.max_on_us);
+    printf("  same presses scanned at the idle rate: seen max %llu us, Note On mean %.0f max %llu us, "
+           "%u velocities off\n", (unsigned long long)idle.max_seen_us, idle.mean_on_us,
+           (unsigned long long)idle.max_on_us, idle.velocity_failures);
+
+    // A held key keeps its column high: never park under it
+    timeline_init(&tl);
+    run_init(&r, true);
+    add_press(&tl, &r, C4, PARK_US, 5000, 2 * PARK_US);
+    run(&tl, 4 * PARK_US, &r);
+    ok &= expect(!parked_between(&r, PARK_US, 3 * PARK_US + 5000) && r.park_count == 2,
+                 "no park while a key is held, parks after its release");
+
+    // Early Note Off leaves the key resting on its first sensor, silent
+    timeline_init(&tl);
+    run_init(&r, true);
+    bool was_early = scan_engine_early_note_off();
+    uint8_t drive = 0, read = 0;
+    find_sensor(C4, SENSOR_SECOND, &drive, &read);
+    timeline_press(&tl, PARK_US, C4, 5000);
+    timeline_set(&tl, PARK_US + 100000, drive, read, false);
+    timeline_release(&tl, 3 * PARK_US, C4, 0);
+    scan_engine_set_early_note_off(true);
+    run(&tl, 4 * PARK_US, &r);
+    scan_engine_set_early_note_off(was_early);
+    ok &= expect(event_count == 2 && !events[1].on && events[1].at_us < PARK_US + 100000 + (ACCEPT_SCANS + 1) * SCAN_PERIOD_US &&
+                 !parked_between(&r, PARK_US, 3 * PARK_US) && r.park_count == 2,
+                 "no park on a half-up key after an early Note Off");
+
+    // A key closes after the parking frame's rows were sampled: the rows
+    // going high must raise the edge
+    timeline_init(&tl);
+    run_init(&r, true);
+    r.race_frame = IDLE_WAKE_FRAMES;
+    r.race_note = C4;
+    run(&tl, 2 * PARK_US, &r);
+    ok &= expect(r.park_count == 1 && r.wake.wakes == 1 && r.wake.parked_us <= 1 &&
+                 event_count == 1 && events[0].on && events[0].note == C4,
+                 "sensor closing in the parking frame wakes at once");
+
+    // A 1 us glitch: wakes, finds nothing, parks again
+    timeline_init(&tl);
+    run_init(&r, true);
+    find_sensor(C4, SENSOR_FIRST, &drive, &read);
+    timeline_set(&tl, PARK_US, drive, read, true);
+    timeline_set(&tl, PARK_US + 1, drive, read, false);
+    run(&tl, 3 * PARK_US, &r);
+    ok &= expect(r.wake.wakes == 1 && r.park_count == 2 && event_count == 0,
+                 "glitch wakes the scanner, no notes, parks again");
+
+#ifdef TRACE_CAPTURE
+    // A capture started while parked: scanning resumes for it, the scanner
+    // stays up until the stop is answered, then parks again
+    timeline_init(&tl);
+    run_init(&r, true);
+    r.capture_start_us = PARK_US;
+    r.capture_stop_us = 3 * PARK_US;
+    midi_out_init();
+    run(&tl, 5 * PARK_US, &r);
+
+    size_t count;
+    const sim_midi_event_t *log = sim_midi_log(&count);
+    trace_t captured;
+    trace_capture_stats_t stats;
+    trace_init(&captured);
+    bool stopped = trace_from_capture(&captured, log, count, &stats) && stats.stopped;
+    ok &= expect(r.wake.wakes == 1 && !parked_between(&r, PARK_US, 3 * PARK_US) && r.park_count == 2,
+                 "trace capture resumes a parked scanner, parks after the stop");
+    snprintf(what, sizeof(what), "capture stop answered, %zu frames, none dropped", captured.count);
+    ok &= expect(stopped && stats.dropped == 0 && captured.count == stats.frames &&
+                 captured.count >= 2 * PARK_US / SCAN_IDLE_PERIOD_US, what);
+    trace_free(&captured);
+#endif
+
+    return ok;
+}
+
+#else
+
+bool wake_check_run(void) {
+    printf("== wake-check ==\n  not built (IDLE_WAKE)\n");
+    return true;
+}
+
+#endif // IDLE_WAKE
@@ -0,0 +1,14 @@
+/*
+ * Idle Wake Check - see wake_check.c
+ */
+
+#ifndef WAKE_CHECK_H
+#define WAKE_CHECK_H
+
+#include <stdbool.h>
+
+// Runs the parking, wake-up and first-note latency cases; returns true if
+// all of them passed
+bool wake_check_run(void);
+
+#endif // WAKE_CHECK_H
@@ -0,0 +1,29 @@
+/*
+ * Health Counters - see health.h
+ */
+
+#include "pico/stdlib.h"
+#include "midi_out.h"
+#include "scan_engine.h"
+#include "scan_scheduler.h"
+#include "health.h"
+
+void health_read(uint32_t out[HEALTH_COUNTER_COUNT]) {
+    scan_engine_stats_t engine;
+    scan_scheduler_stats_t sched;
+    midi_out_stats_t midi;
+    scan_engine_get_stats(&engine);
+    scan_scheduler_get_stats(&sched);
+    midi_out_get_stats(&midi);
+
+    out[HEALTH_UPTIME_MS] = (uint32_t)(time_us_64() / 1000);
+    out[HEALTH_SCAN_RATE_HZ] = scan_scheduler_rate_hz();
+    out[HEALTH_SCANS] = engine.frames;
+    out[HEALTH_SCAN_OVERRUNS] = sched.overruns;
+    out[HEALTH_DEBOUNCE_REJECTS] = engine.debounce_rejects;
+    out[HEALTH_VELOCITY_TIMEOUTS] = engine.velocity_timeouts;
+    out[HEALTH_SECOND_WITHOUT_FIRST] = engine.second_without_first;
+    out[HEALTH_MAX_FRAME_EVENTS] = engine.max_frame_events;
+    out[HEALTH_USB_FIFO_FULL] = midi.fifo_full;
+    out[HEALTH_USB_DROPPED] = midi.dropped;
+}
@@ -0,0 +1,161 @@
+/*
+ * Idle Wake - see idle_wake.h
+ */
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "keyboard_config.h"
+#include "note_map.h"
+#include "scan_scheduler.h"
+#include "idle_wake.h"
+
+static idle_wake_pending_t pending;
+static volatile idle_wake_state_t state;
+static uint32_t quiet_frames;
+static bool paused;                 // Alarm stopped, waiting out a pending scan
+
+static volatile uint32_t wake_time; // Read pin IRQ, time_us_32
+static uint32_t park_time;
+
+// Drive pin functions while scanning (PIO with SCAN_USE_PIO), put back on wake
+static gpio_function_t drive_function[NUM_DRIVE_PINS];
+
+static idle_wake_stats_t stats;
+
+static void set_read_irqs(bool enabled) {
+    for (unsigned int pin = 0; pin < 32; pin++) {
+        if (READ_PIN_MASK & (1u << pin)) {
+            gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, enabled);
+        }
+    }
+}
+
+// GPIO bank IRQ: a column rose with every row driven
+static void read_pin_irq(unsigned int gpio, uint32_t events) {
+    (void)gpio;
+    (void)events;
+    if (state != IDLE_WAKE_PARKED) return;
+
+    set_read_irqs(false);
+    wake_time = time_us_32();
+    state = IDLE_WAKE_WOKEN;
+
+    // Wake the scanning core from __wfe()
+    __sev();
+}
+
+// Stop scanning and drive every row: any closing sensor now raises a column
+static void park(void) {
+    park_time = time_us_32();
+    state = IDLE_WAKE_PARKED;
+    stats.parks++;
+
+    // Edges are latched from here on, so a row going high onto a switch
+    // closed since the last frame is caught too
+    set_read_irqs(true);
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        drive_function[drive] = gpio_get_function(DRIVE0 + drive);
+        gpio_set_function(DRIVE0 + drive, GPIO_FUNC_SIO);
+        gpio_set_dir(DRIVE0 + drive, GPIO_OUT);
+        gpio_put(DRIVE0 + drive, 1);
+    }
+
+    // A column already high raises no edge: wake straight away
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (state == IDLE_WAKE_PARKED && (gpio_get_all() & READ_PIN_MASK)) {
+        set_read_irqs(false);
+        wake_time = time_us_32();
+        state = IDLE_WAKE_WOKEN;
+    }
+    restore_interrupts(irq_state);
+}
+
+void idle_wake_init(idle_wake_pending_t scan_pending) {
+    pending = scan_pending;
+    state = IDLE_WAKE_SCANNING;
+    quiet_frames = 0;
+    paused = false;
+    memset(&stats, 0, sizeof(stats));
+
+    gpio_set_irq_callback(read_pin_irq);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+bool idle_wake_frame_done(bool busy) {
+    if (state != IDLE_WAKE_SCANNING) return false;
+
+    if (busy) {
+        quiet_frames = 0;
+        if (paused) {
+            // The scan that held up parking found a key
+            paused = false;
+            scan_scheduler_resume();
+        }
+        return false;
+    }
+
+    if (++quiet_frames < IDLE_WAKE_FRAMES) return false;
+
+    // No more ticks; a scan already started is processed first, then the
+    // next call parks
+    scan_scheduler_pause();
+    if (pending()) {
+        paused = true;
+        return false;
+    }
+
+    paused = false;
+    park();
+    return true;
+}
+
+bool idle_wake_poll(void) {
+    if (state != IDLE_WAKE_WOKEN) return false;
+
+    // Rows low before handing them back, so the first scan sees one at a time
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        gpio_put(DRIVE0 + drive, 0);
+        gpio_set_function(DRIVE0 + drive, drive_function[drive]);
+    }
+
+    state = IDLE_WAKE_SCANNING;
+    quiet_frames = 0;
+
+    uint32_t now = time_us_32();
+    uint32_t latency = now - wake_time;
+    stats.wakes++;
+    stats.last_wake_us = latency;
+    if (latency > stats.max_wake_us) stats.max_wake_us = latency;
+    stats.parked_us += now - park_time;
+
+    scan_scheduler_resume();
+    return true;
+}
+
+void idle_wake_resume(void) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (state == IDLE_WAKE_PARKED) {
+        set_read_irqs(false);
+        wake_time = time_us_32();
+        state = IDLE_WAKE_WOKEN;
+    }
+    restore_interrupts(irq_state);
+}
+
+bool idle_wake_parked(void) {
+    return state != IDLE_WAKE_SCANNING;
+}
+
+idle_wake_state_t idle_wake_state(void) {
+    return state;
+}
+
+void idle_wake_get_stats(idle_wake_stats_t *out) {
+    memcpy(out, &stats, sizeof(*out));
+    if (state != IDLE_WAKE_SCANNING) {
+        out->parked_us += time_us_32() - park_time;     // Park still running
+    }
+}
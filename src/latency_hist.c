@@ -0,0 +1,23 @@
+/*
+ * Latency Histograms - see latency_hist.h
+ */
+
+#include <string.h>
+#include "latency_hist.h"
+
+static uint32_t counts[LATENCY_STAGE_COUNT][LATENCY_HIST_BUCKETS];
+
+void latency_hist_clear(void) {
+    memset(counts, 0, sizeof(counts));
+}
+
+void latency_hist_add(latency_stage_t stage, uint32_t us) {
+    if (stage >= LATENCY_STAGE_COUNT) return;
+
+    uint32_t *count = &counts[stage][latency_hist_bucket(us)];
+    if (*count != UINT32_MAX) (*count)++;
+}
+
+const uint32_t *latency_hist_counts(latency_stage_t stage) {
+    return counts[stage];
+}
@@ -0,0 +1,186 @@
+/*
+ * MIDI Input - see midi_in.h
+ */
+
+#include <string.h>
+#include "tusb.h"
+#include "keyboard_config.h"
+#include "scan_engine.h"
+#include "sysex.h"
+#ifdef MIDI_UMP_ENABLED
+#include "ump.h"
+#endif
+#include "midi_out.h"
+#include "midi_in.h"
+
+// USB-MIDI Code Index Number (low nibble of packet byte 0)
+#define CIN_SYSEX_START     0x04    // SysEx start or continue, 3 bytes
+#define CIN_SYSEX_END_1     0x05    // SysEx end with 1 byte
+#define CIN_SYSEX_END_2     0x06    // SysEx end with 2 bytes
+#define CIN_SYSEX_END_3     0x07    // SysEx end with 3 bytes
+#define CIN_CONTROL_CHANGE  0x0B
+
+// Channel Mode controllers
+#define CC_ALL_SOUND_OFF    120
+#define CC_ALL_NOTES_OFF    123
+
+// SysEx message being assembled from packets; overflow discards it
+static uint8_t sysex_buf[SYSEX_MAX_REQUEST];
+static uint32_t sysex_len;
+static bool sysex_overflow;
+
+// Handle one Control Change message
+static void handle_control_change(uint8_t controller, uint8_t value) {
+    if (controller == VELOCITY_CURVE_CC) {
+        scan_engine_set_velocity_curve(value);
+    } else if (controller == EARLY_NOTE_OFF_CC) {
+        scan_engine_set_early_note_off(value >= 64);
+    } else if (controller == CC_ALL_SOUND_OFF || controller == CC_ALL_NOTES_OFF) {
+        scan_engine_request_all_notes_off();
+    }
+}
+
+// Add one SysEx packet's bytes; hands the message on once it is complete
+static void handle_sysex_packet(const uint8_t *bytes, uint32_t count, bool end) {
+    if (bytes[0] == SYSEX_START) {
+        sysex_len = 0;
+        sysex_overflow = false;
+    }
+
+    if (sysex_len + count > sizeof(sysex_buf)) {
+        sysex_overflow = true;
+    } else {
+        memcpy(&sysex_buf[sysex_len], bytes, count);
+        sysex_len += count;
+    }
+
+    if (end) {
+        if (!sysex_overflow) sysex_handle(sysex_buf, sysex_len);
+        sysex_len = 0;
+        sysex_overflow = false;
+    }
+}
+
+#ifdef MIDI_UMP_ENABLED
+// Protocols offered to a UMP host
+#define UMP_PROTOCOLS  (UMP_PROTOCOL_MIDI1 | UMP_PROTOCOL_MIDI2)
+
+// UMP message being assembled from words
+static uint32_t ump_msg[UMP_MAX_WORDS];
+static uint32_t ump_have;
+
+// Endpoint discovery and protocol negotiation
+static void handle_stream(const uint32_t *words) {
+    uint32_t reply[4];
+
+    switch (ump_stream_status(words[0])) {
+    case UMP_STREAM_ENDPOINT_DISCOVERY:
+        if (words[1] & UMP_DISCOVERY_ENDPOINT_INFO) {
+            ump_endpoint_info(UMP_PROTOCOLS, reply);
+            midi_out_ump(reply, 4);
+        }
+        break;
+    case UMP_STREAM_CONFIG_REQUEST: {
+        // Anything but MIDI 2.0 gets the MIDI 1.0 protocol
+        uint8_t requested = (uint8_t)(words[0] >> 8);
+        bool midi2 = requested == UMP_PROTOCOL_MIDI2;
+        midi_out_set_protocol(midi2 ? MIDI_OUT_UMP_MIDI2 : MIDI_OUT_UMP_MIDI1);
+        ump_stream_config_notify(midi2 ? UMP_PROTOCOL_MIDI2 : UMP_PROTOCOL_MIDI1, reply);
+        midi_out_ump(reply, 4);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void handle_ump(const uint32_t *words) {
+    uint8_t status = (uint8_t)((words[0] >> 16) & 0xF0);
+    uint8_t index = (uint8_t)((words[0] >> 8) & 0x7F);
+
+    switch (ump_type(words[0])) {
+    case UMP_MT_MIDI1:
+        if (status == 0xB0) handle_control_change(index, words[0] & 0x7F);
+        break;
+    case UMP_MT_MIDI2:
+        // 32-bit controller value: its top 7 bits are the MIDI 1.0 value
+        if (status == 0xB0) handle_control_change(index, (uint8_t)(words[1] >> 25));
+        break;
+    case UMP_MT_DATA64: {
+        // Rebuild the F0 ... F7 byte stream the SysEx handler expects
+        uint8_t data[UMP_SYSEX_BYTES];
+        uint8_t packet_status;
+        uint32_t count = ump_sysex7_bytes(words, &packet_status, data);
+        bool start = packet_status == UMP_SYSEX_COMPLETE || packet_status == UMP_SYSEX_START;
+        bool end = packet_status == UMP_SYSEX_COMPLETE || packet_status == UMP_SYSEX_END;
+
+        uint8_t bytes[UMP_SYSEX_BYTES + 2];
+        uint32_t len = 0;
+        if (start) bytes[len++] = SYSEX_START;
+        memcpy(&bytes[len], data, count);
+        len += count;
+        if (end) bytes[len++] = SYSEX_END;
+        if (len) handle_sysex_packet(bytes, len, end);
+        break;
+    }
+    case UMP_MT_STREAM:
+        handle_stream(words);
+        break;
+    default:
+        break;
+    }
+}
+
+// Follow the host's alternate setting: UMP starts in the MIDI 1.0 protocol
+// until a Stream Configuration Request picks one. Returns true while UMP is
+// selected.
+static bool follow_usb_protocol(void) {
+    bool ump = usb_midi_ump_selected();
+    if (ump != (midi_out_protocol() != MIDI_OUT_USB_MIDI1)) {
+        midi_out_set_protocol(ump ? MIDI_OUT_UMP_MIDI1 : MIDI_OUT_USB_MIDI1);
+        ump_have = 0;
+    }
+    return ump;
+}
+
+static void ump_task(void) {
+    uint32_t word;
+    while (usb_midi_ump_read(&word)) {
+        ump_msg[ump_have++] = word;
+        if (ump_have < ump_message_words(ump_msg[0])) continue;
+        ump_have = 0;
+        handle_ump(ump_msg);
+    }
+}
+#endif // MIDI_UMP_ENABLED
+
+void midi_in_task(void) {
+#ifdef MIDI_UMP_ENABLED
+    if (follow_usb_protocol()) {
+        ump_task();
+        return;
+    }
+#endif
+
+    uint8_t packet[4];
+
+    while (tud_midi_available() && tud_midi_packet_read(packet)) {
+        uint8_t cin = packet[0] & 0x0F;
+
+        switch (cin) {
+        case CIN_CONTROL_CHANGE:
+            handle_control_change(packet[2], packet[3]);
+            break;
+        case CIN_SYSEX_START:
+            handle_sysex_packet(&packet[1], 3, false);
+            break;
+        case CIN_SYSEX_END_1:
+        case CIN_SYSEX_END_2:
+        case CIN_SYSEX_END_3:
+            handle_sysex_packet(&packet[1], cin - CIN_SYSEX_END_1 + 1, true);
+            break;
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,336 @@
+/*
+ * MIDI Output - see midi_out.h
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "keyboard_config.h"
+#include "latency_hist.h"
+#include "sysex.h"
+#ifdef MIDI_UMP_ENABLED
+#include "ump.h"
+#endif
+#include "midi_out.h"
+
+// USB-MIDI code index numbers (cable 0)
+#define CIN_SYSEX_START     0x04    // SysEx start or continue, 3 bytes
+#define CIN_SYSEX_END_1     0x05    // SysEx end with 1-3 bytes: 0x05 + n - 1
+#define CIN_NOTE_OFF        0x08
+#define CIN_NOTE_ON         0x09
+
+// Note packets written to the FIFO but not yet taken by the host; larger
+// than the FIFO plus the transfer in progress
+#define INFLIGHT_PACKETS    64
+
+// A USB-MIDI 1.0 event packet, or one word of a UMP message
+typedef struct {
+#ifdef MIDI_UMP_ENABLED
+    union {
+        uint8_t packet[4];
+        uint32_t word;
+    };
+#else
+    uint8_t packet[4];
+#endif
+    uint32_t sample_us;     // Row sample time (note packets only)
+} backlog_entry_t;
+
+// Ring of packets not yet accepted by TinyUSB; head/tail count packets
+// ever queued/written, so head - tail is the fill level
+static backlog_entry_t backlog[MIDI_OUT_BACKLOG_PACKETS];
+static uint32_t backlog_head;
+static uint32_t backlog_tail;
+
+// Sample times of note packets in the FIFO or on the wire, oldest first
+static uint32_t inflight[INFLIGHT_PACKETS];
+static uint32_t inflight_head;
+static uint32_t inflight_tail;
+
+static midi_out_stats_t stats;
+#ifdef MIDI_UMP_ENABLED
+static midi_out_protocol_t protocol;
+#endif
+
+static const midi_transport_t *transports[MIDI_OUT_MAX_TRANSPORTS];
+static uint32_t transport_count;
+
+static inline bool is_note_packet(const uint8_t packet[4]) {
+    return packet[0] == CIN_NOTE_ON || packet[0] == CIN_NOTE_OFF;
+}
+
+static inline uint32_t backlog_free(void) {
+    return MIDI_OUT_BACKLOG_PACKETS - (backlog_head - backlog_tail);
+}
+
+static void backlog_push(uint8_t cin, const uint8_t *bytes, uint32_t sample_us) {
+    backlog_entry_t *entry = &backlog[backlog_head++ % MIDI_OUT_BACKLOG_PACKETS];
+    entry->packet[0] = cin;
+    memcpy(&entry->packet[1], bytes, 3);
+    entry->sample_us = sample_us;
+}
+
+#ifdef MIDI_UMP_ENABLED
+static void backlog_push_words(const uint32_t *words, uint32_t count, uint32_t sample_us) {
+    for (uint32_t i = 0; i < count; i++) {
+        backlog_entry_t *entry = &backlog[backlog_head++ % MIDI_OUT_BACKLOG_PACKETS];
+        entry->word = words[i];
+        entry->sample_us = sample_us;
+    }
+}
+#endif
+
+void midi_out_init(void) {
+    backlog_head = 0;
+    backlog_tail = 0;
+    inflight_head = 0;
+    inflight_tail = 0;
+    memset(&stats, 0, sizeof(stats));
+#ifdef MIDI_UMP_ENABLED
+    protocol = MIDI_OUT_USB_MIDI1;
+#endif
+    transport_count = 0;
+}
+
+bool midi_out_add_transport(const midi_transport_t *t) {
+    if (transport_count >= MIDI_OUT_MAX_TRANSPORTS) return false;
+
+    transports[transport_count++] = t;
+    return true;
+}
+
+#ifdef MIDI_UMP_ENABLED
+void midi_out_set_protocol(midi_out_protocol_t p) {
+    if (p == protocol) return;
+
+    // Queued messages are in the old format
+    stats.dropped += backlog_head - backlog_tail;
+    backlog_tail = backlog_head;
+    inflight_tail = inflight_head;
+    protocol = p;
+}
+
+midi_out_protocol_t midi_out_protocol(void) {
+    return protocol;
+}
+
+// Note event as one UMP message in the negotiated protocol
+static void ump_note(const note_event_t *ev) {
+#ifdef MIDI_UMP_DELTA_ATTR
+    bool attr = true;
+#else
+    bool attr = false;
+#endif
+    uint32_t words[UMP_MAX_WORDS];
+    uint32_t count = ump_note_event(ev, protocol == MIDI_OUT_UMP_MIDI2 ? UMP_PROTOCOL_MIDI2
+                                                                       : UMP_PROTOCOL_MIDI1,
+                                    attr, words);
+    if (count > backlog_free()) {
+        stats.dropped += count;
+    } else {
+        backlog_push_words(words, count, ev->time_us);
+    }
+}
+#endif // MIDI_UMP_ENABLED
+
+void midi_out_note_event(const note_event_t *ev) {
+    if (ev->note >= MAX_NOTES) return; // Safety check
+
+    // Scan engine stages, measured on core1 and carried in the event
+    latency_hist_add(LATENCY_ACCEPT, ev->accept_us);
+    latency_hist_add(LATENCY_DECISION, ev->decision_us);
+
+    bool on = ev->flags & NOTE_EVENT_ON;
+    uint8_t msg[3];
+    note_event_to_midi(ev, msg);
+
+    // Each transport counts its own drops
+    for (uint32_t i = 0; i < transport_count; i++) {
+        transports[i]->send(msg);
+    }
+
+#ifdef MIDI_UMP_ENABLED
+    if (protocol != MIDI_OUT_USB_MIDI1) {
+        ump_note(ev);
+    } else
+#endif
+    if (backlog_free() == 0) {
+        stats.dropped++;
+    } else {
+        backlog_push(on ? CIN_NOTE_ON : CIN_NOTE_OFF, msg, ev->time_us);
+    }
+
+#ifdef VELOCITY_DEBUG
+    if (on) {
+        printf("Note %d ON, velocity %d\n", ev->note, ev->velocity);
+    } else {
+        printf("Note %d OFF\n", ev->note);
+    }
+#endif
+}
+
+#ifdef MIDI_UMP_ENABLED
+// SysEx as UMP 7-bit SysEx packets: the bytes between F0 and F7, six per
+// packet
+static bool ump_sysex(const uint8_t *msg, uint32_t len) {
+    const uint8_t *data = msg + 1;
+    uint32_t remaining = len - 2;
+    uint32_t packets = remaining ? (remaining + UMP_SYSEX_BYTES - 1) / UMP_SYSEX_BYTES : 1;
+    if (msg[0] != SYSEX_START || msg[len - 1] != SYSEX_END || 2 * packets > backlog_free()) {
+        stats.dropped += 2 * packets;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < packets; i++) {
+        uint32_t count = remaining < UMP_SYSEX_BYTES ? remaining : UMP_SYSEX_BYTES;
+        uint8_t status = packets == 1     ? UMP_SYSEX_COMPLETE
+                         : i == 0         ? UMP_SYSEX_START
+                         : i + 1 < packets ? UMP_SYSEX_CONTINUE
+                                          : UMP_SYSEX_END;
+        uint32_t words[2];
+        ump_sysex7(status, data, count, words);
+        backlog_push_words(words, 2, 0);
+        data += count;
+        remaining -= count;
+    }
+    return true;
+}
+#endif
+
+bool midi_out_sysex(const uint8_t *msg, uint32_t len) {
+#ifdef MIDI_UMP_ENABLED
+    if (protocol != MIDI_OUT_USB_MIDI1) {
+        if (len < 2) return false;
+        return ump_sysex(msg, len);
+    }
+#endif
+
+    uint32_t packets = (len + 2) / 3;
+    if (len < 2 || packets > backlog_free()) {
+        stats.dropped += packets;
+        return false;
+    }
+
+    while (len > 3) {
+        backlog_push(CIN_SYSEX_START, msg, 0);
+        msg += 3;
+        len -= 3;
+    }
+
+    // Last packet carries the remaining 1-3 bytes, ending with F7
+    uint8_t last[3] = { 0 };
+    memcpy(last, msg, len);
+    backlog_push((uint8_t)(CIN_SYSEX_END_1 + len - 1), last, 0);
+    return true;
+}
+
+#ifdef MIDI_UMP_ENABLED
+bool midi_out_ump(const uint32_t *words, uint32_t count) {
+    if (protocol == MIDI_OUT_USB_MIDI1 || count > backlog_free()) {
+        stats.dropped += count;
+        return false;
+    }
+    backlog_push_words(words, count, 0);
+    return true;
+}
+#endif
+
+// The IN endpoint only goes idle once TinyUSB's TX FIFO is empty (a finished
+// transfer starts the next one straight away), so every packet written
+// before an idle endpoint has been taken by the host
+static void record_usb_complete(void) {
+    if (inflight_head == inflight_tail || usb_midi_tx_busy()) return;
+
+    uint32_t now = time_us_32();
+    while (inflight_tail != inflight_head) {
+        latency_hist_add(LATENCY_USB, now - inflight[inflight_tail++ % INFLIGHT_PACKETS]);
+    }
+}
+
+// A note packet (or UMP note message) has gone into the TX FIFO
+static void record_note_written(uint32_t sample_us) {
+    latency_hist_add(LATENCY_FIFO, time_us_32() - sample_us);
+    if (inflight_head - inflight_tail < INFLIGHT_PACKETS) {
+        inflight[inflight_head++ % INFLIGHT_PACKETS] = sample_us;
+    }
+}
+
+#ifdef MIDI_UMP_ENABLED
+// Write whole UMP messages; a message the FIFO cannot take waits
+static void ump_flush(void) {
+    while (backlog_tail != backlog_head) {
+        const backlog_entry_t *first = &backlog[backlog_tail % MIDI_OUT_BACKLOG_PACKETS];
+        uint32_t count = ump_message_words(first->word);
+        if (count > backlog_head - backlog_tail) count = backlog_head - backlog_tail;
+
+        uint32_t words[UMP_MAX_WORDS];
+        for (uint32_t i = 0; i < count; i++) {
+            words[i] = backlog[(backlog_tail + i) % MIDI_OUT_BACKLOG_PACKETS].word;
+        }
+        if (!usb_midi_ump_write(words, count)) {
+            stats.fifo_full++;
+            break;  // TX FIFO full, retry on the next flush
+        }
+        backlog_tail += count;
+        stats.sent += count;
+
+        if (ump_is_note(words[0])) record_note_written(first->sample_us);
+    }
+}
+#endif
+
+static void usb_flush(void) {
+    bool mounted = tud_midi_mounted();
+#ifdef MIDI_UMP_ENABLED
+    if (protocol != MIDI_OUT_USB_MIDI1) mounted = usb_midi_ump_selected();
+#endif
+    if (!mounted) {
+        // Nobody to send to; stale notes must not burst out on the next mount
+        stats.dropped += backlog_head - backlog_tail;
+        backlog_tail = backlog_head;
+        inflight_tail = inflight_head;
+        return;
+    }
+
+    record_usb_complete();
+
+#ifdef MIDI_UMP_ENABLED
+    if (protocol != MIDI_OUT_USB_MIDI1) {
+        ump_flush();
+        stats.deferred += backlog_head - backlog_tail;
+        return;
+    }
+#endif
+
+    while (backlog_tail != backlog_head) {
+        const backlog_entry_t *entry = &backlog[backlog_tail % MIDI_OUT_BACKLOG_PACKETS];
+        if (!tud_midi_packet_write(entry->packet)) {
+            stats.fifo_full++;
+            break;  // TX FIFO full, retry on the next flush
+        }
+        backlog_tail++;
+        stats.sent++;
+
+        if (is_note_packet(entry->packet)) record_note_written(entry->sample_us);
+    }
+
+    stats.deferred += backlog_head - backlog_tail;
+}
+
+void midi_out_flush(void) {
+    usb_flush();
+
+    // Transports keep playing while no USB host is attached
+    for (uint32_t i = 0; i < transport_count; i++) {
+        transports[i]->flush();
+    }
+}
+
+uint32_t midi_out_backlog(void) {
+    return backlog_head - backlog_tail;
+}
+
+void midi_out_get_stats(midi_out_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,49 @@
+/*
+ * MIDI Byte-Stream Encoder - see midi_stream.h
+ */
+
+#include "midi_stream.h"
+
+#define STATUS_NOTE_OFF         0x80
+#define STATUS_NOTE_ON          0x90
+#define STATUS_PROGRAM_CHANGE   0xC0
+#define STATUS_CHANNEL_PRESSURE 0xD0
+
+void midi_stream_init(midi_stream_t *s, uint8_t flags) {
+    s->flags = flags;
+    s->status = 0;
+}
+
+void midi_stream_reset(midi_stream_t *s) {
+    s->status = 0;
+}
+
+uint32_t midi_stream_channel_msg(midi_stream_t *s, uint8_t status, uint8_t data1, uint8_t data2,
+                                 uint8_t out[MIDI_STREAM_MAX_BYTES]) {
+    if (status < 0x80 || status >= 0xF0) return 0;
+
+    uint8_t type = status & 0xF0;
+    if ((s->flags & MIDI_STREAM_ZERO_VEL_OFF) && type == STATUS_NOTE_OFF) {
+        status = (uint8_t)(STATUS_NOTE_ON | (status & 0x0F));
+        type = STATUS_NOTE_ON;
+        data2 = 0;
+    }
+
+    uint32_t len = 0;
+    if (!(s->flags & MIDI_STREAM_RUNNING_STATUS) || status != s->status) {
+        out[len++] = status;
+        if (s->flags & MIDI_STREAM_RUNNING_STATUS) s->status = status;
+    }
+    out[len++] = data1 & 0x7F;
+    if (type != STATUS_PROGRAM_CHANGE && type != STATUS_CHANNEL_PRESSURE) {
+        out[len++] = data2 & 0x7F;
+    }
+    return len;
+}
+
+uint32_t midi_stream_note_event(midi_stream_t *s, const note_event_t *ev,
+                                uint8_t out[MIDI_STREAM_MAX_BYTES]) {
+    uint8_t msg[3];
+    note_event_to_midi(ev, msg);
+    return midi_stream_channel_msg(s, msg[0], msg[1], msg[2], out);
+}
@@ -0,0 +1,96 @@
+/*
+ * DIN MIDI Output (UART) - see midi_uart.h
+ *
+ * head counts bytes ever queued, tail bytes the DMA has finished reading;
+ * the transfer in progress covers dma_len bytes from tail. Everything runs
+ * on the core that owns midi_out, so none of it is shared.
+ */
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/uart.h"
+#include "hardware/dma.h"
+#include "keyboard_config.h"
+#include "midi_uart.h"
+
+#define MIDI_UART_ID    uart0   // GP28 is a UART0 TX pin
+#define RING_MASK       (MIDI_UART_RING_BYTES - 1)
+
+static uint8_t ring[MIDI_UART_RING_BYTES] __attribute__((aligned(MIDI_UART_RING_BYTES)));
+static uint32_t head;
+static uint32_t tail;
+static uint32_t dma_len;
+static int dma_chan = -1;
+
+static midi_stream_t stream;
+static midi_uart_stats_t stats;
+
+void midi_uart_init(void) {
+    gpio_set_function(MIDI_UART_TX_PIN, GPIO_FUNC_UART);
+    uart_init(MIDI_UART_ID, MIDI_UART_BAUD);    // 8N1, FIFOs on
+
+    if (dma_chan < 0) {
+        dma_chan = dma_claim_unused_channel(true);
+    } else {
+        dma_channel_abort(dma_chan);
+    }
+
+    // Bytes from the ring to the TX data register, one per free FIFO slot
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, MIDI_UART_RING_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq_num(MIDI_UART_ID, true));
+    dma_channel_configure(dma_chan, &c, &uart_get_hw(MIDI_UART_ID)->dr, ring, 0, false);
+
+    head = 0;
+    tail = 0;
+    dma_len = 0;
+    midi_stream_init(&stream, MIDI_UART_STREAM_FLAGS);
+    memset(&stats, 0, sizeof(stats));
+}
+
+static bool uart_send(const uint8_t msg[3]) {
+    // Checked before encoding, so a dropped message leaves the running
+    // status as the line last saw it
+    if (MIDI_UART_RING_BYTES - (head - tail) < MIDI_STREAM_MAX_BYTES) {
+        stats.dropped++;
+        return false;
+    }
+
+    uint8_t bytes[MIDI_STREAM_MAX_BYTES];
+    uint32_t len = midi_stream_channel_msg(&stream, msg[0], msg[1], msg[2], bytes);
+    for (uint32_t i = 0; i < len; i++) {
+        ring[head++ & RING_MASK] = bytes[i];
+    }
+
+    stats.messages++;
+    stats.bytes += len;
+    if (head - tail > stats.max_fill) stats.max_fill = head - tail;
+    return len != 0;
+}
+
+static void uart_flush(void) {
+    if (dma_len) {
+        if (dma_channel_is_busy(dma_chan)) return;
+        tail += dma_len;
+        dma_len = 0;
+    }
+    if (head == tail) return;
+
+    // The read ring wraps at the end of the buffer, so one transfer takes
+    // everything queued
+    dma_len = head - tail;
+    dma_channel_transfer_from_buffer_now(dma_chan, &ring[tail & RING_MASK], dma_len);
+}
+
+void midi_uart_get_stats(midi_uart_stats_t *out) {
+    *out = stats;
+}
+
+const midi_transport_t midi_uart_transport = {
+    .send = uart_send,
+    .flush = uart_flush,
+};
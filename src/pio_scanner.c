@@ -0,0 +1,139 @@
+/*
+ * PIO + DMA Matrix Scanner - see pio_scanner.h
+ */
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "keyboard_config.h"
+#include "pio_scanner.h"
+#include "matrix_scan.pio.h"
+
+static PIO scan_pio = pio0;
+static uint scan_sm;
+static int tx_dma;
+static int rx_dma;
+
+// Row descriptors fed to the state machine, one per drive pin, and each
+// row's sample time relative to the frame start
+static uint32_t descriptors[NUM_DRIVE_PINS];
+static uint32_t sample_offset_us[NUM_DRIVE_PINS];
+
+// Double-buffered raw frames: DMA fills one while the CPU reads the other
+static uint32_t frames[2][NUM_DRIVE_PINS];
+static volatile uint8_t write_index;
+static volatile bool frame_ready;
+static volatile bool frame_running;
+static volatile uint32_t frame_start_us[2];     // Start time of each buffer's frame
+static volatile uint32_t dropped_frames;
+
+// Start both channels on the next frame
+static void start_frame(void) {
+    frame_start_us[write_index] = time_us_32();
+    dma_channel_set_write_addr(rx_dma, frames[write_index], false);
+    dma_channel_set_trans_count(rx_dma, NUM_DRIVE_PINS, true);
+    dma_channel_set_read_addr(tx_dma, descriptors, false);
+    dma_channel_set_trans_count(tx_dma, NUM_DRIVE_PINS, true);
+}
+
+// RX DMA finished: the frame in write_index is complete. The next frame
+// starts on the scan scheduler's next tick (pio_scanner_start_frame).
+static void scan_dma_irq_handler(void) {
+    dma_hw->ints0 = 1u << rx_dma;
+
+    if (frame_ready) {
+        dropped_frames++;
+    }
+    write_index ^= 1;
+    frame_ready = true;
+    frame_running = false;
+
+    // Wake a core waiting for the frame in __wfe()
+    __sev();
+}
+
+void pio_scanner_init(const uint32_t settle_us[NUM_DRIVE_PINS]) {
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        descriptors[drive] = pio_scan_descriptor(drive, settle_us[drive]);
+    }
+    pio_scan_sample_offsets(descriptors, sample_offset_us);
+
+    uint offset = pio_add_program(scan_pio, &matrix_scan_program);
+    scan_sm = pio_claim_unused_sm(scan_pio, true);
+    matrix_scan_program_init(scan_pio, scan_sm, offset, DRIVE0, PIO_SCAN_IN_BASE,
+                             PIO_SCAN_CLOCK_HZ);
+
+    // TX: descriptors -> state machine, paced by the TX FIFO
+    tx_dma = dma_claim_unused_channel(true);
+    dma_channel_config tx = dma_channel_get_default_config(tx_dma);
+    channel_config_set_transfer_data_size(&tx, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx, true);
+    channel_config_set_write_increment(&tx, false);
+    channel_config_set_dreq(&tx, pio_get_dreq(scan_pio, scan_sm, true));
+    dma_channel_configure(tx_dma, &tx, &scan_pio->txf[scan_sm], descriptors,
+                          NUM_DRIVE_PINS, false);
+
+    // RX: samples -> frame buffer, paced by the RX FIFO
+    rx_dma = dma_claim_unused_channel(true);
+    dma_channel_config rx = dma_channel_get_default_config(rx_dma);
+    channel_config_set_transfer_data_size(&rx, DMA_SIZE_32);
+    channel_config_set_read_increment(&rx, false);
+    channel_config_set_write_increment(&rx, true);
+    channel_config_set_dreq(&rx, pio_get_dreq(scan_pio, scan_sm, false));
+    dma_channel_configure(rx_dma, &rx, frames[0], &scan_pio->rxf[scan_sm],
+                          NUM_DRIVE_PINS, false);
+
+    dma_channel_set_irq0_enabled(rx_dma, true);
+    irq_set_exclusive_handler(DMA_IRQ_0, scan_dma_irq_handler);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    write_index = 0;
+    frame_ready = false;
+    frame_running = false;
+    dropped_frames = 0;
+
+    // Stalls on pull until the first frame is started
+    pio_sm_set_enabled(scan_pio, scan_sm, true);
+}
+
+bool pio_scanner_start_frame(void) {
+    if (frame_running) return false;
+
+    frame_running = true;
+    start_frame();
+    return true;
+}
+
+void pio_scanner_set_settle(uint8_t drive, uint32_t settle_us) {
+    if (drive >= NUM_DRIVE_PINS) return;
+    descriptors[drive] = pio_scan_descriptor(drive, settle_us);
+    pio_scan_sample_offsets(descriptors, sample_offset_us);
+}
+
+bool pio_scanner_get_frame(uint16_t rows[NUM_DRIVE_PINS], uint32_t row_time[NUM_DRIVE_PINS]) {
+    if (!frame_ready) return false;
+
+    // DMA only writes the other buffer; holding off the IRQ keeps it from
+    // flipping buffers mid-copy
+    uint32_t irq_state = save_and_disable_interrupts();
+    const uint32_t *frame = frames[write_index ^ 1];
+    uint32_t start = frame_start_us[write_index ^ 1];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        rows[drive] = pio_scan_sample_to_row(frame[drive]);
+        row_time[drive] = start + sample_offset_us[drive];
+    }
+    frame_ready = false;
+    restore_interrupts(irq_state);
+
+    return true;
+}
+
+bool pio_scanner_busy(void) {
+    return frame_running || frame_ready;
+}
+
+uint32_t pio_scanner_dropped_frames(void) {
+    return dropped_frames;
+}
@@ -0,0 +1,70 @@
+/*
+ * Main Loop Phase Profiler - see profiler.h
+ */
+
+#include <string.h>
+#include "profiler.h"
+
+#ifdef PROFILE_ENABLED
+
+// SysTick control: enable, processor clock source, no interrupt
+#define SYSTICK_CSR_ENABLE      0x1u
+#define SYSTICK_CSR_CLKSOURCE   0x4u
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t sum_cycles;
+    uint32_t hist[PROFILE_HIST_BUCKETS];
+} phase_record_t;
+
+static phase_record_t phases[PROFILE_PHASE_COUNT];
+
+void profile_init(void) {
+    systick_hw->csr = 0;
+    systick_hw->rvr = PROFILE_CYCLE_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = SYSTICK_CSR_ENABLE | SYSTICK_CSR_CLKSOURCE;
+}
+
+void profile_clear(void) {
+    memset(phases, 0, sizeof(phases));
+}
+
+void profile_record(profile_phase_t phase, uint32_t cycles) {
+    phase_record_t *p = &phases[phase];
+
+    if (p->count == UINT32_MAX) return;     // Saturated; clear to restart
+    if (p->count == 0 || cycles < p->min_cycles) p->min_cycles = cycles;
+    if (cycles > p->max_cycles) p->max_cycles = cycles;
+    p->sum_cycles += cycles;
+    p->count++;
+    p->hist[profile_hist_bucket(cycles)]++;
+}
+
+void profile_get_stats(profile_phase_t phase, profile_stats_t *out) {
+    const phase_record_t *p = &phases[phase];
+    memset(out, 0, sizeof(*out));
+    if (p->count == 0) return;
+
+    out->count = p->count;
+    out->min_cycles = p->min_cycles;
+    out->max_cycles = p->max_cycles;
+    out->mean_cycles = (uint32_t)(p->sum_cycles / p->count);
+
+    // Walk the histogram to the bucket holding sample number ceil(0.99 * n)
+    uint32_t rank = p->count - p->count / 100;
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < PROFILE_HIST_BUCKETS; bucket++) {
+        seen += p->hist[bucket];
+        if (seen >= rank) {
+            uint32_t top = bucket + 1 < PROFILE_HIST_BUCKETS
+                ? profile_hist_bucket_floor(bucket + 1) - 1 : p->max_cycles;
+            out->p99_cycles = top < p->max_cycles ? top : p->max_cycles;
+            break;
+        }
+    }
+}
+
+#endif // PROFILE_ENABLED
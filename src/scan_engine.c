@@ -0,0 +1,841 @@
+/*
+ * Scan Engine - Dual-Sensor Matrix Scanning + Velocity Detection
+ *
+ * Everything between the GPIO pins and the note events: row scanning,
+ * debouncing and the per-note velocity state machine.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "note_map.h"
+#include "keyboard_config.h"
+#include "scan_engine.h"
+#include "note_set.h"
+#include "sensor_positions.h"
+#include "velocity_curves.h"
+#include "profiler.h"
+#include "settle_profile.h"
+
+// Key velocity state machine
+typedef enum {
+    KEY_IDLE,           // No sensors triggered
+    KEY_FIRST_PRESSED,  // First sensor triggered, waiting for second
+    KEY_BOTH_PRESSED,   // Both sensors triggered, note is playing
+    KEY_RELEASING,      // Second sensor released, waiting for the first
+} key_velocity_state_t;
+
+// Per-note state byte: key_velocity_state_t in the low bits plus the current
+// state of each sensor
+#define KEY_STATE_MASK      0x03u
+#define KEY_FIRST_ACTIVE    0x04u   // First sensor currently pressed
+#define KEY_SECOND_ACTIVE   0x08u   // Second sensor currently pressed
+
+// All timestamps are 32-bit microseconds (time_us_32) and only ever compared
+// as unsigned differences, so they stay correct across the ~71 minute wrap.
+// Every interval measured here is far shorter than 2^32 us.
+
+// Velocity tracking per key (indexed by engine note 0-143), structure of
+// arrays so each field packs without padding
+static uint8_t key_state[MAX_NOTES];
+// When the first sensor triggered (KEY_FIRST_PRESSED), when the second sensor
+// released (KEY_RELEASING), or when the first sensor released while the
+// second was still closed (KEY_BOTH_PRESSED). For a note awaiting its first
+// sensor (KEY_IDLE, see awaiting_first) the press delta it will use instead.
+static uint32_t first_trigger_time[MAX_NOTES];
+
+// Debounced sensor state, one 12-bit word per drive row (bit = read column)
+static uint16_t pressed_rows[NUM_DRIVE_PINS];
+
+#if DEBOUNCE_ENGINE == DEBOUNCE_VERTICAL
+#if DEBOUNCE_SAMPLES < 1 || DEBOUNCE_SAMPLES > 4
+#error "DEBOUNCE_SAMPLES must be 1-4 (2-bit vertical counters)"
+#endif
+// Per row, bit planes of a 2-bit counter per position: how many scans in a
+// row the position has differed from pressed_rows
+static uint16_t debounce_count_lo[NUM_DRIVE_PINS];
+static uint16_t debounce_count_hi[NUM_DRIVE_PINS];
+
+// Rows and sample times of the last DEBOUNCE_SAMPLES scans. A position is
+// accepted DEBOUNCE_SAMPLES - 1 scans after the scan that first saw it, and
+// is dispatched with that scan's rows and times: its interval to the other
+// sensor then does not depend on the scan period changing in between (the
+// idle rate speeding up as a held key is released).
+static uint16_t history_rows[DEBOUNCE_SAMPLES][NUM_DRIVE_PINS];
+static uint32_t history_time[DEBOUNCE_SAMPLES][NUM_DRIVE_PINS];
+static uint8_t history_index;
+#else
+// Time of the last accepted change per position (for debouncing sensors).
+// A position idle for a multiple of 2^32 us can alias a recent change and be
+// held off for at most DEBOUNCE_TIME_US once.
+static uint32_t last_change_time[NUM_DRIVE_PINS][NUM_READ_PINS];
+#endif
+
+// CPU scan: minimum time each row is driven before it is sampled
+static uint32_t row_settle_us[NUM_DRIVE_PINS];
+
+// Last frame had a sensor change (accepted or still bouncing) or a note
+// waiting for its second sensor (or first, awaiting_first)
+static bool keys_moving;
+
+// Active velocity curve; written by the USB core (MIDI CC), read here
+static volatile velocity_curve_t velocity_curve = VELOCITY_CURVE_LINEAR;
+
+// scan_engine_all_notes_off() wanted at the end of the next frame; set by the
+// USB core (MIDI CC)
+static volatile bool all_notes_off_requested;
+
+// Note Off on the second sensor's release; written by the USB core (MIDI CC)
+#ifdef EARLY_NOTE_OFF
+static volatile bool early_note_off = true;
+#else
+static volatile bool early_note_off = false;
+#endif
+
+// Notes that have sent Note On but not Note Off, maintained by emit_note_event()
+// so readers (LED, panic) never walk key_state
+static note_set_t sounding_notes;
+static volatile uint32_t sounding_count;
+
+// Notes in KEY_FIRST_PRESSED waiting for their second sensor, as a doubly
+// linked list through note indices (NOTE_NONE terminates). Every deadline is
+// first_trigger_time + VELOCITY_TIMEOUT_US and notes are added in time order,
+// so the list is also in expiry order: the head is always the next to expire.
+static uint8_t pending_head;
+static uint8_t pending_tail;
+static uint8_t pending_next[MAX_NOTES];
+static uint8_t pending_prev[MAX_NOTES];
+
+// Notes whose second sensor closed while the first, sampled earlier in the
+// frame, still read open. The first may have closed just after its sample:
+// the Note On waits for it to be seen closed by the end of the next frame,
+// else the second sensor stands alone (dead first sensor or a noisy read).
+static note_set_t awaiting_first;       // Second sensor closed this frame
+static note_set_t awaiting_first_late;  // Last frame: expires at this frame's end
+
+// ============================================================================
+// VELOCITY HELPER FUNCTIONS
+// ============================================================================
+
+// Initialize velocity tracking system
+static void init_velocity_system(void) {
+    memset(key_state, KEY_IDLE, sizeof(key_state));
+    memset(first_trigger_time, 0, sizeof(first_trigger_time));
+
+    pending_head = NOTE_NONE;
+    pending_tail = NOTE_NONE;
+
+    note_set_clear(&sounding_notes);
+    sounding_count = 0;
+
+    note_set_clear(&awaiting_first);
+    note_set_clear(&awaiting_first_late);
+}
+
+// Start the second-sensor timeout for a note (append: latest deadline)
+static void pending_timeout_add(uint8_t note) {
+    pending_next[note] = NOTE_NONE;
+    pending_prev[note] = pending_tail;
+    if (pending_tail != NOTE_NONE) {
+        pending_next[pending_tail] = note;
+    } else {
+        pending_head = note;
+    }
+    pending_tail = note;
+}
+
+// Cancel a note's timeout in O(1)
+static void pending_timeout_remove(uint8_t note) {
+    uint8_t prev = pending_prev[note];
+    uint8_t next = pending_next[note];
+
+    if (prev != NOTE_NONE) pending_next[prev] = next; else pending_head = next;
+    if (next != NOTE_NONE) pending_prev[next] = prev; else pending_tail = prev;
+}
+
+// Calculate velocity from time difference between sensors
+// Returns velocity value 1-127 from the active curve table
+// Shorter time = faster press = higher velocity
+static uint8_t calculate_velocity(uint32_t delta_us) {
+    return velocity_curve_lookup(velocity_curve, delta_us);
+}
+
+// Row word from a gpio_get_all() sample
+// Columns 0-10 = GPIO 12-22, Column 11 = GPIO 26
+static inline uint16_t gpio_to_row(uint32_t gpio_state) {
+    // Extract GPIO 12-22 to columns 0-10 (11 bits)
+    uint16_t result = (gpio_state >> 12) & 0x7FF;
+
+    // Extract GPIO 26 to column 11
+    if (gpio_state & (1 << 26)) {
+        result |= (1 << 11);
+    }
+
+    return result;
+}
+
+#if !SCAN_PIPELINE
+// Scan one row efficiently
+static inline uint16_t scan_row(uint8_t drive) {
+    gpio_put(DRIVE0 + drive, 1);
+    busy_wait_us_32(row_settle_us[drive]);
+    uint32_t gpio_state = gpio_get_all();
+    gpio_put(DRIVE0 + drive, 0);
+
+    return gpio_to_row(gpio_state);
+}
+#endif
+
+// ============================================================================
+// VELOCITY-AWARE NOTE EVENTS
+// ============================================================================
+
+// Where note events go (MIDI output, or the queue to the USB core)
+static note_event_sink_t event_sink;
+
+// Sees every processed frame (trace capture), NULL when unused
+static scan_frame_tap_t frame_tap;
+
+// Positions that differed from the debounced state last scan without being
+// accepted
+static uint16_t unaccepted_rows[NUM_DRIVE_PINS];
+
+// Events emitted since the last frame ended
+static uint32_t frame_events;
+
+static scan_engine_stats_t stats;
+
+// CPU time the change being handled passed debouncing (for latency stats)
+static uint32_t accept_time;
+
+// Microseconds from sample time to t, saturated to the event's 16-bit fields
+static inline uint16_t stage_delay(uint32_t t, uint32_t sample) {
+    uint32_t delay = t - sample;
+    return delay < UINT16_MAX ? (uint16_t)delay : UINT16_MAX;
+}
+
+// Sensor interval of an event with no measurement (default velocity for
+// Note On, 0 for Note Off)
+#define NO_DELTA  UINT32_MAX
+
+// Emit a note event. delta_us is a Note On's first-to-second sensor delta or
+// a Note Off's second-to-first release interval, NO_DELTA if not measured.
+// Release velocity uses the same curve as Note On.
+static void emit_note_event(uint8_t note, bool on, uint32_t delta_us, uint32_t now) {
+    if (note >= MAX_NOTES || !event_sink) return; // Safety check
+
+    if (on) {
+        if (note_set_add(&sounding_notes, note)) sounding_count++;
+    } else {
+        if (note_set_remove(&sounding_notes, note)) sounding_count--;
+    }
+
+    note_event_t ev = {
+        .time_us = now,
+        .note = note,
+        .flags = on ? NOTE_EVENT_ON : 0,
+        .accept_us = stage_delay(accept_time, now),
+    };
+#ifndef RELEASE_VELOCITY
+    if (!on) delta_us = NO_DELTA;
+#endif
+    if (delta_us != NO_DELTA) {
+        uint32_t delta = delta_us >> NOTE_EVENT_DELTA_SHIFT;
+        ev.velocity = calculate_velocity(delta_us);
+        ev.velocity16 = velocity_curve_lookup16(velocity_curve, delta_us);
+        ev.sensor_delta = delta < UINT16_MAX ? (uint16_t)delta : UINT16_MAX;
+        ev.flags |= NOTE_EVENT_MEASURED;
+    } else if (on) {
+        ev.velocity = VELOCITY_DEFAULT;
+        ev.velocity16 = (uint16_t)(VELOCITY_DEFAULT << 9);
+    }
+    ev.decision_us = stage_delay(time_us_32(), now);
+    frame_events++;
+    event_sink(&ev);
+}
+
+// Set a note's velocity state, keeping its sensor bits
+static inline void set_key_state(uint8_t note, key_velocity_state_t state) {
+    key_state[note] = (uint8_t)((key_state[note] & ~KEY_STATE_MASK) | state);
+}
+
+// Release interval of a key whose first sensor was seen open at first_open
+// and second at second_open. Seen the wrong way round within one scan period
+// (the first's row sampled earlier, or its debounce done a frame sooner),
+// both opened between two samples: as fast as can be measured. A first
+// sensor that opened longer before, or too long after, leaves nothing to
+// measure.
+static uint32_t release_interval(uint32_t first_open, uint32_t second_open) {
+    uint32_t interval = first_open - second_open;
+    if ((int32_t)interval < 0) return second_open - first_open < SCAN_PERIOD_US ? 0 : NO_DELTA;
+    return interval < VELOCITY_TIMEOUT_US ? interval : NO_DELTA;
+}
+
+// Stop waiting for a note's first sensor; returns true if it was waiting
+static bool awaiting_first_remove(uint8_t note) {
+    return note_set_remove(&awaiting_first, note) || note_set_remove(&awaiting_first_late, note);
+}
+
+// Note On for a second sensor whose first was never seen: default velocity
+static void second_without_first(uint8_t note, uint32_t now) {
+    stats.second_without_first++;
+    set_key_state(note, KEY_BOTH_PRESSED);
+    emit_note_event(note, true, NO_DELTA, now);
+
+#ifdef VELOCITY_DEBUG
+    printf("Second sensor: note %d pressed WITHOUT first sensor, using default velocity\n", note);
+#endif
+}
+
+// Handle first sensor state change
+static void handle_first_sensor(uint8_t note, bool is_pressed, uint32_t now) {
+    if (note == NOTE_NONE || note >= MAX_NOTES) return;
+
+    uint8_t ks = is_pressed ? key_state[note] | KEY_FIRST_ACTIVE
+                            : key_state[note] & ~KEY_FIRST_ACTIVE;
+    key_state[note] = ks;
+    key_velocity_state_t state = ks & KEY_STATE_MASK;
+
+    if (is_pressed && state == KEY_IDLE && awaiting_first_remove(note)) {
+        // Closed just after its sample last frame: the second sensor's
+        // midpoint delta stands
+        set_key_state(note, KEY_BOTH_PRESSED);
+        emit_note_event(note, true, first_trigger_time[note], now);
+    }
+    else if (is_pressed && state == KEY_IDLE) {
+        // First sensor pressed - start velocity measurement
+        set_key_state(note, KEY_FIRST_PRESSED);
+        first_trigger_time[note] = now;
+        pending_timeout_add(note);
+
+#ifdef VELOCITY_DEBUG
+        printf("First sensor: note %d pressed at %lu\n", note, (unsigned long)now);
+#endif
+    }
+    else if (!is_pressed && state != KEY_IDLE) {
+        // First sensor released
+        if (state == KEY_RELEASING) {
+            // Key back up: the second-to-first interval is the release
+            // velocity, unless an early Note Off went out with the second
+            // sensor (or a panic already ended the note)
+            uint32_t interval = now - first_trigger_time[note];
+            if (note_set_contains(&sounding_notes, note)) {
+                emit_note_event(note, false, interval < VELOCITY_TIMEOUT_US ? interval : NO_DELTA, now);
+            }
+            set_key_state(note, KEY_IDLE);
+
+#ifdef VELOCITY_DEBUG
+            printf("First sensor: note %d released, interval=%lu us\n", note, (unsigned long)interval);
+#endif
+        }
+        else if (state == KEY_BOTH_PRESSED && !(ks & KEY_SECOND_ACTIVE)) {
+            // Second sensor never closed (velocity timeout) - send Note Off
+            emit_note_event(note, false, NO_DELTA, now);
+            set_key_state(note, KEY_IDLE);
+
+#ifdef VELOCITY_DEBUG
+            printf("First sensor: note %d released (both off)\n", note);
+#endif
+        }
+        else if (state == KEY_BOTH_PRESSED) {
+            // Before the second sensor: its row may just not be dispatched
+            // yet this frame, or the key is still held and this is a glitch.
+            // The note ends when the second sensor opens; keep the time for
+            // release_interval().
+            first_trigger_time[note] = now;
+        }
+        else if (state == KEY_FIRST_PRESSED) {
+            // First sensor released before second triggered - timeout case
+            set_key_state(note, KEY_IDLE);
+            pending_timeout_remove(note);
+
+#ifdef VELOCITY_DEBUG
+            printf("First sensor: note %d released early\n", note);
+#endif
+        }
+    }
+}
+
+// Handle second sensor state change. first_sample is the time the note's
+// first sensor was last sampled before now (NULL if it was not sampled earlier
+// in this frame) and first_closed what that sample read.
+static void handle_second_sensor(uint8_t note, bool is_pressed, uint32_t now,
+                                 const uint32_t *first_sample, bool first_closed) {
+    if (note == NOTE_NONE || note >= MAX_NOTES) return;
+
+    uint8_t ks = is_pressed ? key_state[note] | KEY_SECOND_ACTIVE
+                            : key_state[note] & ~KEY_SECOND_ACTIVE;
+    key_state[note] = ks;
+    key_velocity_state_t state = ks & KEY_STATE_MASK;
+
+    if (is_pressed && (state == KEY_FIRST_PRESSED || state == KEY_IDLE)) {
+        // Second sensor pressed
+        uint32_t delta;
+
+        if (state == KEY_FIRST_PRESSED) {
+            // Both sensors active - calculate velocity. Within one frame the
+            // second sensor's row can be sampled before the first's: both
+            // closed between two samples, as fast as can be measured.
+            delta = now - first_trigger_time[note];
+            if ((int32_t)delta < 0) delta = 0;
+            pending_timeout_remove(note);
+
+#ifdef VELOCITY_DEBUG
+            printf("Second sensor: note %d pressed, delta=%lu us, velocity=%d\n",
+                   note, (unsigned long)delta, calculate_velocity(delta));
+#endif
+        } else if (ks & KEY_FIRST_ACTIVE) {
+            // First sensor held through a panic: its time was dropped
+            delta = NO_DELTA;
+        } else if (first_sample) {
+            // First sensor's row was sampled earlier in this frame: it
+            // closed around that sample, take the midpoint. Read open, it
+            // must still be seen closed next frame.
+            delta = (now - *first_sample) / 2;
+            if (!first_closed) {
+                first_trigger_time[note] = delta;
+                note_set_add(&awaiting_first, note);
+                return;
+            }
+        } else {
+            // Second sensor pressed without first (shouldn't happen normally, but handle it)
+            second_without_first(note, now);
+            return;
+        }
+
+        set_key_state(note, KEY_BOTH_PRESSED);
+
+        // Send Note On with calculated velocity
+        emit_note_event(note, true, delta, now);
+    }
+    else if (is_pressed && state == KEY_RELEASING) {
+        // Half release: the key came back down before the first sensor
+        // opened. The note is still sounding, unless an early Note Off
+        // ended it: then this is a repeated strike, with the time the
+        // second sensor was open standing in for the press delta.
+        set_key_state(note, KEY_BOTH_PRESSED);
+        if (!note_set_contains(&sounding_notes, note)) {
+            emit_note_event(note, true, now - first_trigger_time[note], now);
+        }
+
+#ifdef VELOCITY_DEBUG
+        printf("Second sensor: note %d pressed again from half release\n", note);
+#endif
+    }
+    else if (!is_pressed && state == KEY_IDLE && awaiting_first_remove(note)) {
+        // Open again before the first sensor was seen: a short note at the
+        // default velocity
+        second_without_first(note, now);
+        emit_note_event(note, false, NO_DELTA, now);
+        set_key_state(note, KEY_IDLE);
+    }
+    else if (!is_pressed && state == KEY_BOTH_PRESSED) {
+        // Second sensor released
+        if (!(ks & KEY_FIRST_ACTIVE)) {
+            // Both sensors released - send Note Off
+            emit_note_event(note, false, release_interval(first_trigger_time[note], now), now);
+            set_key_state(note, KEY_IDLE);
+
+#ifdef VELOCITY_DEBUG
+            printf("Second sensor: note %d released (both off)\n", note);
+#endif
+        } else {
+            // Key on its way up: time it until the first sensor opens
+            first_trigger_time[note] = now;
+            set_key_state(note, KEY_RELEASING);
+            if (early_note_off) emit_note_event(note, false, NO_DELTA, now);
+
+#ifdef VELOCITY_DEBUG
+            printf("Second sensor: note %d released\n", note);
+#endif
+        }
+    }
+}
+
+// Check for velocity timeout (first sensor triggered but second hasn't within timeout)
+// Only expired notes are visited: the pending list is in deadline order.
+static void check_velocity_timeout(uint32_t now) {
+    while (pending_head != NOTE_NONE) {
+        uint8_t note = pending_head;
+
+        uint32_t time_waiting = now - first_trigger_time[note];
+        if (time_waiting < VELOCITY_TIMEOUT_US) {
+            break;  // Every later note expires later
+        }
+
+        // Timeout - send Note On with default velocity
+        pending_timeout_remove(note);
+        stats.velocity_timeouts++;
+        accept_time = time_us_32();
+        set_key_state(note, KEY_BOTH_PRESSED);
+        emit_note_event(note, true, NO_DELTA, now);
+
+#ifdef VELOCITY_DEBUG
+        printf("Timeout: note %d, using default velocity after %lu us\n",
+               note, (unsigned long)time_waiting);
+#endif
+    }
+}
+
+// Panic: end every sounding note and drop the measurements in progress, so
+// nothing measured before it sounds after it. Keys leave the pending list
+// before their state is reset.
+static void all_notes_off(uint32_t now) {
+    accept_time = time_us_32();
+
+    while (pending_head != NOTE_NONE) {
+        uint8_t note = pending_head;
+        pending_timeout_remove(note);
+        set_key_state(note, KEY_IDLE);
+    }
+    note_set_clear(&awaiting_first);
+    note_set_clear(&awaiting_first_late);
+
+    for (uint8_t note = note_set_next(&sounding_notes, 0); note != NOTE_NONE;
+         note = note_set_next(&sounding_notes, note + 1u)) {
+        emit_note_event(note, false, NO_DELTA, now);
+        set_key_state(note, KEY_IDLE);
+    }
+}
+
+// Notes that waited a whole frame for their first sensor in vain
+static void check_awaiting_first(uint32_t now) {
+    for (uint8_t note = note_set_next(&awaiting_first_late, 0); note != NOTE_NONE;
+         note = note_set_next(&awaiting_first_late, note + 1u)) {
+        accept_time = time_us_32();
+        second_without_first(note, now);
+    }
+    awaiting_first_late = awaiting_first;
+    note_set_clear(&awaiting_first);
+}
+
+// ============================================================================
+// DUAL-SENSOR MATRIX SCANNING
+// ============================================================================
+
+#if DEBOUNCE_ENGINE == DEBOUNCE_VERTICAL
+// Step the row's vertical counters with the positions that differ from the
+// debounced state and return the ones that have now differed for
+// DEBOUNCE_SAMPLES scans. Positions that agree again restart from zero.
+static inline uint16_t debounce_row(uint8_t drive, uint16_t changed, uint32_t now) {
+    (void)now;
+    uint16_t lo = debounce_count_lo[drive] & changed;
+    uint16_t hi = debounce_count_hi[drive] & changed;
+
+    // Positions whose count before this scan is DEBOUNCE_SAMPLES - 1
+    uint16_t ready = changed;
+    ready &= ((DEBOUNCE_SAMPLES - 1) & 1) ? lo : (uint16_t)~lo;
+    ready &= ((DEBOUNCE_SAMPLES - 1) & 2) ? hi : (uint16_t)~hi;
+
+    // Count up the rest, clear the accepted ones
+    uint16_t counting = changed & (uint16_t)~ready;
+    debounce_count_hi[drive] = (hi ^ lo) & counting;
+    debounce_count_lo[drive] = (lo ^ counting) & counting;
+    return ready;
+}
+
+// Restart the counts of positions back at the debounced state. debounce_row()
+// does this too, but is not called for a row that no longer differs at all.
+static inline void debounce_forget(uint8_t drive, uint16_t rejected) {
+    debounce_count_lo[drive] &= (uint16_t)~rejected;
+    debounce_count_hi[drive] &= (uint16_t)~rejected;
+}
+#else
+// Return the positions whose last accepted change is at least
+// DEBOUNCE_TIME_US old; the rest still differ next scan and are retried then
+static inline uint16_t debounce_row(uint8_t drive, uint16_t changed, uint32_t now) {
+    uint16_t ready = 0;
+
+    while (changed) {
+        uint8_t read = (uint8_t)__builtin_ctz(changed);
+        changed &= changed - 1; // Clear lowest set bit
+
+        if (now - last_change_time[drive][read] >= DEBOUNCE_TIME_US) {
+            last_change_time[drive][read] = now;
+            ready |= (uint16_t)(1u << read);
+        }
+    }
+    return ready;
+}
+
+// The next differing sample is timed against the last accepted change
+#define debounce_forget(drive, rejected)
+#endif
+
+// Feed accepted positions of one row to the velocity state machine, each
+// timed by when its row was sampled
+static void dispatch_row(uint8_t drive, uint16_t accepted, const uint16_t rows[NUM_DRIVE_PINS],
+                         const uint32_t row_time[NUM_DRIVE_PINS]) {
+    uint32_t now = row_time[drive];
+
+    while (accepted) {
+        uint8_t read = (uint8_t)__builtin_ctz(accepted);
+        accepted &= accepted - 1;
+
+        bool is_pressed = (rows[drive] >> read) & 1;
+
+        // One descriptor says which note and which of its sensors this is
+        const sensor_position_t *pos = sensor_position(drive, read);
+        if (pos->role == SENSOR_NONE) continue;
+
+        // The note's other sensor, if its row was sampled earlier this frame
+        uint8_t partner_drive = pos->partner / NUM_READ_PINS;
+        const uint32_t *partner_time = (int32_t)(row_time[partner_drive] - now) < 0
+                                       ? &row_time[partner_drive] : NULL;
+        if (pos->role == SENSOR_FIRST) {
+            handle_first_sensor(pos->note, is_pressed, now);
+        } else {
+            bool partner_closed = (rows[partner_drive] >> (pos->partner % NUM_READ_PINS)) & 1;
+            handle_second_sensor(pos->note, is_pressed, now, partner_time, partner_closed);
+        }
+    }
+}
+
+#if DEBOUNCE_ENGINE == DEBOUNCE_VERTICAL
+static inline void keep_row(uint8_t drive, const uint16_t rows[NUM_DRIVE_PINS],
+                            const uint32_t row_time[NUM_DRIVE_PINS]) {
+    history_rows[history_index][drive] = rows[drive];
+    history_time[history_index][drive] = row_time[drive];
+}
+
+// The scan that first saw the positions accepted in this one
+static inline uint8_t origin_scan(void) {
+    return (uint8_t)((history_index + 1) % DEBOUNCE_SAMPLES);
+}
+#define ORIGIN_ROWS(rows)           ((void)(rows), history_rows[origin_scan()])
+#define ORIGIN_TIME(row_time)       ((void)(row_time), history_time[origin_scan()])
+#else
+// Timed debounce acts on the first differing sample: this scan
+#define keep_row(drive, rows, row_time)
+#define ORIGIN_ROWS(rows)           (rows)
+#define ORIGIN_TIME(row_time)       (row_time)
+#endif
+
+// Debounce one row word and handle its accepted first sensors at once. The
+// other accepted positions are returned: they wait until every row's first
+// sensors are in, since the second sensor's row may be sampled earlier in the
+// frame (sensor_first_mask marks the first sensors of each row). Only
+// positions that differ from the debounced state are looked at, so an idle
+// row costs one XOR and one compare.
+static uint16_t process_row(uint8_t drive, const uint16_t rows[NUM_DRIVE_PINS],
+                            const uint32_t row_time[NUM_DRIVE_PINS], uint16_t *differed) {
+    keep_row(drive, rows, row_time);
+    uint16_t changed = rows[drive] ^ pressed_rows[drive];
+
+    // Held off last scan and back to the debounced state: a bounce or glitch
+    uint16_t rejected = unaccepted_rows[drive] & (uint16_t)~changed;
+    if (rejected) {
+        stats.debounce_rejects += (uint32_t)__builtin_popcount(rejected);
+        debounce_forget(drive, rejected);
+    }
+    unaccepted_rows[drive] = changed;
+    if (!changed) return 0;
+    *differed |= changed;
+
+    uint16_t accepted = debounce_row(drive, changed, row_time[drive]);
+    unaccepted_rows[drive] = changed & (uint16_t)~accepted;
+    if (!accepted) return 0;
+    pressed_rows[drive] ^= accepted;
+
+    accept_time = time_us_32();
+    dispatch_row(drive, accepted & sensor_first_mask[drive], ORIGIN_ROWS(rows), ORIGIN_TIME(row_time));
+    return accepted & (uint16_t)~sensor_first_mask[drive];
+}
+
+// Handle the positions process_row() held back, once the whole frame is in
+static void dispatch_deferred(const uint16_t deferred[NUM_DRIVE_PINS], const uint16_t rows[NUM_DRIVE_PINS],
+                              const uint32_t row_time[NUM_DRIVE_PINS]) {
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        if (deferred[drive]) dispatch_row(drive, deferred[drive], ORIGIN_ROWS(rows), ORIGIN_TIME(row_time));
+    }
+}
+
+// Per-frame work after every row is processed
+static void end_frame(const uint16_t rows[NUM_DRIVE_PINS], const uint32_t row_time[NUM_DRIVE_PINS],
+                      uint16_t differed) {
+    // Check for timeouts (first sensor triggered but second hasn't responded)
+    PROFILE_BEGIN(timeout_start);
+    check_velocity_timeout(row_time[NUM_DRIVE_PINS - 1]);
+    check_awaiting_first(row_time[NUM_DRIVE_PINS - 1]);
+    PROFILE_END(timeout_start, PROFILE_VELOCITY_TIMEOUT);
+    if (all_notes_off_requested) {
+        all_notes_off_requested = false;
+        all_notes_off(row_time[NUM_DRIVE_PINS - 1]);
+    }
+    keys_moving = differed != 0 || pending_head != NOTE_NONE ||
+                  note_set_next(&awaiting_first_late, 0) != NOTE_NONE;
+#if DEBOUNCE_ENGINE == DEBOUNCE_VERTICAL
+    history_index = (uint8_t)((history_index + 1) % DEBOUNCE_SAMPLES);
+#endif
+
+    stats.frames++;
+    if (frame_events > stats.max_frame_events) stats.max_frame_events = frame_events;
+    frame_events = 0;
+
+    if (frame_tap) frame_tap(rows, row_time);
+}
+
+#if SCAN_PIPELINE
+// Scan entire matrix for both first and second sensors. Each row is processed
+// while the next one settles: the next row is driven as soon as a row is
+// sampled, and only the part of its settle time that processing did not use
+// is busy-waited.
+void scan_matrix(void) {
+    uint16_t rows[NUM_DRIVE_PINS];
+    uint32_t row_time[NUM_DRIVE_PINS];
+    uint16_t deferred[NUM_DRIVE_PINS];
+    uint16_t differed = 0;
+
+    gpio_put(DRIVE0, 1);
+    uint32_t driven = time_us_32();
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        PROFILE_BEGIN(row_start);
+        // Same wait as busy_wait_us_32(settle) from the drive edge
+        uint32_t settled = time_us_32() - driven;
+        if (settled < row_settle_us[drive]) {
+            busy_wait_us_32(row_settle_us[drive] - settled);
+        }
+        uint32_t gpio_state = gpio_get_all();
+        row_time[drive] = time_us_32();
+        gpio_put(DRIVE0 + drive, 0);
+
+        if (drive + 1 < NUM_DRIVE_PINS) {
+            gpio_put(DRIVE0 + drive + 1, 1);
+            driven = time_us_32();
+        }
+
+        rows[drive] = gpio_to_row(gpio_state);
+        deferred[drive] = process_row(drive, rows, row_time, &differed);
+        PROFILE_END(row_start, PROFILE_SCAN_ROW);
+    }
+
+    PROFILE_BEGIN(debounce_start);
+    dispatch_deferred(deferred, rows, row_time);
+    PROFILE_END(debounce_start, PROFILE_DEBOUNCE);
+    end_frame(rows, row_time, differed);
+}
+#else
+// Scan entire matrix for both first and second sensors
+void scan_matrix(void) {
+    // Read all drive rows, each stamped when it was sampled
+    uint16_t rows[NUM_DRIVE_PINS];
+    uint32_t row_time[NUM_DRIVE_PINS];
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        PROFILE_BEGIN(row_start);
+        rows[drive] = scan_row(drive);
+        row_time[drive] = time_us_32();
+        PROFILE_END(row_start, PROFILE_SCAN_ROW);
+    }
+
+    scan_engine_process_frame(rows, row_time);
+}
+#endif
+
+void scan_engine_process_frame(const uint16_t rows[NUM_DRIVE_PINS],
+                               const uint32_t row_time[NUM_DRIVE_PINS]) {
+    // One sample per frame: per-row timing would cost more than the idle rows
+    PROFILE_BEGIN(debounce_start);
+    uint16_t deferred[NUM_DRIVE_PINS];
+    uint16_t differed = 0;
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        deferred[drive] = process_row(drive, rows, row_time, &differed);
+    }
+    dispatch_deferred(deferred, rows, row_time);
+    PROFILE_END(debounce_start, PROFILE_DEBOUNCE);
+
+    end_frame(rows, row_time, differed);
+}
+
+// ============================================================================
+// ENGINE API
+// ============================================================================
+
+void scan_engine_init(note_event_sink_t sink) {
+    event_sink = sink;
+
+    // Clear key states (for debouncing)
+    memset(pressed_rows, 0, sizeof(pressed_rows));
+#if DEBOUNCE_ENGINE == DEBOUNCE_VERTICAL
+    memset(debounce_count_lo, 0, sizeof(debounce_count_lo));
+    memset(debounce_count_hi, 0, sizeof(debounce_count_hi));
+    memset(history_rows, 0, sizeof(history_rows));
+    memset(history_time, 0, sizeof(history_time));
+    history_index = 0;
+#else
+    memset(last_change_time, 0, sizeof(last_change_time));
+#endif
+
+    memcpy(row_settle_us, settle_profile_us, sizeof(row_settle_us));
+
+    // Initialize velocity tracking system
+    init_velocity_system();
+    keys_moving = false;
+
+    memset(unaccepted_rows, 0, sizeof(unaccepted_rows));
+    frame_events = 0;
+    all_notes_off_requested = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void scan_engine_set_settle(uint8_t drive, uint32_t settle_us) {
+    if (drive < NUM_DRIVE_PINS) row_settle_us[drive] = settle_us;
+}
+
+void scan_engine_set_frame_tap(scan_frame_tap_t tap) {
+    frame_tap = tap;
+}
+
+bool scan_engine_any_note_on(void) {
+    return sounding_count != 0;
+}
+
+bool scan_engine_keys_moving(void) {
+    return keys_moving;
+}
+
+bool scan_engine_any_closed(void) {
+    uint16_t closed = 0;
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        closed |= pressed_rows[drive];
+    }
+    return closed != 0;
+}
+
+bool scan_engine_set_velocity_curve(uint8_t curve) {
+    if (curve >= VELOCITY_CURVE_COUNT) return false;
+    velocity_curve = (velocity_curve_t)curve;
+    return true;
+}
+
+uint8_t scan_engine_velocity_curve(void) {
+    return velocity_curve;
+}
+
+void scan_engine_set_early_note_off(bool enabled) {
+    early_note_off = enabled;
+}
+
+bool scan_engine_early_note_off(void) {
+    return early_note_off;
+}
+
+uint32_t scan_engine_sounding_count(void) {
+    return sounding_count;
+}
+
+void scan_engine_sounding_notes(note_set_t *out) {
+    *out = sounding_notes;
+}
+
+void scan_engine_get_stats(scan_engine_stats_t *out) {
+    *out = stats;
+}
+
+void scan_engine_all_notes_off(void) {
+    all_notes_off(time_us_32());
+}
+
+void scan_engine_request_all_notes_off(void) {
+    all_notes_off_requested = true;
+}
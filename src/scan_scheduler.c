@@ -0,0 +1,251 @@
+/*
+ * Scan Scheduler - see scan_scheduler.h
+ */
+
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "keyboard_config.h"
+#include "scan_scheduler.h"
+
+static scan_trigger_t trigger;
+static alarm_pool_t *pool;
+static repeating_timer_t timer;
+
+// Period for the next tick; written by the scanning core, read by the alarm
+static volatile uint32_t period_us;
+
+static uint32_t last_tick_time;
+static bool have_last_tick;         // False until the first tick after (re)start
+static uint32_t last_moving_time;   // Last frame with a key in flight
+
+// Achieved rate: frames counted over one-second windows
+static uint32_t window_start;
+static uint32_t window_frames;
+
+static volatile scan_scheduler_stats_t stats;
+
+#ifdef SCAN_SOF_LOCK
+// SOF grid estimate: time_us_32 of the SOF of frame sof_frame. Written by
+// tud_sof_cb() on the USB core, read by the scanning core.
+static volatile uint32_t sof_time;
+static volatile bool sof_seen;
+static uint32_t sof_frame;
+
+// Moves the next tick scheduled by scan_tick(), then cleared
+static volatile int32_t phase_adjust_us;
+static volatile uint32_t scan_start;  // Last scan started (tick or resume)
+static uint32_t scan_us;            // Last scan's start to frame_done, 0: none yet
+static bool adjust_pending;         // The scan after a correction still ran on the old phase
+static bool was_locked;
+#endif
+
+// Alarm IRQ: start a scan, then schedule the next tick
+static bool scan_tick(repeating_timer_t *rt) {
+    uint32_t now = time_us_32();
+
+    if (have_last_tick) {
+        // Negative delay: ticks are spaced from scheduled time, not callback end
+        uint32_t scheduled = (uint32_t)(-rt->delay_us);
+        uint32_t interval = now - last_tick_time;
+        uint32_t jitter = interval > scheduled ? interval - scheduled : scheduled - interval;
+        if (jitter > stats.max_jitter_us) stats.max_jitter_us = jitter;
+    }
+    last_tick_time = now;
+    have_last_tick = true;
+    stats.ticks++;
+#ifdef SCAN_SOF_LOCK
+    scan_start = now;
+#endif
+
+    if (!trigger()) {
+        stats.overruns++;
+    }
+
+    // Picked up by the alarm pool for the next tick
+#ifdef SCAN_SOF_LOCK
+    rt->delay_us = -((int64_t)period_us + phase_adjust_us);
+    phase_adjust_us = 0;
+#else
+    rt->delay_us = -(int64_t)period_us;
+#endif
+    return true;
+}
+
+#ifdef SCAN_SOF_LOCK
+// TinyUSB SOF callback (tud_sof_cb_enable), from tud_task() on the USB core.
+// The callback is never earlier than its SOF: an early sample moves the
+// estimate straight back, a late one only by 1 us per frame (1000 ppm, well
+// past crystal drift).
+void tud_sof_cb(uint32_t frame_count) {
+    uint32_t now = time_us_32();
+    if (sof_seen) {
+        uint32_t frames = (frame_count - sof_frame) & 0x7FF;
+        uint32_t predicted = sof_time + frames * USB_FRAME_US;
+        if ((int32_t)(now - predicted) > (int32_t)frames) {
+            now = predicted + frames;
+        }
+    }
+    sof_frame = frame_count;
+    sof_time = now;
+    sof_seen = true;
+}
+
+// SOFs arriving: lock periods and phase to them
+static bool sof_locked(uint32_t now) {
+    return sof_seen && (int32_t)(now - sof_time) < SOF_TIMEOUT_US;
+}
+
+static uint32_t full_period(void) {
+    return sof_locked(time_us_32()) ? SCAN_SOF_PERIOD_US : SCAN_PERIOD_US;
+}
+
+static uint32_t idle_period(void) {
+    return sof_locked(time_us_32()) ? SCAN_SOF_IDLE_PERIOD_US : SCAN_IDLE_PERIOD_US;
+}
+
+// How far a scan ending at end_us is from SOF_SCAN_LEAD_US before an SOF,
+// in -499..500 us. sof_time is read once: the USB core may store an SOF
+// after end_us was taken, so end_us - sof is signed.
+static int32_t phase_error(uint32_t end_us) {
+    uint32_t sof = sof_time;
+    int32_t since_sof = (int32_t)(end_us - sof);
+    int32_t error = (since_sof - (USB_FRAME_US - SOF_SCAN_LEAD_US)) % USB_FRAME_US;
+    if (error > USB_FRAME_US / 2) error -= USB_FRAME_US;
+    if (error <= -USB_FRAME_US / 2) error += USB_FRAME_US;
+    return error;
+}
+
+// A scan ended at now: measure its phase error and move the next tick that
+// is not scheduled yet by it
+static void lock_phase(uint32_t now) {
+    scan_us = now - scan_start;
+    if (!sof_locked(now)) {
+        was_locked = false;
+        adjust_pending = false;
+        return;
+    }
+
+    int32_t error = phase_error(now);
+
+    uint32_t magnitude = (uint32_t)(error < 0 ? -error : error);
+    stats.sof_phase_error_us = error;
+    if (was_locked && magnitude > stats.sof_max_error_us) {
+        stats.sof_max_error_us = magnitude;
+    }
+    was_locked = magnitude <= SOF_LOCK_TOLERANCE_US;
+    if (was_locked) stats.sof_locked++; else stats.sof_unlocked++;
+
+    // The tick for the scan after this one is already scheduled: correct
+    // every other scan so one error is not applied twice
+    if (adjust_pending) {
+        adjust_pending = false;
+    } else if (error != 0) {
+        phase_adjust_us = -error;
+        adjust_pending = true;
+    }
+}
+#else
+static uint32_t full_period(void) {
+    return SCAN_PERIOD_US;
+}
+
+static uint32_t idle_period(void) {
+    return SCAN_IDLE_PERIOD_US;
+}
+#endif // SCAN_SOF_LOCK
+
+// (Re)start the alarm; the first tick is one period from now, moved while
+// locked so a scan as long as the last one ends on the SOF target
+static void start_timer(uint32_t period) {
+    period_us = period;
+    have_last_tick = false;
+    int64_t first = period;
+#ifdef SCAN_SOF_LOCK
+    uint32_t now = time_us_32();
+    if (scan_us && sof_locked(now)) {
+        first -= phase_error(now + period + scan_us);
+        phase_adjust_us = 0;
+        adjust_pending = false;
+    }
+#endif
+    alarm_pool_add_repeating_timer_us(pool, -first, scan_tick, NULL, &timer);
+}
+
+void scan_scheduler_init(scan_trigger_t scan_trigger) {
+    trigger = scan_trigger;
+    memset((void *)&stats, 0, sizeof(stats));
+
+    last_moving_time = time_us_32();
+    window_start = last_moving_time;
+    window_frames = 0;
+#ifdef SCAN_SOF_LOCK
+    phase_adjust_us = 0;
+    adjust_pending = false;
+    was_locked = false;
+    scan_start = last_moving_time;
+    scan_us = 0;
+#endif
+
+    // A pool owned by this core, so the tick IRQ runs where scanning runs
+    if (!pool) {
+        pool = alarm_pool_create_with_unused_hardware_alarm(2);
+    }
+    start_timer(full_period());
+}
+
+void scan_scheduler_frame_done(bool keys_moving) {
+    uint32_t now = time_us_32();
+
+#ifdef SCAN_SOF_LOCK
+    lock_phase(now);
+#endif
+
+    if (keys_moving) {
+        last_moving_time = now;
+        if (period_us != full_period()) {
+            // Waking from idle: don't wait out the idle tick already queued,
+            // the second sensor of this press needs full-rate timing
+            cancel_repeating_timer(&timer);
+            start_timer(full_period());
+        }
+    } else if (now - last_moving_time >= SCAN_IDLE_AFTER_US) {
+        period_us = idle_period();
+    } else {
+        // SOFs may have started or stopped since the last scan
+        period_us = full_period();
+    }
+
+    window_frames++;
+    uint32_t elapsed = now - window_start;
+    if (elapsed >= 1000000) {
+        stats.rate_hz = (uint32_t)(((uint64_t)window_frames * 1000000 + elapsed / 2) / elapsed);
+        window_start = now;
+        window_frames = 0;
+    }
+}
+
+void scan_scheduler_pause(void) {
+    cancel_repeating_timer(&timer);
+}
+
+void scan_scheduler_resume(void) {
+    last_moving_time = time_us_32();
+    stats.ticks++;
+#ifdef SCAN_SOF_LOCK
+    scan_start = last_moving_time;
+#endif
+    if (!trigger()) {
+        stats.overruns++;
+    }
+    start_timer(full_period());
+}
+
+uint32_t scan_scheduler_rate_hz(void) {
+    return stats.rate_hz;
+}
+
+void scan_scheduler_get_stats(scan_scheduler_stats_t *out) {
+    memcpy(out, (const void *)&stats, sizeof(*out));
+    out->period_us = period_us;
+}
@@ -0,0 +1,129 @@
+/*
+ * SysEx Commands - see sysex.h
+ */
+
+#include "health.h"
+#include "latency_hist.h"
+#include "midi_out.h"
+#include "profiler.h"
+#include "sysex.h"
+#include "trace_capture.h"
+
+// Header + stage + bucket count + counts + F7
+#define LATENCY_RESPONSE_LEN  (3 + 2 + LATENCY_HIST_BUCKETS * 5 + 1)
+
+// Header + phase + five values + F7
+#define PROFILE_RESPONSE_LEN  (3 + 1 + 5 * 5 + 1)
+
+// Header + counter count + counters + F7
+#define HEALTH_RESPONSE_LEN   (3 + 1 + HEALTH_COUNTER_COUNT * 5 + 1)
+
+static void send_latency_dump(void) {
+    for (uint8_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        uint8_t msg[LATENCY_RESPONSE_LEN];
+        uint32_t len = 0;
+
+        msg[len++] = SYSEX_START;
+        msg[len++] = SYSEX_MANUFACTURER_ID;
+        msg[len++] = SYSEX_CMD_LATENCY_DUMP | SYSEX_RESPONSE;
+        msg[len++] = stage;
+        msg[len++] = LATENCY_HIST_BUCKETS;
+
+        const uint32_t *counts = latency_hist_counts((latency_stage_t)stage);
+        for (uint8_t bucket = 0; bucket < LATENCY_HIST_BUCKETS; bucket++) {
+            len += sysex_put_u32(&msg[len], counts[bucket]);
+        }
+        msg[len++] = SYSEX_END;
+
+        midi_out_sysex(msg, len);
+    }
+}
+
+#ifdef PROFILE_ENABLED
+static void send_profile_dump(void) {
+    for (uint8_t phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+        profile_stats_t stats;
+        profile_get_stats((profile_phase_t)phase, &stats);
+
+        uint8_t msg[PROFILE_RESPONSE_LEN];
+        uint32_t len = 0;
+
+        msg[len++] = SYSEX_START;
+        msg[len++] = SYSEX_MANUFACTURER_ID;
+        msg[len++] = SYSEX_CMD_PROFILE_DUMP | SYSEX_RESPONSE;
+        msg[len++] = phase;
+        len += sysex_put_u32(&msg[len], stats.count);
+        len += sysex_put_u32(&msg[len], stats.min_cycles);
+        len += sysex_put_u32(&msg[len], stats.mean_cycles);
+        len += sysex_put_u32(&msg[len], stats.max_cycles);
+        len += sysex_put_u32(&msg[len], stats.p99_cycles);
+        msg[len++] = SYSEX_END;
+
+        midi_out_sysex(msg, len);
+    }
+}
+#endif // PROFILE_ENABLED
+
+static void send_health_dump(void) {
+    uint32_t counters[HEALTH_COUNTER_COUNT];
+    health_read(counters);
+
+    uint8_t msg[HEALTH_RESPONSE_LEN];
+    uint32_t len = 0;
+
+    msg[len++] = SYSEX_START;
+    msg[len++] = SYSEX_MANUFACTURER_ID;
+    msg[len++] = SYSEX_CMD_HEALTH_DUMP | SYSEX_RESPONSE;
+    msg[len++] = HEALTH_COUNTER_COUNT;
+    for (uint8_t i = 0; i < HEALTH_COUNTER_COUNT; i++) {
+        len += sysex_put_u32(&msg[len], counters[i]);
+    }
+    msg[len++] = SYSEX_END;
+
+    midi_out_sysex(msg, len);
+}
+
+static void send_empty_response(uint8_t command) {
+    uint8_t msg[] = { SYSEX_START, SYSEX_MANUFACTURER_ID, command | SYSEX_RESPONSE, SYSEX_END };
+    midi_out_sysex(msg, sizeof(msg));
+}
+
+void sysex_handle(const uint8_t *msg, uint32_t len) {
+    if (len < 4 || msg[0] != SYSEX_START || msg[1] != SYSEX_MANUFACTURER_ID ||
+        msg[len - 1] != SYSEX_END) {
+        return;  // Not ours
+    }
+
+    switch (msg[2]) {
+    case SYSEX_CMD_LATENCY_DUMP:
+        send_latency_dump();
+        break;
+    case SYSEX_CMD_LATENCY_CLEAR:
+        latency_hist_clear();
+        send_empty_response(SYSEX_CMD_LATENCY_CLEAR);
+        break;
+#ifdef PROFILE_ENABLED
+    case SYSEX_CMD_PROFILE_DUMP:
+        send_profile_dump();
+        break;
+    case SYSEX_CMD_PROFILE_CLEAR:
+        profile_clear();
+        send_empty_response(SYSEX_CMD_PROFILE_CLEAR);
+        break;
+#endif
+#ifdef TRACE_CAPTURE
+    // Replies come from trace_capture_task()
+    case SYSEX_CMD_TRACE_START:
+        trace_capture_start();
+        break;
+    case SYSEX_CMD_TRACE_STOP:
+        trace_capture_stop();
+        break;
+#endif
+    case SYSEX_CMD_HEALTH_DUMP:
+        send_health_dump();
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,239 @@
+/*
+ * Matrix Trace Capture - see trace_capture.h
+ *
+ * Start and stop cross the cores as a generation counter written only by
+ * core0 (odd while capturing) and the generation the frame tap last acted on,
+ * written only by the scanning core. Records cross in a single-producer /
+ * single-consumer ring like note_queue.h.
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+#include "hardware/sync.h"
+#include "midi_out.h"
+#include "sysex.h"
+#include "trace_capture.h"
+
+#define TRACE_CAPTURE_MASK  (TRACE_CAPTURE_RECORDS - 1)
+
+// Header + kind + offsets + F7
+#define HEADER_MSG_LEN  (3 + 1 + NUM_DRIVE_PINS * 5 + 1)
+
+// Header + kind + time, skipped, period + two bytes per row + F7
+#define FRAME_MSG_LEN   (3 + 1 + 3 * 5 + NUM_DRIVE_PINS * 2 + 1)
+
+// Header + frames, records, dropped + F7
+#define STOP_MSG_LEN    (3 + 3 * 5 + 1)
+
+// Trace messages only fill half the MIDI output backlog, so note events
+// queued behind them are never dropped for lack of space
+#define BACKLOG_LIMIT   (MIDI_OUT_BACKLOG_PACKETS / 2)
+
+typedef struct {
+    uint32_t time_us;       // Row 0 sample time
+    uint32_t skipped;       // Unchanged frames since the previous record
+    uint32_t period_us;     // Interval between those frames
+    uint16_t rows[NUM_DRIVE_PINS];
+} trace_record_t;
+
+static trace_record_t ring[TRACE_CAPTURE_RECORDS];
+static _Atomic uint32_t ring_head;      // Scanning core only
+static _Atomic uint32_t ring_tail;      // Core0 only
+
+static _Atomic uint32_t capture_gen;    // Core0 only; odd while capturing
+static _Atomic uint32_t tap_gen;        // Scanning core only
+
+// Scanning core state of the capture in progress
+static uint16_t last_rows[NUM_DRIVE_PINS];
+static uint32_t last_time;
+static uint32_t period_us;
+static uint32_t skipped;
+
+// Written by the scanning core while capturing, read by core0 once it stops
+static uint32_t row_offset_us[NUM_DRIVE_PINS];
+static uint32_t frames;
+static uint32_t records;
+static uint32_t dropped;
+
+// Core0 state
+static bool header_sent;
+static bool stop_pending;
+
+// ============================================================================
+// SCANNING CORE
+// ============================================================================
+
+static void push_record(const uint16_t rows[NUM_DRIVE_PINS], uint32_t time_us) {
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+    if (head - tail >= TRACE_CAPTURE_RECORDS) {
+        dropped++;
+        return;
+    }
+
+    trace_record_t *rec = &ring[head & TRACE_CAPTURE_MASK];
+    rec->time_us = time_us;
+    rec->skipped = skipped;
+    rec->period_us = period_us;
+    memcpy(rec->rows, rows, sizeof(rec->rows));
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+    records++;
+}
+
+void trace_capture_frame(const uint16_t rows[NUM_DRIVE_PINS],
+                         const uint32_t row_time[NUM_DRIVE_PINS]) {
+    uint32_t gen = atomic_load_explicit(&capture_gen, memory_order_acquire);
+    uint32_t seen = atomic_load_explicit(&tap_gen, memory_order_relaxed);
+    bool capturing = seen & 1;
+    if (gen == seen && !capturing) return;
+
+    uint32_t now = row_time[0];
+    if (gen != seen && !capturing) {
+        // Started: the first frame always goes out and sets the row offsets
+        if (gen & 1) {
+            for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+                row_offset_us[drive] = row_time[drive] - now;
+            }
+            skipped = 0;
+            period_us = 0;
+            frames = 1;
+            push_record(rows, now);
+            memcpy(last_rows, rows, sizeof(last_rows));
+            last_time = now;
+        }
+        atomic_store_explicit(&tap_gen, gen, memory_order_release);
+        return;
+    }
+
+    frames++;
+    uint32_t interval = now - last_time;
+    last_time = now;
+
+    // Stopped: this frame closes the trace
+    bool stopping = gen != seen;
+    bool same_period = interval - period_us + TRACE_CAPTURE_JITTER_US <= 2 * TRACE_CAPTURE_JITTER_US;
+    if (!stopping && same_period && memcmp(rows, last_rows, sizeof(last_rows)) == 0) {
+        skipped++;
+        return;
+    }
+
+    push_record(rows, now);
+    memcpy(last_rows, rows, sizeof(last_rows));
+    skipped = 0;
+    period_us = interval;
+
+    if (stopping) atomic_store_explicit(&tap_gen, gen, memory_order_release);
+}
+
+bool trace_capture_active(void) {
+    uint32_t gen = atomic_load_explicit(&capture_gen, memory_order_acquire);
+    return (gen & 1) || atomic_load_explicit(&tap_gen, memory_order_acquire) != gen;
+}
+
+// ============================================================================
+// CORE0
+// ============================================================================
+
+void trace_capture_start(void) {
+    uint32_t gen = atomic_load_explicit(&capture_gen, memory_order_relaxed);
+    if ((gen & 1) || stop_pending ||
+        atomic_load_explicit(&tap_gen, memory_order_acquire) != gen) {
+        return;     // Already capturing, or the last capture is still flushing
+    }
+
+    frames = 0;
+    records = 0;
+    dropped = 0;
+    header_sent = false;
+    atomic_store_explicit(&capture_gen, gen + 1, memory_order_release);
+    __sev();    // A parked scanner resumes for the capture
+}
+
+void trace_capture_stop(void) {
+    uint32_t gen = atomic_load_explicit(&capture_gen, memory_order_relaxed);
+    if (gen & 1) atomic_store_explicit(&capture_gen, gen + 1, memory_order_release);
+    stop_pending = true;
+    __sev();
+}
+
+// True if a message of len bytes fits under BACKLOG_LIMIT
+static bool backlog_room(uint32_t len) {
+    return midi_out_backlog() + (len + 2) / 3 <= BACKLOG_LIMIT;
+}
+
+static bool send_header(void) {
+    if (!backlog_room(HEADER_MSG_LEN)) return false;
+
+    uint8_t msg[HEADER_MSG_LEN];
+    uint32_t len = 0;
+
+    msg[len++] = SYSEX_START;
+    msg[len++] = SYSEX_MANUFACTURER_ID;
+    msg[len++] = SYSEX_CMD_TRACE_START | SYSEX_RESPONSE;
+    msg[len++] = TRACE_CAPTURE_HEADER;
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        len += sysex_put_u32(&msg[len], row_offset_us[drive]);
+    }
+    msg[len++] = SYSEX_END;
+
+    return midi_out_sysex(msg, len);
+}
+
+static bool send_record(const trace_record_t *rec) {
+    if (!backlog_room(FRAME_MSG_LEN)) return false;
+
+    uint8_t msg[FRAME_MSG_LEN];
+    uint32_t len = 0;
+
+    msg[len++] = SYSEX_START;
+    msg[len++] = SYSEX_MANUFACTURER_ID;
+    msg[len++] = SYSEX_CMD_TRACE_START | SYSEX_RESPONSE;
+    msg[len++] = TRACE_CAPTURE_FRAME;
+    len += sysex_put_u32(&msg[len], rec->time_us);
+    len += sysex_put_u32(&msg[len], rec->skipped);
+    len += sysex_put_u32(&msg[len], rec->period_us);
+    for (uint8_t drive = 0; drive < NUM_DRIVE_PINS; drive++) {
+        msg[len++] = (uint8_t)(rec->rows[drive] & 0x7F);
+        msg[len++] = (uint8_t)(rec->rows[drive] >> 7);
+    }
+    msg[len++] = SYSEX_END;
+
+    return midi_out_sysex(msg, len);
+}
+
+static bool send_stop_reply(void) {
+    if (!backlog_room(STOP_MSG_LEN)) return false;
+
+    uint8_t msg[STOP_MSG_LEN];
+    uint32_t len = 0;
+
+    msg[len++] = SYSEX_START;
+    msg[len++] = SYSEX_MANUFACTURER_ID;
+    msg[len++] = SYSEX_CMD_TRACE_STOP | SYSEX_RESPONSE;
+    len += sysex_put_u32(&msg[len], frames);
+    len += sysex_put_u32(&msg[len], records);
+    len += sysex_put_u32(&msg[len], dropped);
+    msg[len++] = SYSEX_END;
+
+    return midi_out_sysex(msg, len);
+}
+
+void trace_capture_task(void) {
+    // A message the backlog has no room for stays queued for the next pass
+    uint32_t tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    while (tail != atomic_load_explicit(&ring_head, memory_order_acquire)) {
+        if (!header_sent) {
+            if (!send_header()) return;
+            header_sent = true;
+        }
+        if (!send_record(&ring[tail & TRACE_CAPTURE_MASK])) return;
+        atomic_store_explicit(&ring_tail, ++tail, memory_order_release);
+    }
+
+    // Reply to a stop once the closing frame is queued and sent
+    uint32_t gen = atomic_load_explicit(&capture_gen, memory_order_relaxed);
+    if (stop_pending && atomic_load_explicit(&tap_gen, memory_order_acquire) == gen &&
+        tail == atomic_load_explicit(&ring_head, memory_order_acquire) && send_stop_reply()) {
+        stop_pending = false;
+    }
+}
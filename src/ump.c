@@ -0,0 +1,105 @@
+/*
+ * Universal MIDI Packets - see ump.h
+ */
+
+#include <string.h>
+#include "keyboard_config.h"
+#include "ump.h"
+
+#ifdef MIDI_UMP_ENABLED
+
+#define STATUS_NOTE_OFF     0x80
+#define STATUS_NOTE_ON      0x90
+
+uint32_t ump_message_words(uint32_t word0) {
+    // By message type: 32, 64, 96 or 128 bits
+    static const uint8_t words[16] = { 1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4 };
+    return words[ump_type(word0)];
+}
+
+bool ump_is_note(uint32_t word0) {
+    uint8_t type = ump_type(word0);
+    uint8_t status = (uint8_t)((word0 >> 16) & 0xE0);
+    return (type == UMP_MT_MIDI1 || type == UMP_MT_MIDI2) && status == STATUS_NOTE_OFF;
+}
+
+uint32_t ump_midi1(uint8_t status, uint8_t data1, uint8_t data2) {
+    return (uint32_t)UMP_MT_MIDI1 << 28 | (uint32_t)status << 16 |
+           (uint32_t)(data1 & 0x7F) << 8 | (data2 & 0x7F);
+}
+
+void ump_midi2_note(uint8_t status, uint8_t note, uint16_t velocity,
+                    uint8_t attr_type, uint16_t attr_data, uint32_t words[2]) {
+    words[0] = (uint32_t)UMP_MT_MIDI2 << 28 | (uint32_t)status << 16 |
+               (uint32_t)(note & 0x7F) << 8 | attr_type;
+    words[1] = (uint32_t)velocity << 16 | attr_data;
+}
+
+uint32_t ump_note_event(const note_event_t *ev, uint8_t protocol, bool attr,
+                        uint32_t words[UMP_MAX_WORDS]) {
+    uint8_t msg[3];
+    note_event_to_midi(ev, msg);
+    if (protocol != UMP_PROTOCOL_MIDI2) {
+        words[0] = ump_midi1(msg[0], msg[1], msg[2]);
+        return 1;
+    }
+
+    bool delta = attr && (ev->flags & NOTE_EVENT_MEASURED);
+    ump_midi2_note(msg[0], msg[1], ev->velocity16,
+                   delta ? UMP_ATTR_MANUFACTURER : UMP_ATTR_NONE,
+                   delta ? ev->sensor_delta : 0, words);
+    return 2;
+}
+
+void ump_sysex7(uint8_t status, const uint8_t *data, uint32_t count, uint32_t words[2]) {
+    uint8_t bytes[UMP_SYSEX_BYTES] = { 0 };
+    memcpy(bytes, data, count);
+
+    words[0] = (uint32_t)UMP_MT_DATA64 << 28 | (uint32_t)status << 20 | count << 16 |
+               (uint32_t)bytes[0] << 8 | bytes[1];
+    words[1] = (uint32_t)bytes[2] << 24 | (uint32_t)bytes[3] << 16 |
+               (uint32_t)bytes[4] << 8 | bytes[5];
+}
+
+uint32_t ump_sysex7_bytes(const uint32_t words[2], uint8_t *status, uint8_t out[UMP_SYSEX_BYTES]) {
+    uint32_t count = (words[0] >> 16) & 0x0F;
+    if (count > UMP_SYSEX_BYTES) count = UMP_SYSEX_BYTES;
+
+    *status = (uint8_t)((words[0] >> 20) & 0x0F);
+    out[0] = (uint8_t)(words[0] >> 8);
+    out[1] = (uint8_t)words[0];
+    out[2] = (uint8_t)(words[1] >> 24);
+    out[3] = (uint8_t)(words[1] >> 16);
+    out[4] = (uint8_t)(words[1] >> 8);
+    out[5] = (uint8_t)words[1];
+    for (uint32_t i = 0; i < count; i++) out[i] &= 0x7F;
+    return count;
+}
+
+// First word of a format-0 (complete) UMP Stream message
+static uint32_t stream_word0(uint16_t status) {
+    return (uint32_t)UMP_MT_STREAM << 28 | (uint32_t)status << 16;
+}
+
+void ump_endpoint_info(uint8_t protocols, uint32_t words[4]) {
+    words[0] = stream_word0(UMP_STREAM_ENDPOINT_INFO) | 0x01 << 8 | 0x01;  // UMP 1.1
+    words[1] = (uint32_t)(protocols & (UMP_PROTOCOL_MIDI1 | UMP_PROTOCOL_MIDI2)) << 8;
+    words[2] = 0;
+    words[3] = 0;
+}
+
+void ump_stream_config_notify(uint8_t protocol, uint32_t words[4]) {
+    words[0] = stream_word0(UMP_STREAM_CONFIG_NOTIFY) | (uint32_t)protocol << 8;
+    words[1] = 0;
+    words[2] = 0;
+    words[3] = 0;
+}
+
+void ump_stream_config_request(uint8_t protocol, uint32_t words[4]) {
+    words[0] = stream_word0(UMP_STREAM_CONFIG_REQUEST) | (uint32_t)protocol << 8;
+    words[1] = 0;
+    words[2] = 0;
+    words[3] = 0;
+}
+
+#endif // MIDI_UMP_ENABLED
@@ -24,6 +24,8 @@
  */
 
 #include "tusb.h"
+#include "device/usbd.h"
+#include "midi_out.h"
 
 /* A combination of interfaces must have a unique product id, since PC will save device driver after the first plug.
  * Same VID/PID with different interface e.g MSC (first), then CDC (later) will possibly cause system error on PC.
@@ -88,6 +90,21 @@ enum
   #define EPNUM_MIDI   0x01
 #endif
 
+// Used by midi_out.c to tell when written packets have reached the host
+// (usbd_edpt_busy() is part of the public endpoint API in device/usbd.h)
+bool usb_midi_tx_busy(void)
+{
+  return usbd_edpt_busy(0, 0x80 | EPNUM_MIDI);
+}
+
+// The TinyUSB bundled with Pico SDK 2.2 has no USB-MIDI 2.0 class driver,
+// so the descriptors only offer alternate setting 0 and nothing here
+// implements usb_midi_ump_*() (midi_out.h). MIDI_UMP_ENABLED is for the
+// simulator until a driver and an alternate setting 1 descriptor exist.
+#ifdef MIDI_UMP_ENABLED
+#error "MIDI_UMP_ENABLED needs a USB-MIDI 2.0 class driver (usb_midi_ump_*)"
+#endif
+
 uint8_t const desc_fs_configuration[] =
 {
   // Config number, interface count, string index, total length, attribute, power in mA
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""
+Sensor Position Table Generator
+
+Reads first_sensor_map and second_sensor_map from include/note_map.h and
+writes the inverted per-position table used by the scan engine: for every
+matrix position, the note it belongs to, which sensor it is, and where the
+note's other sensor sits, plus a per-row mask of the first-sensor columns.
+
+Also validates the wiring: every mapped note must have exactly one first
+sensor and exactly one second sensor, and no position may be both. Any
+problem is reported and the script exits non-zero, which fails the build.
+
+Run by CMake at build time; no third-party packages needed.
+
+Usage: gen_position_table.py <note_map.h> <output.h>
+"""
+
+import re
+import sys
+from typing import Dict, List, Tuple
+
+NUM_DRIVE_PINS = 12
+NUM_READ_PINS = 12
+NOTE_NONE = 0xFF
+
+# Must match the SENSOR_* roles in include/sensor_positions.h
+SENSOR_NONE = 0
+SENSOR_FIRST = 1
+SENSOR_SECOND = 2
+
+
+def parse_note_defines(source: str) -> Dict[str, int]:
+    """Collect '#define NAME <number>' note names (C4, Fs4, NOTE_NONE, ...)."""
+    defines = {}
+    for match in re.finditer(r"^#define\s+(\w+)\s+(0x[0-9A-Fa-f]+|\d+)", source, re.MULTILINE):
+        defines[match.group(1)] = int(match.group(2), 0)
+    return defines
+
+
+def parse_map(source: str, name: str, defines: Dict[str, int]) -> List[List[int]]:
+    """Parse one 'static const uint8_t <name>[..][..] = { {..}, .. };' array."""
+    start = re.search(r"static const uint8_t " + name + r"\s*\[[^\]]*\]\s*\[[^\]]*\]\s*=\s*\{", source)
+    if not start:
+        raise ValueError(f"{name} not found")
+
+    body = source[start.end():source.index("};", start.end())]
+    body = re.sub(r"/\*.*?\*/", "", body, flags=re.DOTALL)
+    body = re.sub(r"//[^\n]*", "", body)
+
+    rows = []
+    for row_text in re.findall(r"\{([^{}]*)\}", body):
+        row = []
+        for token in row_text.split(","):
+            token = token.strip()
+            if not token:
+                continue
+            if token in defines:
+                row.append(defines[token])
+            else:
+                row.append(int(token, 0))
+        if len(row) != NUM_READ_PINS:
+            raise ValueError(f"{name} row {len(rows)} has {len(row)} columns, expected {NUM_READ_PINS}")
+        rows.append(row)
+
+    if len(rows) != NUM_DRIVE_PINS:
+        raise ValueError(f"{name} has {len(rows)} rows, expected {NUM_DRIVE_PINS}")
+    return rows
+
+
+def build_table(first: List[List[int]], second: List[List[int]]) -> Tuple[List[Tuple[int, int, int]], List[str]]:
+    """Return (per-position (note, role, partner) list, list of wiring errors)."""
+    first_pos: Dict[int, List[Tuple[int, int]]] = {}
+    second_pos: Dict[int, List[Tuple[int, int]]] = {}
+    errors = []
+
+    for drive in range(NUM_DRIVE_PINS):
+        for read in range(NUM_READ_PINS):
+            f, s = first[drive][read], second[drive][read]
+            if f != NOTE_NONE and s != NOTE_NONE:
+                errors.append(f"position [{drive},{read}] is both first sensor of note {f} "
+                              f"and second sensor of note {s}")
+            if f != NOTE_NONE:
+                first_pos.setdefault(f, []).append((drive, read))
+            if s != NOTE_NONE:
+                second_pos.setdefault(s, []).append((drive, read))
+
+    for note in sorted(set(first_pos) | set(second_pos)):
+        firsts = first_pos.get(note, [])
+        seconds = second_pos.get(note, [])
+        if len(firsts) != 1 or len(seconds) != 1:
+            errors.append(f"note {note} has {len(firsts)} first sensor(s) {firsts} and "
+                          f"{len(seconds)} second sensor(s) {seconds}, expected one of each")
+
+    table = []
+    for drive in range(NUM_DRIVE_PINS):
+        for read in range(NUM_READ_PINS):
+            f, s = first[drive][read], second[drive][read]
+            if f != NOTE_NONE and len(second_pos.get(f, [])) == 1:
+                d, r = second_pos[f][0]
+                table.append((f, SENSOR_FIRST, d * NUM_READ_PINS + r))
+            elif s != NOTE_NONE and len(first_pos.get(s, [])) == 1:
+                d, r = first_pos[s][0]
+                table.append((s, SENSOR_SECOND, d * NUM_READ_PINS + r))
+            else:
+                table.append((NOTE_NONE, SENSOR_NONE, NOTE_NONE))
+
+    return table, errors
+
+
+def write_header(table: List[Tuple[int, int, int]], path: str):
+    role_names = {SENSOR_NONE: "SENSOR_NONE", SENSOR_FIRST: "SENSOR_FIRST", SENSOR_SECOND: "SENSOR_SECOND"}
+
+    lines = [
+        "/*",
+        " * Sensor Position Table",
+        " *",
+        " * GENERATED by tools/gen_position_table.py from include/note_map.h - do not edit.",
+        " * Index: drive * NUM_READ_PINS + read. See include/sensor_positions.h.",
+        " */",
+        "",
+        "#ifndef SENSOR_POSITIONS_TABLE_H",
+        "#define SENSOR_POSITIONS_TABLE_H",
+        "",
+        "static const sensor_position_t sensor_position_table[NUM_DRIVE_PINS * NUM_READ_PINS] = {",
+    ]
+    for drive in range(NUM_DRIVE_PINS):
+        lines.append(f"    /* Row {drive:2d} */")
+        for read in range(NUM_READ_PINS):
+            note, role, partner = table[drive * NUM_READ_PINS + read]
+            lines.append(f"    {{ {note:3d}, {role_names[role]:<13}, {partner:3d}, 0 }},  // [{drive},{read}]")
+    lines += [
+        "};",
+        "",
+        "// Read columns holding a first sensor, per drive row",
+        "static const uint16_t sensor_first_mask[NUM_DRIVE_PINS] = {",
+    ]
+    for drive in range(NUM_DRIVE_PINS):
+        mask = sum(1 << read for read in range(NUM_READ_PINS)
+                   if table[drive * NUM_READ_PINS + read][1] == SENSOR_FIRST)
+        lines.append(f"    0x{mask:03X},  // Row {drive}")
+    lines += [
+        "};",
+        "",
+        "#endif // SENSOR_POSITIONS_TABLE_H",
+        "",
+    ]
+
+    with open(path, "w") as f:
+        f.write("\n".join(lines))
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip().splitlines()[-1])
+        sys.exit(2)
+
+    source = open(sys.argv[1]).read()
+    defines = parse_note_defines(source)
+    first = parse_map(source, "first_sensor_map", defines)
+    second = parse_map(source, "second_sensor_map", defines)
+
+    table, errors = build_table(first, second)
+    if errors:
+        print(f"{sys.argv[1]}: sensor map errors:", file=sys.stderr)
+        for error in errors:
+            print(f"  {error}", file=sys.stderr)
+        sys.exit(1)
+
+    write_header(table, sys.argv[2])
+
+
+if __name__ == "__main__":
+    main()
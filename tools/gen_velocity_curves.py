@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""
+Velocity Curve Table Generator
+
+Precomputes the velocity curves used by the scan engine. Each curve maps the
+first-to-second sensor delta, quantized to 2^VELOCITY_CURVE_SHIFT us steps
+between VELOCITY_MIN_TIME_US and VELOCITY_MAX_TIME_US, to a MIDI velocity
+1-127, so a note-on needs one table read instead of 64-bit arithmetic.
+
+Each curve also gets a 16-bit table for MIDI 2.0 note velocity (ump.h),
+interpolated between steps by velocity_curve_lookup16(). Its entries are the
+same curve at 65535 full scale, kept within the 7-bit entry's range
+(v16 >> 9 == v7) so MIDI 2.0 to 1.0 translation gives the 7-bit table.
+
+Timing constants are read from include/keyboard_config.h so the table always
+matches the firmware configuration.
+
+Curves (x = 0 fastest press .. 1 slowest, t = 1 - x):
+  linear       t                            (same as the old calculate_velocity)
+  logarithmic  log(1 + k*t) / log(1 + k)    loud quickly, less range at the top
+  exponential  (e^(k*t) - 1) / (e^k - 1)    soft for longer, loud only when fast
+  s-curve      3t^2 - 2t^3                  compressed at both ends
+
+Run by CMake at build time; no third-party packages needed.
+
+Usage: gen_velocity_curves.py <keyboard_config.h> <output.h>
+"""
+
+import math
+import re
+import sys
+from typing import Dict, List
+
+# Order must match the velocity_curve_t enum in include/velocity_curves.h
+CURVES = ["linear", "logarithmic", "exponential", "s-curve"]
+
+# Shape parameter for the logarithmic and exponential curves
+CURVE_K = 4.0
+
+
+def parse_defines(path: str) -> Dict[str, int]:
+    defines = {}
+    for line in open(path):
+        match = re.match(r"\s*#define\s+(\w+)\s+(\d+)\b", line)
+        if match:
+            defines[match.group(1)] = int(match.group(2))
+    return defines
+
+
+def shape(curve: str, t: float) -> float:
+    if curve == "linear":
+        return t
+    if curve == "logarithmic":
+        return math.log1p(CURVE_K * t) / math.log1p(CURVE_K)
+    if curve == "exponential":
+        return math.expm1(CURVE_K * t) / math.expm1(CURVE_K)
+    if curve == "s-curve":
+        return 3 * t * t - 2 * t * t * t
+    raise ValueError(curve)
+
+
+def curve_value(curve: str, offset: int, span: int) -> float:
+    """Unquantized velocity 1.0-127.0 at offset us past the fastest press."""
+    if offset >= span:
+        return 1.0
+    t = 1.0 - offset / span
+    return 1 + 126 * shape(curve, t)
+
+
+def build_curve(curve: str, min_us: int, max_us: int, shift: int, steps: int) -> List[int]:
+    span = max_us - min_us
+    table = []
+    for i in range(steps):
+        offset = i << shift
+        if offset >= span:
+            table.append(1)   # Slowest (but not 0, which can mean Note Off)
+            continue
+        if curve == "linear":
+            # Integer formula of the original calculate_velocity()
+            table.append(127 - (offset * 126) // span)
+            continue
+        table.append(max(1, min(127, int(round(curve_value(curve, offset, span))))))
+    return table
+
+
+def build_curve16(curve: str, table: List[int], shift: int, span: int) -> List[int]:
+    """16-bit velocities at the same steps, within each 7-bit entry's range."""
+    table16 = []
+    for i, v7 in enumerate(table):
+        v16 = int(round(curve_value(curve, i << shift, span) * 65535 / 127))
+        table16.append(max(v7 << 9, min((v7 << 9) | 511, v16)))
+    return table16
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip().splitlines()[-1])
+        sys.exit(2)
+
+    defines = parse_defines(sys.argv[1])
+    try:
+        min_us = defines["VELOCITY_MIN_TIME_US"]
+        max_us = defines["VELOCITY_MAX_TIME_US"]
+        shift = defines["VELOCITY_CURVE_SHIFT"]
+    except KeyError as missing:
+        print(f"{sys.argv[1]}: {missing} not defined", file=sys.stderr)
+        sys.exit(1)
+    if max_us <= min_us:
+        print(f"{sys.argv[1]}: VELOCITY_MAX_TIME_US must be above VELOCITY_MIN_TIME_US", file=sys.stderr)
+        sys.exit(1)
+
+    # One entry past the range so the clamped last index reads velocity 1
+    steps = ((max_us - min_us) >> shift) + 2
+
+    lines = [
+        "/*",
+        " * Velocity Curve Tables",
+        " *",
+        " * GENERATED by tools/gen_velocity_curves.py from include/keyboard_config.h - do not edit.",
+        f" * {steps} steps of {1 << shift} us from {min_us} us to {max_us} us. See include/velocity_curves.h.",
+        " */",
+        "",
+        "#ifndef VELOCITY_CURVES_TABLE_H",
+        "#define VELOCITY_CURVES_TABLE_H",
+        "",
+        f"#define VELOCITY_CURVE_STEPS  {steps}",
+        "",
+        "static const uint8_t velocity_curve_table[VELOCITY_CURVE_COUNT][VELOCITY_CURVE_STEPS] = {",
+    ]
+    for curve in CURVES:
+        table = build_curve(curve, min_us, max_us, shift, steps)
+        lines.append(f"    /* {curve} */ {{")
+        for i in range(0, steps, 16):
+            lines.append("        " + ", ".join(f"{v:3d}" for v in table[i:i + 16]) + ",")
+        lines.append("    },")
+    lines += [
+        "};",
+        "",
+        "static const uint16_t velocity_curve_table16[VELOCITY_CURVE_COUNT][VELOCITY_CURVE_STEPS] = {",
+    ]
+    for curve in CURVES:
+        table16 = build_curve16(curve, build_curve(curve, min_us, max_us, shift, steps),
+                                shift, max_us - min_us)
+        lines.append(f"    /* {curve} */ {{")
+        for i in range(0, steps, 12):
+            lines.append("        " + ", ".join(f"{v:5d}" for v in table16[i:i + 12]) + ",")
+        lines.append("    },")
+    lines += [
+        "};",
+        "",
+        "#endif // VELOCITY_CURVES_TABLE_H",
+        "",
+    ]
+
+    with open(sys.argv[2], "w") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""
+Health Counter Dump
+
+Requests the firmware's runtime health counters over SysEx and prints them
+(protocol in include/sysex.h, counters in include/health.h). With --watch it
+keeps polling and prints how much each counter moved since the last poll.
+
+Requirements: pip install mido python-rtmidi
+
+Usage: health_dump.py [--port NAME] [--watch SECONDS]
+  --port   substring of the MIDI port name (default: "MIDI Keyboard")
+  --watch  poll every SECONDS until Ctrl-C, printing the change per poll
+"""
+
+import argparse
+import sys
+import time
+from typing import Dict, List
+
+import mido
+
+from latency_dump import find_port, get_u32, request
+
+CMD_HEALTH_DUMP = 0x07
+
+# health_counter_t order; counters a newer firmware appends are shown by index
+COUNTERS = [
+    "uptime_ms", "scan_rate_hz", "scans", "scan_overruns", "debounce_rejects",
+    "velocity_timeouts", "second_without_first", "max_frame_events",
+    "usb_fifo_full", "usb_dropped",
+]
+
+# Levels rather than counts: shown as read, never as a difference
+LEVELS = {"scan_rate_hz", "max_frame_events"}
+
+
+def parse_dump(data: List[int]) -> Dict[str, int]:
+    count = data[2]
+    values = [get_u32(data[3 + 5 * i:8 + 5 * i]) for i in range(count)]
+    return {COUNTERS[i] if i < len(COUNTERS) else str(i): v for i, v in enumerate(values)}
+
+
+def read_counters(out_port, in_port) -> Dict[str, int]:
+    replies = request(out_port, in_port, CMD_HEALTH_DUMP, 1)
+    if not replies:
+        print("ERROR: no health reply (firmware without HEALTH_DUMP?)")
+        sys.exit(1)
+    return parse_dump(replies[0])
+
+
+def print_counters(counters: Dict[str, int]):
+    for name, value in counters.items():
+        print(f"{name:<22}{value:>12}")
+
+
+def print_changes(previous: Dict[str, int], counters: Dict[str, int]):
+    """One line per poll: levels as read, counts as the change (mod 2^32)."""
+    fields = []
+    for name, value in counters.items():
+        if name == "uptime_ms":
+            continue
+        if name not in LEVELS and name in previous:
+            value = (value - previous[name]) & 0xFFFFFFFF
+        fields.append(f"{name}={value}")
+    print(f"{counters['uptime_ms'] / 1000:>10.1f}s  " + " ".join(fields))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Dump runtime health counters")
+    parser.add_argument("--port", default="MIDI Keyboard")
+    parser.add_argument("--watch", type=float, metavar="SECONDS")
+    args = parser.parse_args()
+
+    in_name = find_port(mido.get_input_names(), args.port)
+    out_name = find_port(mido.get_output_names(), args.port)
+
+    with mido.open_input(in_name) as in_port, mido.open_output(out_name) as out_port:
+        counters = read_counters(out_port, in_port)
+        print_counters(counters)
+        if args.watch is None:
+            return
+
+        try:
+            while True:
+                time.sleep(args.watch)
+                previous, counters = counters, read_counters(out_port, in_port)
+                print_changes(previous, counters)
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+Latency Histogram Dump
+
+Requests the firmware's key-to-USB latency histograms over SysEx and prints
+them (protocol in include/sysex.h, buckets in include/latency_hist.h).
+
+Requirements: pip install mido python-rtmidi
+
+Usage: latency_dump.py [--port NAME] [--clear]
+  --port   substring of the MIDI port name (default: "MIDI Keyboard")
+  --clear  clear the histograms after reading them
+"""
+
+import argparse
+import sys
+import time
+from typing import Dict, List
+
+import mido
+
+MANUFACTURER_ID = 0x7D
+RESPONSE = 0x40
+CMD_LATENCY_DUMP = 0x01
+CMD_LATENCY_CLEAR = 0x02
+
+STAGES = ["accept", "decision", "fifo", "usb"]
+REPLY_TIMEOUT_S = 2.0
+
+
+def bucket_floor_us(bucket: int) -> int:
+    """Lowest latency counted in a bucket (bucket 0 = 0-15 us)."""
+    return 0 if bucket == 0 else 8 << bucket
+
+
+def get_u32(data: List[int]) -> int:
+    """Five 7-bit bytes, least significant first."""
+    return sum((b & 0x7F) << (7 * i) for i, b in enumerate(data[:5]))
+
+
+def find_port(names: List[str], wanted: str) -> str:
+    for name in names:
+        if wanted.lower() in name.lower():
+            return name
+    print(f"ERROR: no MIDI port matching '{wanted}' in {names}")
+    sys.exit(1)
+
+
+def request(out_port, in_port, command: int, replies: int) -> List[List[int]]:
+    """Send one request and collect its SysEx replies (data without F0/F7)."""
+    out_port.send(mido.Message("sysex", data=[MANUFACTURER_ID, command]))
+
+    received = []
+    deadline = time.time() + REPLY_TIMEOUT_S
+    while len(received) < replies and time.time() < deadline:
+        msg = in_port.poll()
+        if msg is None:
+            time.sleep(0.005)
+            continue
+        data = list(msg.data) if msg.type == "sysex" else []
+        if len(data) >= 2 and data[0] == MANUFACTURER_ID and data[1] == (command | RESPONSE):
+            received.append(data)
+    return received
+
+
+def parse_dump(replies: List[List[int]]) -> Dict[str, List[int]]:
+    histograms = {}
+    for data in replies:
+        stage, buckets = data[2], data[3]
+        counts = [get_u32(data[4 + 5 * b:9 + 5 * b]) for b in range(buckets)]
+        histograms[STAGES[stage] if stage < len(STAGES) else str(stage)] = counts
+    return histograms
+
+
+def print_histograms(histograms: Dict[str, List[int]]):
+    stages = [s for s in STAGES if s in histograms]
+    print(f"{'>= us':>9}" + "".join(f"{s:>10}" for s in stages))
+    buckets = max(len(c) for c in histograms.values())
+    for b in range(buckets):
+        row = [histograms[s][b] for s in stages]
+        if any(row):
+            print(f"{bucket_floor_us(b):>9}" + "".join(f"{c:>10}" for c in row))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Dump key-to-USB latency histograms")
+    parser.add_argument("--port", default="MIDI Keyboard")
+    parser.add_argument("--clear", action="store_true")
+    args = parser.parse_args()
+
+    in_name = find_port(mido.get_input_names(), args.port)
+    out_name = find_port(mido.get_output_names(), args.port)
+
+    with mido.open_input(in_name) as in_port, mido.open_output(out_name) as out_port:
+        replies = request(out_port, in_port, CMD_LATENCY_DUMP, len(STAGES))
+        if len(replies) != len(STAGES):
+            print(f"ERROR: got {len(replies)} of {len(STAGES)} histogram replies")
+            sys.exit(1)
+        print_histograms(parse_dump(replies))
+
+        if args.clear:
+            request(out_port, in_port, CMD_LATENCY_CLEAR, 1)
+            print("Histograms cleared")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""
+Main Loop Phase Profile Dump
+
+Requests the firmware's per-phase cycle profiles over SysEx and prints them
+(protocol in include/sysex.h, phases in include/profiler.h). Needs a build
+with PROFILE_ENABLED.
+
+Requirements: pip install mido python-rtmidi
+
+Usage: profile_dump.py [--port NAME] [--clock-mhz MHZ] [--clear]
+  --port       substring of the MIDI port name (default: "MIDI Keyboard")
+  --clock-mhz  system clock used to convert cycles to microseconds (default: 125)
+  --clear      clear the profiles after reading them
+"""
+
+import argparse
+import sys
+
+import mido
+
+from latency_dump import find_port, get_u32, request
+
+CMD_PROFILE_DUMP = 0x03
+CMD_PROFILE_CLEAR = 0x04
+
+PHASES = ["tud_task", "midi_in", "midi_out", "led", "scan_row", "debounce", "vel_timeout"]
+FIELDS = ["count", "min", "mean", "max", "p99"]
+
+
+def parse_dump(replies):
+    profiles = {}
+    for data in replies:
+        phase = data[2]
+        values = [get_u32(data[3 + 5 * i:8 + 5 * i]) for i in range(len(FIELDS))]
+        name = PHASES[phase] if phase < len(PHASES) else str(phase)
+        profiles[name] = dict(zip(FIELDS, values))
+    return profiles
+
+
+def print_profiles(profiles, clock_mhz: float):
+    print(f"{'phase':<12}{'count':>11}" +
+          "".join(f"{f + ' us':>10}" for f in ["min", "mean", "p99", "max"]))
+    for name in PHASES:
+        p = profiles.get(name)
+        if p is None:
+            continue
+        times = [p[f] / clock_mhz for f in ["min", "mean", "p99", "max"]]
+        print(f"{name:<12}{p['count']:>11}" + "".join(f"{t:>10.2f}" for t in times))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Dump main loop phase profiles")
+    parser.add_argument("--port", default="MIDI Keyboard")
+    parser.add_argument("--clock-mhz", type=float, default=125.0)
+    parser.add_argument("--clear", action="store_true")
+    args = parser.parse_args()
+
+    in_name = find_port(mido.get_input_names(), args.port)
+    out_name = find_port(mido.get_output_names(), args.port)
+
+    with mido.open_input(in_name) as in_port, mido.open_output(out_name) as out_port:
+        replies = request(out_port, in_port, CMD_PROFILE_DUMP, len(PHASES))
+        if not replies:
+            print("ERROR: no profile replies (firmware built without PROFILE_ENABLED?)")
+            sys.exit(1)
+        print_profiles(parse_dump(replies), args.clock_mhz)
+
+        if args.clear:
+            request(out_port, in_port, CMD_PROFILE_CLEAR, 1)
+            print("Profiles cleared")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+"""
+Settle Profile Generator
+
+Turns settle-time sweeps recorded from the characterization firmware
+(examples/gpio-test, or `keyboard_sim --sweep-out FILE settle-sweep`) into a
+per-row settle profile for the main firmware (include/settle_profile.h).
+
+For every drive/read pair and sweep, the pair is stable from the first
+settle step after which no sample differed from the reference read. Sweeps
+are merged by taking each pair's slowest result. A row's profile is its
+slowest pair plus a margin. A row gets SCAN_SETTLE_US instead if no held key
+covered it in any sweep, or if one of its pairs never read stable (crosstalk
+or a wiring fault: fix that first).
+
+A pair is covered if its own key (rising edge) or the key in the same column
+of the previous row (discharge) was held during a sweep. Hold different keys
+across sweeps until every row is covered.
+
+Only needs the Python standard library, so it runs on recorded captures on
+any host.
+
+Usage: settle_profile.py CAPTURE [CAPTURE ...] [--margin-pct P] [--margin-us U]
+                         [--config include/keyboard_config.h] [--header OUT.h]
+"""
+
+import argparse
+import math
+import re
+import sys
+from typing import Dict, List, Optional
+
+SWEEP_FORMAT = 1
+
+
+class Sweep:
+    def __init__(self, source: str, drives: int, reads: int, trials: int):
+        self.source = source
+        self.drives = drives
+        self.reads = reads
+        self.trials = trials
+        self.reference: Dict[int, int] = {}
+        # steps[drive] = [(settle_us, [mismatches per read column]), ...]
+        self.steps: Dict[int, List[tuple]] = {}
+
+    def complete(self) -> bool:
+        return (len(self.reference) == self.drives and len(self.steps) == self.drives and
+                len({len(s) for s in self.steps.values()}) == 1)
+
+    def prev(self, drive: int) -> int:
+        """Row scanned before this one (row 0 follows the last row)."""
+        return drive - 1 if drive else self.drives - 1
+
+    def covered(self, drive: int, read: int) -> bool:
+        return bool((self.reference[drive] | self.reference[self.prev(drive)]) >> read & 1)
+
+    def stable_from(self, drive: int, read: int) -> Optional[int]:
+        """Settle us from which every later step read clean, None if never."""
+        steps = sorted(self.steps[drive])
+        stable = None
+        for settle_us, counts in reversed(steps):
+            if counts[read]:
+                break
+            stable = settle_us
+        return stable
+
+
+def parse_captures(paths: List[str]) -> List[Sweep]:
+    sweeps = []
+    for path in paths:
+        sweep = None
+        for lineno, line in enumerate(open(path, errors="replace"), 1):
+            fields = line.split()
+            if not fields or fields[0].startswith("#"):
+                continue
+            where = f"{path}:{lineno}"
+
+            if fields[0] == "settle-sweep":
+                if sweep:
+                    print(f"{where}: previous sweep has no end, skipped", file=sys.stderr)
+                header = dict(zip(fields[2::2], fields[3::2]))
+                if int(fields[1]) != SWEEP_FORMAT:
+                    sys.exit(f"{where}: sweep format {fields[1]}, expected {SWEEP_FORMAT}")
+                sweep = Sweep(where, int(header["drive"]), int(header["read"]), int(header["trials"]))
+            elif sweep is None:
+                continue    # Serial noise between sweeps
+            elif fields[0] == "ref":
+                sweep.reference[int(fields[1])] = int(fields[2], 16)
+            elif fields[0] == "step":
+                counts = [int(c) for c in fields[3:]]
+                if len(counts) != sweep.reads:
+                    print(f"{where}: {len(counts)} columns, expected {sweep.reads}; sweep skipped",
+                          file=sys.stderr)
+                    sweep = None
+                    continue
+                sweep.steps.setdefault(int(fields[1]), []).append((int(fields[2]), counts))
+            elif fields[0] == "end":
+                if sweep.complete():
+                    sweeps.append(sweep)
+                else:
+                    print(f"{sweep.source}: incomplete sweep skipped", file=sys.stderr)
+                sweep = None
+        if sweep:
+            print(f"{sweep.source}: sweep has no end, skipped", file=sys.stderr)
+    return sweeps
+
+
+def parse_defines(path: str) -> Dict[str, int]:
+    defines = {}
+    for line in open(path):
+        match = re.match(r"\s*#define\s+(\w+)\s+(\d+)\b", line)
+        if match:
+            defines[match.group(1)] = int(match.group(2))
+    return defines
+
+
+class Profile:
+    def __init__(self, sweeps: List[Sweep], margin_pct: float, margin_us: int):
+        self.drives = sweeps[0].drives
+        self.reads = sweeps[0].reads
+        for sweep in sweeps:
+            if (sweep.drives, sweep.reads) != (self.drives, self.reads):
+                sys.exit(f"{sweep.source}: {sweep.drives}x{sweep.reads} matrix, "
+                         f"expected {self.drives}x{self.reads}")
+
+        # Per pair: slowest stable settle over all sweeps (None: never stable)
+        self.pair_us = [[0] * self.reads for _ in range(self.drives)]
+        self.covered = [[False] * self.reads for _ in range(self.drives)]
+        for sweep in sweeps:
+            for drive in range(self.drives):
+                for read in range(self.reads):
+                    self.covered[drive][read] |= sweep.covered(drive, read)
+                    stable = sweep.stable_from(drive, read)
+                    current = self.pair_us[drive][read]
+                    if stable is None or current is None:
+                        self.pair_us[drive][read] = None
+                    else:
+                        self.pair_us[drive][read] = max(current, stable)
+
+        # Per row: slowest pair plus margin, None for the fallback
+        self.row_us: List[Optional[int]] = []
+        self.row_note: List[str] = []
+        for drive in range(self.drives):
+            pairs = self.pair_us[drive]
+            if None in pairs:
+                bad = [read for read, us in enumerate(pairs) if us is None]
+                self.row_us.append(None)
+                self.row_note.append(f"never stable: read {', '.join(map(str, bad))}")
+            elif not any(self.covered[drive]):
+                self.row_us.append(None)
+                self.row_note.append("not measured")
+            else:
+                worst = max(pairs)
+                read = pairs.index(worst)
+                self.row_us.append(math.ceil(worst * (1 + margin_pct / 100)) + margin_us)
+                self.row_note.append(f"worst pair {worst} us (read {read})")
+
+
+def print_report(sweeps: List[Sweep], profile: Profile, fallback_us: int, period_us: Optional[int]):
+    print(f"{len(sweeps)} sweep(s): " + ", ".join(s.source for s in sweeps))
+    print()
+    print("Stable from (us) per drive/read pair ('.' not covered, '!' never stable):")
+    print("  drive " + "".join(f"{read:>5}" for read in range(profile.reads)))
+    for drive in range(profile.drives):
+        cells = []
+        for read in range(profile.reads):
+            us = profile.pair_us[drive][read]
+            if us is None:
+                cells.append("!")
+            elif not profile.covered[drive][read] and us == 0:
+                cells.append(".")
+            else:
+                cells.append(str(us))
+        print(f"  {drive:>5} " + "".join(f"{c:>5}" for c in cells))
+    print()
+
+    print("Row profile:")
+    total = 0
+    for drive in range(profile.drives):
+        us = profile.row_us[drive]
+        total += fallback_us if us is None else us
+        value = f"{us} us" if us is not None else f"SCAN_SETTLE_US ({fallback_us} us)"
+        print(f"  row {drive:>2}: {value:<24} {profile.row_note[drive]}")
+    print(f"  frame settle total {total} us", end="")
+    if period_us:
+        print(f" (SCAN_PERIOD_US {period_us} us)", end="")
+    print()
+    if period_us and total >= period_us:
+        print("WARNING: the frame's settle time alone exceeds SCAN_PERIOD_US", file=sys.stderr)
+    if any(note.startswith("never") for note in profile.row_note):
+        print("WARNING: some pairs never read stable; those rows keep SCAN_SETTLE_US", file=sys.stderr)
+
+
+def write_header(path: str, sweeps: List[Sweep], profile: Profile, margin_pct: float, margin_us: int):
+    sources = sorted({s.source.split(":")[0] for s in sweeps})
+    lines = [
+        "/*",
+        " * Per-Row Settle Profile",
+        " *",
+        " * Minimum settle time per drive row, used by the CPU scan",
+        " * (scan_engine_set_settle) and the PIO scanner (pio_scanner_init).",
+        " * Generated by tools/settle_profile.py from settle sweeps recorded with",
+        " * examples/gpio-test - do not edit:",
+        f" *   {len(sweeps)} sweep(s) from {', '.join(sources)}",
+        f" *   margin +{margin_pct:g}% +{margin_us} us over the slowest pair",
+        " * Rows no sweep measured use SCAN_SETTLE_US.",
+        " */",
+        "",
+        "#ifndef SETTLE_PROFILE_H",
+        "#define SETTLE_PROFILE_H",
+        "",
+        "#include <stdint.h>",
+        '#include "note_map.h"',
+        '#include "keyboard_config.h"',
+        "",
+        "static const uint32_t settle_profile_us[NUM_DRIVE_PINS] = {",
+    ]
+    for drive in range(profile.drives):
+        us = profile.row_us[drive]
+        value = "SCAN_SETTLE_US," if us is None else f"{us},"
+        lines.append(f"    {value:<18}// Row {drive}: {profile.row_note[drive]}")
+    lines += ["};", "", "#endif // SETTLE_PROFILE_H", ""]
+
+    with open(path, "w") as f:
+        f.write("\n".join(lines))
+    print(f"Wrote {path}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Per-row settle profile from recorded settle sweeps")
+    parser.add_argument("captures", nargs="+", help="serial captures of the characterization firmware")
+    parser.add_argument("--margin-pct", type=float, default=50, help="margin over the slowest pair (default 50)")
+    parser.add_argument("--margin-us", type=int, default=2, help="added after the percentage (default 2)")
+    parser.add_argument("--config", default="include/keyboard_config.h",
+                        help="for SCAN_SETTLE_US and SCAN_PERIOD_US (default include/keyboard_config.h)")
+    parser.add_argument("--header", help="write the profile as a C header (include/settle_profile.h)")
+    args = parser.parse_args()
+
+    sweeps = parse_captures(args.captures)
+    if not sweeps:
+        sys.exit("no complete sweeps found")
+
+    defines = parse_defines(args.config)
+    if "SCAN_SETTLE_US" not in defines:
+        sys.exit(f"{args.config}: SCAN_SETTLE_US not found")
+
+    profile = Profile(sweeps, args.margin_pct, args.margin_us)
+    print_report(sweeps, profile, defines["SCAN_SETTLE_US"], defines.get("SCAN_PERIOD_US"))
+    if args.header:
+        write_header(args.header, sweeps, profile, args.margin_pct, args.margin_us)
+
+
+if __name__ == "__main__":
+    main()
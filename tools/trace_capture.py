@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Matrix Trace Capture
+
+Records the raw matrix frames the firmware scans while you play, as a trace
+file for the host simulator (format in sim/trace.h, replay with
+`keyboard_sim FILE.trace`). Needs a build with TRACE_CAPTURE; protocol in
+include/sysex.h and include/trace_capture.h.
+
+The firmware only sends frames that changed or broke the scan period, with a
+count of the unchanged frames between them; those are put back one period
+apart, so the trace holds every frame the engine processed.
+
+Requirements: pip install mido python-rtmidi
+
+Usage: trace_capture.py OUT.trace [--port NAME] [--seconds S]
+  --port     substring of the MIDI port name (default: "MIDI Keyboard")
+  --seconds  stop after S seconds (default: until Ctrl-C)
+"""
+
+import argparse
+import sys
+import time
+from typing import List, Optional
+
+import mido
+
+from latency_dump import MANUFACTURER_ID, RESPONSE, find_port, get_u32
+
+CMD_TRACE_START = 0x05
+CMD_TRACE_STOP = 0x06
+
+KIND_HEADER = 0x00
+KIND_FRAME = 0x01
+
+DRIVES = 12
+READS = 12
+TRACE_FORMAT = 1
+STOP_TIMEOUT_S = 2.0
+
+
+class Trace:
+    def __init__(self):
+        self.offsets: Optional[List[int]] = None
+        self.frames: List[tuple] = []     # (time_us from frame 0, rows)
+        self.last_raw = 0                 # time_us_32 of the last record
+        self.last_time = 0                # Its time from frame 0
+        self.stats = None                 # (frames, records, dropped) from the stop reply
+
+    def add_record(self, data: List[int]):
+        """TRACE_START frame reply: <time> <skipped> <period> <rows>."""
+        raw, skipped, period = (get_u32(data[3 + 5 * i:8 + 5 * i]) for i in range(3))
+        rows = tuple(data[18 + 2 * d] | data[19 + 2 * d] << 7 for d in range(DRIVES))
+
+        if self.frames:
+            last_time, last_rows = self.frames[-1]
+            for i in range(1, skipped + 1):
+                self.frames.append((last_time + i * period, last_rows))
+            # 32-bit firmware clock, wrap-safe from the last record
+            self.last_time += (raw - self.last_raw) & 0xFFFFFFFF
+        self.frames.append((self.last_time, rows))
+        self.last_raw = raw
+
+    def handle(self, data: List[int]):
+        if len(data) < 3 or data[0] != MANUFACTURER_ID:
+            return
+        if data[1] == CMD_TRACE_STOP | RESPONSE and len(data) == 17:
+            self.stats = tuple(get_u32(data[2 + 5 * i:7 + 5 * i]) for i in range(3))
+        elif data[1] == CMD_TRACE_START | RESPONSE:
+            if data[2] == KIND_HEADER and len(data) == 3 + 5 * DRIVES:
+                self.offsets = [get_u32(data[3 + 5 * d:8 + 5 * d]) for d in range(DRIVES)]
+            elif data[2] == KIND_FRAME and len(data) == 18 + 2 * DRIVES:
+                self.add_record(data)
+
+    def write(self, path: str):
+        with open(path, "w") as f:
+            f.write(f"keyboard-trace {TRACE_FORMAT} drive {DRIVES} read {READS}\n")
+            f.write("offsets " + " ".join(str(o) for o in self.offsets) + "\n")
+            last_rows = None
+            for time_us, rows in self.frames:
+                if rows == last_rows:
+                    f.write(f"{time_us}\n")
+                else:
+                    f.write(f"{time_us} " + " ".join(f"{r:03x}" for r in rows) + "\n")
+                last_rows = rows
+            f.write("end\n")
+
+
+def send(out_port, command: int):
+    out_port.send(mido.Message("sysex", data=[MANUFACTURER_ID, command]))
+
+
+def receive(in_port, trace: Trace):
+    for msg in in_port.iter_pending():
+        if msg.type == "sysex":
+            trace.handle(list(msg.data))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Record matrix frames as a simulator trace")
+    parser.add_argument("out", help="trace file to write (e.g. sim/traces/my_playing.trace)")
+    parser.add_argument("--port", default="MIDI Keyboard")
+    parser.add_argument("--seconds", type=float)
+    args = parser.parse_args()
+
+    in_name = find_port(mido.get_input_names(), args.port)
+    out_name = find_port(mido.get_output_names(), args.port)
+
+    with mido.open_input(in_name) as in_port, mido.open_output(out_name) as out_port:
+        # Close a capture an earlier run left open, and drop its replies
+        send(out_port, CMD_TRACE_STOP)
+        time.sleep(0.5)
+        receive(in_port, Trace())
+
+        trace = Trace()
+        send(out_port, CMD_TRACE_START)
+        print("Capturing, play now" + (f" ({args.seconds:g} s)" if args.seconds else " (Ctrl-C to stop)"))
+        start = time.time()
+        try:
+            while args.seconds is None or time.time() - start < args.seconds:
+                receive(in_port, trace)
+                time.sleep(0.005)
+        except KeyboardInterrupt:
+            pass
+
+        send(out_port, CMD_TRACE_STOP)
+        deadline = time.time() + STOP_TIMEOUT_S
+        while trace.stats is None and time.time() < deadline:
+            receive(in_port, trace)
+            time.sleep(0.005)
+
+    if trace.stats is None or trace.offsets is None or not trace.frames:
+        print("ERROR: no complete capture (firmware built without TRACE_CAPTURE?)")
+        sys.exit(1)
+
+    frames, records, dropped = trace.stats
+    trace.write(args.out)
+    print(f"Wrote {args.out}: {len(trace.frames)} frames over {trace.frames[-1][0] / 1e6:.1f} s "
+          f"({records} records)")
+    if dropped or frames != len(trace.frames):
+        print(f"WARNING: {dropped} records dropped, {frames} frames scanned: the trace has gaps")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()